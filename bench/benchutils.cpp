@@ -0,0 +1,219 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "benchutils.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QProcessEnvironment>
+
+#include "identity.h"
+#include "network.h"
+#include "peer.h"
+
+namespace BenchUtils {
+
+int Random::bounded(int bound)
+{
+    // Numerical Recipes LCG; the high bits are good enough for our purposes
+    _state = _state * 1664525u + 1013904223u;
+    return (_state >> 8) % bound;
+}
+
+
+QString Random::nick(int poolSize)
+{
+    return QString("nick%1").arg(bounded(poolSize));
+}
+
+
+QString Random::channel(int poolSize)
+{
+    return QString("#channel%1").arg(bounded(poolSize));
+}
+
+
+QString Random::chatText()
+{
+    static const QStringList words = QString::fromUtf8(
+        "the quick brown fox jumps over lazy dog quassel core client buffer network "
+        "hello world lorem ipsum dolor sit amet schön grüße ünïcödé 日本語 ☺"
+    ).split(' ');
+
+    QString text;
+    int wordCount = 3 + bounded(20);
+    for (int i = 0; i < wordCount; ++i) {
+        if (i > 0)
+            text += ' ';
+        switch (bounded(40)) {
+        case 0: {
+            int fg = bounded(16);
+            int bg = bounded(16);
+            text += QString("\x03%1,%2%3\x0f").arg(fg).arg(bg).arg(words.at(bounded(words.count())));
+            break;
+        }
+        case 1:
+            text += QString("\x02%1\x02").arg(words.at(bounded(words.count())));
+            break;
+        case 2: {
+            QString path = words.at(bounded(6));
+            text += QString("https://example.org/%1?id=%2").arg(path).arg(bounded(100000));
+            break;
+        }
+        case 3:
+            text += channel();
+            break;
+        default:
+            text += words.at(bounded(words.count()));
+        }
+    }
+    return text;
+}
+
+
+QList<QByteArray> ircTrace(int lineCount)
+{
+    QList<QByteArray> lines;
+
+    QString traceFile = QProcessEnvironment::systemEnvironment().value("QUASSEL_BENCH_IRC_TRACE");
+    if (!traceFile.isEmpty()) {
+        QFile file(traceFile);
+        if (file.open(QIODevice::ReadOnly)) {
+            while (!file.atEnd() && lines.count() < lineCount) {
+                QByteArray line = file.readLine();
+                while (line.endsWith('\n') || line.endsWith('\r'))
+                    line.chop(1);
+                if (!line.isEmpty())
+                    lines << line;
+            }
+            return lines;
+        }
+        qWarning() << "Could not open IRC trace" << traceFile << "- using a synthetic one instead";
+    }
+
+    // Draw every random value in its own statement; the evaluation order of function arguments is unspecified
+    Random random;
+    while (lines.count() < lineCount) {
+        QString nick = random.nick();
+        QString prefix = QString(":%1!~%1@host-%2.example.org").arg(nick).arg(random.bounded(1000));
+        int kind = random.bounded(100);
+        QString channel = random.channel();
+        QString line;
+        if (kind < 60) {
+            QString text = random.chatText();
+            line = QString("%1 PRIVMSG %2 :%3").arg(prefix, channel, text);
+        }
+        else if (kind < 65) {
+            QString text = random.chatText();
+            line = QString("%1 NOTICE %2 :%3").arg(prefix, channel, text);
+        }
+        else if (kind < 72) {
+            line = QString("%1 JOIN %2").arg(prefix, channel);
+        }
+        else if (kind < 78) {
+            QString text = random.chatText();
+            line = QString("%1 PART %2 :%3").arg(prefix, channel, text);
+        }
+        else if (kind < 84) {
+            QString text = random.bounded(4) ? random.chatText() : QString("irc.example.org irc2.example.org");
+            line = QString("%1 QUIT :%2").arg(prefix, text);
+        }
+        else if (kind < 88) {
+            QString target = random.nick();
+            line = QString("%1 MODE %2 +v %3").arg(prefix, channel, target);
+        }
+        else if (kind < 90) {
+            QString newNick = random.nick();
+            line = QString("%1 NICK :%2").arg(prefix, newNick);
+        }
+        else if (kind < 93) {
+            QStringList names;
+            for (int i = 0; i < 40; ++i) {
+                QString mode = random.bounded(10) ? QString() : QString("@");
+                names << mode + random.nick();
+            }
+            line = QString(":irc.example.org 353 me = %1 :%2").arg(channel, names.join(" "));
+        }
+        else if (kind < 95) {
+            line = QString(":irc.example.org 366 me %1 :End of /NAMES list.").arg(channel);
+        }
+        else if (kind < 97) {
+            QString text = random.chatText();
+            line = QString(":irc.example.org 332 me %1 :%2").arg(channel, text);
+        }
+        else {
+            line = QString("PING :irc.example.org");
+        }
+        lines << line.toUtf8();
+    }
+    return lines;
+}
+
+
+MessageList messages(const BufferInfo &bufferInfo, int count)
+{
+    Random random;
+    MessageList msgs;
+    msgs.reserve(count);
+    QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1500000000000));
+    for (int i = 0; i < count; ++i) {
+        timestamp = timestamp.addMSecs(random.bounded(60000));
+        QString nick = random.nick();
+        Message::Type type = random.bounded(10) ? Message::Plain : Message::Action;
+        QString contents = random.chatText();
+        QString prefixes = random.bounded(10) ? QString() : QString("@");
+        msgs << Message(timestamp, bufferInfo, type, contents, QString("%1!~%1@host.example.org").arg(nick), prefixes,
+                        QString("Real Name of %1").arg(nick));
+    }
+    return msgs;
+}
+
+
+void registerMetaTypes()
+{
+    qRegisterMetaType<Message>("Message");
+    qRegisterMetaType<BufferInfo>("BufferInfo");
+    qRegisterMetaType<NetworkInfo>("NetworkInfo");
+    qRegisterMetaType<Network::Server>("Network::Server");
+    qRegisterMetaType<Identity>("Identity");
+
+    qRegisterMetaTypeStreamOperators<Message>("Message");
+    qRegisterMetaTypeStreamOperators<BufferInfo>("BufferInfo");
+    qRegisterMetaTypeStreamOperators<NetworkInfo>("NetworkInfo");
+    qRegisterMetaTypeStreamOperators<Network::Server>("Network::Server");
+    qRegisterMetaTypeStreamOperators<Identity>("Identity");
+
+    qRegisterMetaType<IdentityId>("IdentityId");
+    qRegisterMetaType<BufferId>("BufferId");
+    qRegisterMetaType<NetworkId>("NetworkId");
+    qRegisterMetaType<UserId>("UserId");
+    qRegisterMetaType<MsgId>("MsgId");
+
+    qRegisterMetaTypeStreamOperators<IdentityId>("IdentityId");
+    qRegisterMetaTypeStreamOperators<BufferId>("BufferId");
+    qRegisterMetaTypeStreamOperators<NetworkId>("NetworkId");
+    qRegisterMetaTypeStreamOperators<UserId>("UserId");
+    qRegisterMetaTypeStreamOperators<MsgId>("MsgId");
+
+    qRegisterMetaType<PeerPtr>("PeerPtr");
+    qRegisterMetaTypeStreamOperators<PeerPtr>("PeerPtr");
+}
+
+}
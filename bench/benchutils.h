@@ -0,0 +1,92 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "abstractcliparser.h"
+#include "message.h"
+
+/**
+ * Shared helpers for the benchmarks.
+ *
+ * All generated data is derived from a fixed seed, so every run of a benchmark works on exactly the same input.
+ */
+namespace BenchUtils {
+
+//! Small, deterministic pseudo-random number generator (not using qrand() keeps us independent from other users)
+class Random
+{
+public:
+    Random(quint32 seed = 42) : _state(seed) {}
+
+    //! @return A number in [0, bound)
+    int bounded(int bound);
+
+    //! @return Some chat text, sometimes containing mIRC formatting codes, URLs or channel names
+    QString chatText();
+
+    QString nick(int poolSize = 500);
+    QString channel(int poolSize = 20);
+
+private:
+    quint32 _state;
+};
+
+/**
+ * Returns a stream of raw IRC lines, as received from a server
+ *
+ * If the environment variable QUASSEL_BENCH_IRC_TRACE points to a recorded raw log (one line per message,
+ * without line endings), its first @a lineCount lines are used. Otherwise, a synthetic stream with a mix
+ * of messages typical for a busy network is generated.
+ */
+QList<QByteArray> ircTrace(int lineCount);
+
+//! @return A list of @a count messages for the given buffer, with ascending timestamps
+MessageList messages(const BufferInfo &bufferInfo, int count);
+
+//! Registers the metatypes the serializers need; usually done by Quassel::init()
+void registerMetaTypes();
+
+//! Command line parser stub, so that Quassel::optionValue() can be fed by a benchmark
+class CliParser : public AbstractCliParser
+{
+public:
+    bool init(const QStringList &arguments = QStringList()) override { Q_UNUSED(arguments); return true; }
+
+    QString value(const QString &longName) override { return _values.value(longName); }
+    bool isSet(const QString &longName) override { return _values.contains(longName); }
+    void usage() override {}
+
+    void setValue(const QString &longName, const QString &value) { _values[longName] = value; }
+
+protected:
+    void addArgument(const QString &longName, const CliParserArg &arg) override { Q_UNUSED(longName); Q_UNUSED(arg); }
+
+private:
+    QHash<QString, QString> _values;
+};
+
+}
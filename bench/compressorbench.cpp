@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+#include "benchutils.h"
+#include "compressor.h"
+
+Q_DECLARE_METATYPE(Compressor::CompressionLevel)
+
+/**
+ * Benchmarks a round-trip through a pair of Compressors connected over loopback, with a payload resembling
+ * a burst of serialized messages.
+ */
+class CompressorBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+
+private:
+    QList<QByteArray> _chunks;
+    qint64 _totalSize{0};
+};
+
+
+void CompressorBench::initTestCase()
+{
+    BenchUtils::Random random;
+    for (int i = 0; i < 5000; ++i) {
+        _chunks << random.chatText().toUtf8();
+        _totalSize += _chunks.last().size();
+    }
+}
+
+
+void CompressorBench::roundTrip_data()
+{
+    QTest::addColumn<Compressor::CompressionLevel>("level");
+    QTest::newRow("no compression") << Compressor::NoCompression;
+    QTest::newRow("best speed") << Compressor::BestSpeed;
+    QTest::newRow("default compression") << Compressor::DefaultCompression;
+}
+
+
+void CompressorBench::roundTrip()
+{
+    QFETCH(Compressor::CompressionLevel, level);
+
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QTcpSocket clientSocket;
+    clientSocket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(clientSocket.waitForConnected(5000));
+    QVERIFY(server.waitForNewConnection(5000));
+    QTcpSocket *serverSocket = server.nextPendingConnection();
+    QVERIFY(serverSocket);
+
+    Compressor sender(&clientSocket, level);
+    Compressor receiver(serverSocket, level);
+    QByteArray buffer(64 * 1024, 0);
+
+    QBENCHMARK {
+        for (int i = 0; i < _chunks.count(); ++i) {
+            const QByteArray &chunk = _chunks.at(i);
+            sender.write(chunk.constData(), chunk.size(), i == _chunks.count() - 1 ? Compressor::Flush : Compressor::NoFlush);
+        }
+
+        qint64 received = 0;
+        QElapsedTimer timer;
+        timer.start();
+        while (received < _totalSize) {
+            QCoreApplication::processEvents();
+            while (receiver.bytesAvailable() > 0)
+                received += receiver.read(buffer.data(), buffer.size());
+            QVERIFY2(timer.elapsed() < 30000, "Timed out waiting for data");
+        }
+        QCOMPARE(received, _totalSize);
+    }
+}
+
+
+QTEST_GUILESS_MAIN(CompressorBench)
+
+#include "compressorbench.moc"
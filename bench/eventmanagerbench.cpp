@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "benchutils.h"
+#include "eventmanager.h"
+#include "ircevent.h"
+#include "network.h"
+
+namespace {
+
+class BenchEventManager : public EventManager
+{
+    Q_OBJECT
+
+public:
+    BenchEventManager(Network *network) : _network(network) {}
+
+protected:
+    Network *networkById(NetworkId id) const override { Q_UNUSED(id); return _network; }
+
+private:
+    Network *_network;
+};
+
+
+//! Registers handlers the way the core's processors do: specific ones, a group handler and a filter
+class BenchHandler : public QObject
+{
+    Q_OBJECT
+
+public:
+    int handled{0};
+
+    Q_INVOKABLE void processIrcEventPrivmsg(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+    Q_INVOKABLE void processIrcEventJoin(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+    Q_INVOKABLE void processIrcEventQuit(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+    Q_INVOKABLE void processIrcEvent353(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+    Q_INVOKABLE void processIrcEvent(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+    Q_INVOKABLE bool filterIrcEventPart(IrcEvent *e) { Q_UNUSED(e); return true; }
+    Q_INVOKABLE void processIrcEventPart(IrcEvent *e) { Q_UNUSED(e); ++handled; }
+};
+
+}
+
+/**
+ * Benchmarks EventManager::postEvent() with several handlers registered per event type.
+ */
+class EventManagerBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void dispatch_data();
+    void dispatch();
+};
+
+
+void EventManagerBench::dispatch_data()
+{
+    QTest::addColumn<int>("handlerCount");
+    QTest::newRow("1 handler") << 1;
+    QTest::newRow("4 handlers") << 4;
+}
+
+
+void EventManagerBench::dispatch()
+{
+    QFETCH(int, handlerCount);
+
+    Network network(NetworkId(1));
+    BenchEventManager manager(&network);
+    QList<BenchHandler *> handlers;
+    for (int i = 0; i < handlerCount; ++i) {
+        handlers << new BenchHandler;
+        manager.registerObject(handlers.last(), EventManager::Priority(i % (EventManager::HighestPriority + 1)));
+    }
+
+    static const EventManager::EventType types[] = {
+        EventManager::IrcEventPrivmsg, EventManager::IrcEventPrivmsg, EventManager::IrcEventPrivmsg,
+        EventManager::IrcEventJoin, EventManager::IrcEventPart, EventManager::IrcEventQuit,
+        EventManager::IrcEventMode, EventManager::IrcEventNumeric
+    };
+    static const int typeCount = sizeof(types) / sizeof(types[0]);
+    QStringList params = QStringList() << "#channel" << "Some message text";
+
+    QBENCHMARK {
+        for (int i = 0; i < 10000; ++i) {
+            EventManager::EventType type = types[i % typeCount];
+            if (type == EventManager::IrcEventNumeric)
+                manager.postEvent(new IrcEventNumeric(353, &network, "irc.example.org", "me", params));
+            else
+                manager.postEvent(new IrcEvent(type, &network, "nick!~user@host.example.org", params));
+        }
+    }
+
+    qDeleteAll(handlers);
+}
+
+
+QTEST_GUILESS_MAIN(EventManagerBench)
+
+#include "eventmanagerbench.moc"
@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "benchutils.h"
+#include "eventmanager.h"
+#include "ircparser.h"
+#include "network.h"
+
+/**
+ * Benchmarks splitting and decoding raw IRC lines, i.e. the part of IrcParser::processNetworkIncoming()
+ * that runs for every line received before any event handling kicks in.
+ */
+class IrcParserBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void tokenize();
+    void tokenizeAndDecode();
+
+private:
+    QList<QByteArray> _trace;
+};
+
+
+void IrcParserBench::initTestCase()
+{
+    _trace = BenchUtils::ircTrace(20000);
+    Network::setDefaultCodecForServer("UTF-8");
+}
+
+
+void IrcParserBench::tokenize()
+{
+    QByteArray prefix, cmd;
+    QList<QByteArray> params;
+    QBENCHMARK {
+        foreach (const QByteArray &line, _trace)
+            IrcParser::tokenize(line, prefix, cmd, params);
+    }
+}
+
+
+void IrcParserBench::tokenizeAndDecode()
+{
+    Network network(NetworkId(1));
+    QByteArray prefix, cmd;
+    QList<QByteArray> params;
+    QBENCHMARK {
+        foreach (const QByteArray &line, _trace) {
+            if (!IrcParser::tokenize(line, prefix, cmd, params))
+                continue;
+            network.decodeServerString(prefix);
+            QString command = network.decodeServerString(cmd);
+            if (!command.toUInt())
+                EventManager::eventTypeByName(QLatin1String("IrcEvent") + command.at(0).toUpper() + command.mid(1).toLower());
+            foreach (const QByteArray &param, params)
+                network.decodeServerString(param);
+        }
+    }
+}
+
+
+QTEST_GUILESS_MAIN(IrcParserBench)
+
+#include "ircparserbench.moc"
@@ -0,0 +1,478 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+/*
+ * ircreplay - a fake IRC server replaying a recorded transcript to the core, for reproducing traffic patterns
+ * (like netsplit storms) offline and measuring how the core copes with them.
+ *
+ * Start the core with --metrics-port, point one or more networks at the port ircreplay listens on, and connect
+ * them. Every connection gets the full transcript, at the recorded pace scaled by --speed. Once the given number
+ * of connections has finished, ircreplay prints what the core reported for the replay.
+ *
+ * Transcript format: one raw IRC line per line. Lines may be prefixed with a millisecond offset and a tab
+ * ("1500\t:nick!user@host PRIVMSG #chan :hi"); untimed lines are sent at --rate lines per second. The string
+ * $nick is replaced by the nick the core registered with.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <iostream>
+#include <limits>
+
+struct TranscriptLine {
+    qint64 offset; // in ms
+    QByteArray data;
+};
+
+using Transcript = QVector<TranscriptLine>;
+
+
+static bool loadTranscript(const QString &fileName, int rate, Transcript &transcript)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not open " << qPrintable(fileName) << ": " << qPrintable(file.errorString()) << std::endl;
+        return false;
+    }
+
+    qint64 base = 0;    // offset of the last timed line
+    int untimed = 0;    // untimed lines since then
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        while (line.endsWith('\n') || line.endsWith('\r'))
+            line.chop(1);
+        if (line.isEmpty())
+            continue;
+
+        int tab = line.indexOf('\t');
+        bool timed = false;
+        qint64 lineOffset = tab > 0 ? line.left(tab).toLongLong(&timed) : 0;
+        if (timed) {
+            base = lineOffset;
+            untimed = 0;
+            line = line.mid(tab + 1);
+        }
+        else if (!transcript.isEmpty()) {
+            untimed++;
+        }
+        transcript << TranscriptLine{base + (qint64)untimed * 1000 / rate, line};
+    }
+    return true;
+}
+
+
+//! A netsplit storm: lots of users in our channels quit with a netsplit message, then come back and get their modes
+static Transcript netsplitTranscript(int userCount)
+{
+    static const int channelCount = 10;
+    Transcript transcript;
+    auto add = [&transcript](qint64 offset, const QString &line) {
+        transcript << TranscriptLine{offset, line.toUtf8()};
+    };
+    auto user = [](int i) { return QString("user%1!~user%1@host%1.example.org").arg(i); };
+    auto channel = [](int i) { return QString("#split%1").arg(i % channelCount); };
+
+    for (int c = 0; c < channelCount; ++c)
+        add(0, QString(":$nick!~me@replay.example.org JOIN %1").arg(channel(c)));
+    for (int c = 0; c < channelCount; ++c) {
+        QStringList names;
+        for (int i = c; i < userCount; i += channelCount) {
+            names << QString("user%1").arg(i);
+            if (names.count() == 50) {
+                add(100, QString(":replay.example.org 353 $nick = %1 :%2").arg(channel(c), names.join(' ')));
+                names.clear();
+            }
+        }
+        add(100, QString(":replay.example.org 353 $nick = %1 :$nick %2").arg(channel(c), names.join(' ')));
+        add(100, QString(":replay.example.org 366 $nick %1 :End of /NAMES list.").arg(channel(c)));
+    }
+
+    for (int i = 0; i < userCount; ++i)
+        add(1000 + i, QString(":%1 PRIVMSG %2 :Hello from user %3").arg(user(i), channel(i)).arg(i));
+
+    qint64 splitStart = 1000 + userCount + 2000;
+    for (int i = 0; i < userCount; ++i)
+        add(splitStart, QString(":%1 QUIT :hub.example.org leaf.example.org").arg(user(i)));
+
+    qint64 rejoinStart = splitStart + 5000;
+    for (int i = 0; i < userCount; ++i) {
+        add(rejoinStart + i / 100, QString(":%1 JOIN %2").arg(user(i), channel(i)));
+        if (i % 10 == 0)
+            add(rejoinStart + i / 100, QString(":hub.example.org MODE %1 +o user%2").arg(channel(i)).arg(i));
+    }
+    return transcript;
+}
+
+
+/**********************************************************************************************************************/
+
+struct MetricsSnapshot {
+    bool valid{false};
+    QHash<QString, double> totals;       // sample name -> sum over all label sets
+    QMap<double, double> latencyBuckets; // upper bound -> cumulative count
+};
+
+
+static MetricsSnapshot fetchMetrics(const QString &address)
+{
+    MetricsSnapshot snapshot;
+
+    QTcpSocket tcpSocket;
+    QLocalSocket localSocket;
+    QIODevice *device;
+    if (address.contains('/')) {
+        localSocket.connectToServer(address);
+        if (!localSocket.waitForConnected(5000))
+            return snapshot;
+        device = &localSocket;
+    }
+    else {
+        int colon = address.lastIndexOf(':');
+        tcpSocket.connectToHost(address.left(colon), address.mid(colon + 1).toUShort());
+        if (!tcpSocket.waitForConnected(5000))
+            return snapshot;
+        device = &tcpSocket;
+    }
+
+    // The core closes the connection once the response is sent
+    device->write("GET /metrics HTTP/1.0\r\n\r\n");
+    auto waitForData = [&]() {
+        return device == &tcpSocket ? tcpSocket.waitForReadyRead(1000) : localSocket.waitForReadyRead(1000);
+    };
+    QByteArray response;
+    while (waitForData())
+        response += device->readAll();
+    response += device->readAll();
+
+    int bodyStart = response.indexOf("\r\n\r\n");
+    if (!response.startsWith("HTTP/1.0 200") || bodyStart < 0)
+        return snapshot;
+
+    foreach (const QByteArray &line, response.mid(bodyStart + 4).split('\n')) {
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        int space = line.lastIndexOf(' ');
+        QByteArray sample = line.left(space);
+        double value = line.mid(space + 1).toDouble();
+        int brace = sample.indexOf('{');
+        QString name = QString::fromUtf8(brace < 0 ? sample : sample.left(brace));
+        snapshot.totals[name] += value;
+
+        if (name == "quassel_message_latency_seconds_bucket") {
+            int le = sample.indexOf("le=\"");
+            QByteArray bound = sample.mid(le + 4, sample.indexOf('"', le + 4) - le - 4);
+            double upper = bound == "+Inf" ? std::numeric_limits<double>::infinity() : bound.toDouble();
+            snapshot.latencyBuckets[upper] += value;
+        }
+    }
+    snapshot.valid = true;
+    return snapshot;
+}
+
+
+/**********************************************************************************************************************/
+
+class ReplayConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    ReplayConnection(QTcpSocket *socket, const Transcript &transcript, double speed, int repeat, QObject *parent)
+        : QObject(parent), _socket(socket), _transcript(transcript), _speed(speed), _repeatsLeft(repeat)
+    {
+        _socket->setParent(this);
+        _timer.setSingleShot(true);
+        connect(_socket, SIGNAL(readyRead()), SLOT(readClient()));
+        connect(_socket, SIGNAL(bytesWritten(qint64)), SLOT(sendDue()));
+        connect(_socket, SIGNAL(disconnected()), SLOT(finish()));
+        connect(&_timer, SIGNAL(timeout()), SLOT(sendDue()));
+    }
+
+    qint64 linesSent() const { return _linesSent; }
+    qint64 duration() const { return _duration; }
+
+signals:
+    void replayStarted();
+    void finished();
+
+private slots:
+    void readClient()
+    {
+        while (_socket->canReadLine()) {
+            QByteArray line = _socket->readLine().trimmed();
+            QList<QByteArray> params = line.split(' ');
+            QByteArray cmd = params.value(0).toUpper();
+            if (cmd == "CAP" && params.value(1).toUpper() == "LS")
+                send(":replay.example.org CAP * LS :");
+            else if (cmd == "NICK")
+                _nick = params.value(1);
+            else if (cmd == "USER")
+                _userSeen = true;
+            else if (cmd == "PING")
+                send(":replay.example.org PONG replay.example.org " + line.mid(5));
+            else if (cmd == "JOIN" && _replayStarted)
+                send(":" + _nick + "!~me@replay.example.org JOIN " + params.value(1));
+            else if (cmd == "QUIT")
+                _socket->disconnectFromHost();
+
+            if (!_replayStarted && _userSeen && !_nick.isEmpty())
+                startReplay();
+        }
+    }
+
+    void sendDue()
+    {
+        if (!_replayStarted || _finished)
+            return;
+
+        // don't let the socket buffer grow without bounds if we're faster than the core
+        while (_index < _transcript.count() && _socket->bytesToWrite() < 256 * 1024) {
+            const TranscriptLine &line = _transcript.at(_index);
+            if (_speed > 0) {
+                qint64 due = (qint64)(line.offset / _speed);
+                qint64 now = _replayTimer.elapsed();
+                if (due > now) {
+                    _timer.start(due - now);
+                    return;
+                }
+            }
+            QByteArray data = line.data;
+            send(data.replace("$nick", _nick));
+            _linesSent++;
+            if (++_index == _transcript.count() && --_repeatsLeft > 0) {
+                _index = 0;
+                _replayTimer.restart();
+            }
+        }
+        if (_index == _transcript.count() && _socket->bytesToWrite() == 0)
+            finish();
+    }
+
+    void finish()
+    {
+        if (_finished)
+            return;
+        _finished = true;
+        _duration = _replayTimer.isValid() ? _replayTimer.elapsed() : 0;
+        _timer.stop();
+        emit finished();
+    }
+
+private:
+    void send(const QByteArray &line) { _socket->write(line + "\r\n"); }
+
+    void startReplay()
+    {
+        send(":replay.example.org 001 " + _nick + " :Welcome to the replay network " + _nick);
+        send(":replay.example.org 005 " + _nick + " CHANTYPES=# PREFIX=(ov)@+ CHANMODES=b,k,l,imnpst "
+             "CASEMAPPING=rfc1459 NETWORK=Replay :are supported by this server");
+        send(":replay.example.org 375 " + _nick + " :- Message of the day -");
+        send(":replay.example.org 376 " + _nick + " :End of /MOTD command.");
+        _replayStarted = true;
+        _replayTimer.start();
+        emit replayStarted();
+        sendDue();
+    }
+
+    QTcpSocket *_socket;
+    const Transcript &_transcript;
+    double _speed;
+    int _repeatsLeft;
+
+    QTimer _timer;
+    QElapsedTimer _replayTimer;
+    QByteArray _nick;
+    bool _userSeen{false};
+    bool _replayStarted{false};
+    bool _finished{false};
+    int _index{0};
+    qint64 _linesSent{0};
+    qint64 _duration{0};
+};
+
+
+/**********************************************************************************************************************/
+
+class ReplayServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ReplayServer(const Transcript &transcript, double speed, int repeat, int connections, const QString &metrics, int settleTime)
+        : _transcript(transcript), _speed(speed), _repeat(repeat), _connectionsLeft(connections), _metrics(metrics), _settleTime(settleTime)
+    {
+        connect(&_server, SIGNAL(newConnection()), SLOT(newConnection()));
+    }
+
+    bool listen(const QHostAddress &address, quint16 port)
+    {
+        if (!_server.listen(address, port)) {
+            std::cerr << "Could not listen: " << qPrintable(_server.errorString()) << std::endl;
+            return false;
+        }
+        std::cout << "Replaying " << _transcript.count() << " lines on " << qPrintable(address.toString()) << " port "
+                  << _server.serverPort() << std::endl;
+        return true;
+    }
+
+private slots:
+    void newConnection()
+    {
+        while (QTcpSocket *socket = _server.nextPendingConnection()) {
+            ReplayConnection *connection = new ReplayConnection(socket, _transcript, _speed, _repeat, this);
+            connect(connection, SIGNAL(replayStarted()), SLOT(replayStarted()));
+            connect(connection, SIGNAL(finished()), SLOT(connectionFinished()));
+            _connections << connection;
+        }
+    }
+
+    void replayStarted()
+    {
+        if (_replayTimer.isValid())
+            return;
+        if (!_metrics.isEmpty()) {
+            _before = fetchMetrics(_metrics);
+            if (!_before.valid)
+                std::cerr << "Could not fetch metrics from " << qPrintable(_metrics) << std::endl;
+        }
+        _replayTimer.start();
+    }
+
+    void connectionFinished()
+    {
+        ReplayConnection *connection = qobject_cast<ReplayConnection *>(sender());
+        std::cout << "Connection finished: " << connection->linesSent() << " lines in " << connection->duration() << " ms" << std::endl;
+        _linesSent += connection->linesSent();
+        if (--_connectionsLeft == 0) {
+            _replayDuration = _replayTimer.elapsed();
+            // give the core a chance to work off what it has buffered
+            QTimer::singleShot(_settleTime * 1000, this, SLOT(report()));
+        }
+    }
+
+    void report()
+    {
+        std::cout << std::endl << "Sent " << _linesSent << " lines in " << _replayDuration << " ms ("
+                  << (_replayDuration > 0 ? _linesSent * 1000 / _replayDuration : 0) << " lines/s)" << std::endl;
+
+        if (!_metrics.isEmpty() && _before.valid) {
+            MetricsSnapshot after = fetchMetrics(_metrics);
+            if (!after.valid) {
+                std::cerr << "Could not fetch metrics from " << qPrintable(_metrics) << std::endl;
+            }
+            else {
+                reportMetrics(after);
+            }
+        }
+        QCoreApplication::quit();
+    }
+
+private:
+    void reportMetrics(const MetricsSnapshot &after)
+    {
+        auto delta = [&](const QString &name) { return after.totals.value(name) - _before.totals.value(name); };
+
+        double lines = delta("quassel_irc_lines_received_total");
+        qint64 elapsed = _replayDuration + _settleTime * 1000;
+        std::cout << "Core processed " << (qint64)lines << " lines (" << (qint64)(lines * 1000 / elapsed)
+                  << " lines/s including the settle time)" << std::endl;
+
+        double count = delta("quassel_message_latency_seconds_count");
+        if (count > 0) {
+            std::cout << "Message latency (socket read to displayMsg) over " << (qint64)count << " messages:" << std::endl
+                      << "  mean: " << delta("quassel_message_latency_seconds_sum") / count * 1000 << " ms" << std::endl;
+            for (double quantile : {0.5, 0.95, 0.99}) {
+                for (auto it = after.latencyBuckets.constBegin(); it != after.latencyBuckets.constEnd(); ++it) {
+                    if (it.value() - _before.latencyBuckets.value(it.key()) >= quantile * count) {
+                        std::cout << "  p" << quantile * 100 << ": <= " << it.key() * 1000 << " ms" << std::endl;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (after.totals.contains("process_resident_memory_peak_bytes"))
+            std::cout << "Peak RSS of the core: " << (qint64)(after.totals.value("process_resident_memory_peak_bytes") / (1024 * 1024))
+                      << " MiB" << std::endl;
+    }
+
+    QTcpServer _server;
+    const Transcript &_transcript;
+    double _speed;
+    int _repeat;
+    int _connectionsLeft;
+    QString _metrics;
+    int _settleTime;
+
+    QList<ReplayConnection *> _connections;
+    QElapsedTimer _replayTimer;
+    qint64 _replayDuration{0};
+    qint64 _linesSent{0};
+    MetricsSnapshot _before;
+};
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a recorded IRC server transcript to Quassel cores.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("transcript", "Transcript to replay (not needed with --netsplit)");
+    parser.addOption(QCommandLineOption("listen", "Address to listen on", "address", "127.0.0.1"));
+    parser.addOption(QCommandLineOption("port", "Port to listen on", "port", "6667"));
+    parser.addOption(QCommandLineOption("speed", "Speed multiplier for timed transcripts; 0 sends as fast as possible", "factor", "1"));
+    parser.addOption(QCommandLineOption("rate", "Lines per second for untimed transcript lines", "lines", "100"));
+    parser.addOption(QCommandLineOption("repeat", "Number of times to replay the transcript per connection", "count", "1"));
+    parser.addOption(QCommandLineOption("connections", "Number of connections to serve before reporting", "count", "1"));
+    parser.addOption(QCommandLineOption("netsplit", "Replay a generated netsplit storm with the given number of users", "users"));
+    parser.addOption(QCommandLineOption("metrics", "The core's metrics endpoint (host:port or socket path) to report from", "address"));
+    parser.addOption(QCommandLineOption("settle", "Seconds to wait after the replay before fetching the metrics", "seconds", "2"));
+    parser.process(app);
+
+    Transcript transcript;
+    if (parser.isSet("netsplit")) {
+        transcript = netsplitTranscript(parser.value("netsplit").toInt());
+    }
+    else if (parser.positionalArguments().count() == 1) {
+        if (!loadTranscript(parser.positionalArguments().first(), qMax(1, parser.value("rate").toInt()), transcript))
+            return EXIT_FAILURE;
+    }
+    else {
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    ReplayServer server(transcript, parser.value("speed").toDouble(), qMax(1, parser.value("repeat").toInt()),
+                        qMax(1, parser.value("connections").toInt()), parser.value("metrics"), parser.value("settle").toInt());
+    if (!server.listen(QHostAddress(parser.value("listen")), parser.value("port").toUShort()))
+        return EXIT_FAILURE;
+
+    return app.exec();
+}
+
+#include "ircreplay.moc"
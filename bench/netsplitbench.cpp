@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "benchutils.h"
+#include "netsplit.h"
+#include "network.h"
+
+/**
+ * Benchmarks netsplit tracking as driven by CoreSessionEventProcessor: a burst of quits with a netsplit
+ * message, followed by the users joining their channels again (and getting their modes back) in a different order.
+ */
+class NetsplitBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void splitAndRejoin_data();
+    void splitAndRejoin();
+};
+
+
+void NetsplitBench::splitAndRejoin_data()
+{
+    QTest::addColumn<int>("userCount");
+    QTest::newRow("100 users") << 100;
+    QTest::newRow("1000 users") << 1000;
+    QTest::newRow("5000 users") << 5000;
+}
+
+
+void NetsplitBench::splitAndRejoin()
+{
+    QFETCH(int, userCount);
+
+    BenchUtils::Random random;
+    Network network(NetworkId(1));
+    const QString quitMessage = "irc1.example.org irc2.example.org";
+
+    QStringList senders;
+    QList<QStringList> channels;
+    for (int i = 0; i < userCount; ++i) {
+        senders << QString("user%1!~user%1@host-%2.example.org").arg(i).arg(random.bounded(1000));
+        QStringList userChannels;
+        int channelCount = 1 + random.bounded(5);
+        while (userChannels.count() < channelCount) {
+            QString channel = random.channel();
+            if (!userChannels.contains(channel))
+                userChannels << channel;
+        }
+        channels << userChannels;
+    }
+
+    // users come back in a different order than they left
+    QList<int> joinOrder;
+    for (int i = 0; i < userCount; ++i)
+        joinOrder.insert(random.bounded(joinOrder.count() + 1), i);
+
+    QBENCHMARK {
+        Netsplit split(&network);
+        for (int i = 0; i < userCount; ++i) {
+            if (Netsplit::isNetsplit(quitMessage))
+                split.userQuit(senders.at(i), channels.at(i), quitMessage);
+        }
+        foreach (int i, joinOrder) {
+            foreach (const QString &channel, channels.at(i)) {
+                if (!split.userAlreadyJoined(senders.at(i), channel) && split.userJoined(senders.at(i), channel))
+                    split.addMode(senders.at(i), channel, "v");
+            }
+        }
+        QMetaObject::invokeMethod(&split, "joinTimeout", Qt::DirectConnection);
+    }
+}
+
+
+QTEST_GUILESS_MAIN(NetsplitBench)
+
+#include "netsplitbench.moc"
@@ -0,0 +1,444 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+/*
+ * quasselload - a headless client opening lots of sessions to a running core, for finding out how the core scales
+ * with the number of connected clients.
+ *
+ * Every session authenticates like a real client (including SSL, compression and the protocol handshake), runs the
+ * initial sync of its networks and the buffer syncer, and then keeps generating the traffic an idle or active user
+ * would: backlog requests, marking buffers as read and (optionally) sending input to channels. The latency of every
+ * operation is recorded and summarized once --duration is over.
+ *
+ * The core users must exist already (see quasselcore --add-user); --user may contain %1, which is replaced by the
+ * session number modulo --users, for spreading the sessions over several core users. Input is sent to the real IRC
+ * networks, so point those at ircreplay or a test server.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTimer>
+
+#ifdef HAVE_SSL
+#  include <QSslSocket>
+#endif
+
+#include "backlogmanager.h"
+#include "benchutils.h"
+#include "buffersyncer.h"
+#include "clientauthhandler.h"
+#include "coreaccount.h"
+#include "message.h"
+#include "network.h"
+#include "quassel.h"
+#include "remotepeer.h"
+#include "signalproxy.h"
+
+static qint64 now()
+{
+    static QElapsedTimer timer;
+    if (!timer.isValid())
+        timer.start();
+    return timer.nsecsElapsed();
+}
+
+
+//! Latency samples (in ns) per operation, shared by all sessions
+class LoadStats
+{
+public:
+    void record(const QString &operation, qint64 start) { _samples[operation] << now() - start; }
+    void count(const QString &event, qint64 n = 1) { _counters[event] += n; }
+
+    void report(qint64 elapsed) const
+    {
+        std::cout << std::endl << "Results after " << elapsed / 1000 << " s:" << std::endl;
+        for (auto it = _counters.constBegin(); it != _counters.constEnd(); ++it)
+            std::cout << "  " << qPrintable(it.key()) << ": " << it.value() << std::endl;
+
+        std::cout << std::endl << "Latencies in ms:" << std::endl;
+        for (auto it = _samples.constBegin(); it != _samples.constEnd(); ++it) {
+            QVector<qint64> samples = it.value();
+            std::sort(samples.begin(), samples.end());
+            qint64 sum = 0;
+            for (qint64 sample : samples)
+                sum += sample;
+            auto quantile = [&samples](double q) {
+                return samples.at(qMin(samples.count() - 1, (int)(q * samples.count()))) / 1e6;
+            };
+            std::cout << "  " << qPrintable(it.key()) << ": " << samples.count() << " samples, mean "
+                      << sum / samples.count() / 1e6 << ", p50 " << quantile(0.5) << ", p95 " << quantile(0.95)
+                      << ", p99 " << quantile(0.99) << ", max " << samples.last() / 1e6 << std::endl;
+        }
+    }
+
+private:
+    QMap<QString, QVector<qint64>> _samples;
+    QMap<QString, qint64> _counters;
+};
+
+
+/**
+ * The backlog manager of a load session
+ *
+ * ClientBacklogManager needs the Client singleton, so the base class is synchronized instead and the replies are
+ * handed to a callback.
+ */
+class LoadBacklogManager : public BacklogManager
+{
+public:
+    using Callback = std::function<void(BufferId, const QVariantList &)>;
+
+    LoadBacklogManager(Callback callback, QObject *parent) : BacklogManager(parent), _callback(std::move(callback)) {}
+
+    void receiveBacklog(BufferId bufferId, MsgId, MsgId, int, int, QVariantList msgs) override { _callback(bufferId, msgs); }
+
+private:
+    Callback _callback;
+};
+
+
+/**********************************************************************************************************************/
+
+struct LoadOptions {
+    int backlogInterval; // all intervals in ms, 0 disables the operation
+    int backlogLimit;
+    int lastSeenInterval;
+    int inputInterval;
+    QString inputText;
+};
+
+
+class LoadSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoadSession(int index, const CoreAccount &account, const LoadOptions &options, LoadStats *stats, QObject *parent)
+        : QObject(parent), _index(index), _account(account), _options(options), _stats(stats) {}
+
+    void start()
+    {
+        _authHandler = new ClientAuthHandler(_account, this);
+        connect(_authHandler, SIGNAL(handshakeComplete(RemotePeer*,Protocol::SessionState)), SLOT(onHandshakeComplete(RemotePeer*,Protocol::SessionState)));
+        connect(_authHandler, SIGNAL(errorMessage(QString)), SLOT(onError(QString)));
+        connect(_authHandler, SIGNAL(errorPopup(QString)), SLOT(onError(QString)));
+        connect(_authHandler, SIGNAL(requestDisconnect(QString,bool)), SLOT(onError(QString)));
+        connect(_authHandler, SIGNAL(userAuthenticationRequired(CoreAccount*,bool*,QString)), SLOT(onUserAuthenticationRequired(CoreAccount*,bool*,QString)));
+        connect(_authHandler, SIGNAL(handleNoSslInClient(bool*)), SLOT(acceptNoSsl(bool*)));
+        connect(_authHandler, SIGNAL(handleNoSslInCore(bool*)), SLOT(acceptNoSsl(bool*)));
+#ifdef HAVE_SSL
+        connect(_authHandler, SIGNAL(handleSslErrors(const QSslSocket*,bool*,bool*)), SLOT(acceptSslErrors(const QSslSocket*,bool*,bool*)));
+#endif
+        _connectStart = now();
+        _authHandler->connectToCore();
+    }
+
+signals:
+    void sendInput(const BufferInfo &bufferInfo, const QString &message);
+
+private slots:
+    void onHandshakeComplete(RemotePeer *peer, const Protocol::SessionState &sessionState)
+    {
+        _stats->record("connect", _connectStart);
+        _stats->count("sessions connected");
+        _syncStart = now();
+
+        // The proxy must outlive the run: the proxy created last is SignalProxy::current(), which the (de)serializers
+        // rely on, and deleting any proxy resets it
+        _signalProxy = new SignalProxy(SignalProxy::Client, this);
+        _signalProxy->addPeer(peer);
+        connect(peer, SIGNAL(disconnected()), SLOT(onDisconnected()));
+
+        _signalProxy->attachSlot(SIGNAL(displayMsg(const Message &)), this, SLOT(recvMessage(const Message &)));
+        _signalProxy->attachSignal(this, SIGNAL(sendInput(BufferInfo, QString)));
+
+        foreach (const QVariant &networkId, sessionState.networkIds) {
+            Network *net = new Network(networkId.value<NetworkId>(), this);
+            net->setProxy(_signalProxy);
+            connect(net, SIGNAL(initDone()), SLOT(objectInitDone()));
+            _signalProxy->synchronize(net);
+            _pendingInits++;
+        }
+
+        _bufferSyncer = new BufferSyncer(this);
+        connect(_bufferSyncer, SIGNAL(initDone()), SLOT(objectInitDone()));
+        connect(_bufferSyncer, SIGNAL(lastSeenMsgSet(BufferId,MsgId)), SLOT(onLastSeenMsgSet(BufferId,MsgId)));
+        _signalProxy->synchronize(_bufferSyncer);
+        _pendingInits++;
+
+        _backlogManager = new LoadBacklogManager([this](BufferId bufferId, const QVariantList &msgs) {
+            onBacklogReceived(bufferId, msgs);
+        }, this);
+        _signalProxy->synchronize(_backlogManager);
+
+        foreach (const QVariant &v, sessionState.bufferInfos) {
+            BufferInfo bufferInfo = v.value<BufferInfo>();
+            _buffers << bufferInfo;
+            if (bufferInfo.type() == BufferInfo::ChannelBuffer)
+                _channels << bufferInfo;
+        }
+    }
+
+    void objectInitDone()
+    {
+        if (--_pendingInits > 0)
+            return;
+        _stats->record("initial sync", _syncStart);
+
+        // Spread the operations of all sessions over the interval, so they don't hit the core in lockstep
+        auto startTimer = [this](QTimer *timer, int interval, const char *slot) {
+            if (interval <= 0)
+                return;
+            connect(timer, SIGNAL(timeout()), slot);
+            QTimer::singleShot(BenchUtils::Random(_index).bounded(interval), timer, SLOT(start()));
+            timer->setInterval(interval);
+        };
+        startTimer(&_backlogTimer, _options.backlogInterval, SLOT(requestBacklog()));
+        startTimer(&_lastSeenTimer, _options.lastSeenInterval, SLOT(requestSetLastSeen()));
+        if (!_channels.isEmpty())
+            startTimer(&_inputTimer, _options.inputInterval, SLOT(sendInputMessage()));
+    }
+
+    void requestBacklog()
+    {
+        if (_buffers.isEmpty())
+            return;
+        BufferId bufferId = _buffers.at(_random.bounded(_buffers.count())).bufferId();
+        // requests for the same buffer are answered in order
+        _pendingBacklog[bufferId] << now();
+        _backlogManager->requestBacklog(bufferId, -1, -1, _options.backlogLimit);
+    }
+
+    void onBacklogReceived(BufferId bufferId, const QVariantList &msgs)
+    {
+        if (_pendingBacklog[bufferId].isEmpty())
+            return;
+        _stats->record("backlog", _pendingBacklog[bufferId].takeFirst());
+        _stats->count("backlog messages received", msgs.count());
+        foreach (const QVariant &v, msgs)
+            updateNewestMsg(v.value<Message>());
+    }
+
+    void requestSetLastSeen()
+    {
+        // The core ignores (and doesn't answer) updates that don't move the marker forward
+        for (auto it = _newestMsg.constBegin(); it != _newestMsg.constEnd(); ++it) {
+            if (_bufferSyncer->lastSeenMsg(it.key()) < it.value() && !_pendingLastSeen.contains(it.key())) {
+                _pendingLastSeen[it.key()] = qMakePair(it.value(), now());
+                _bufferSyncer->requestSetLastSeenMsg(it.key(), it.value());
+                return;
+            }
+        }
+    }
+
+    void onLastSeenMsgSet(BufferId bufferId, const MsgId &msgId)
+    {
+        // Another session of the same user may have been faster, in which case we didn't measure anything
+        auto it = _pendingLastSeen.find(bufferId);
+        if (it == _pendingLastSeen.end() || msgId < it->first)
+            return;
+        if (msgId == it->first)
+            _stats->record("set last seen", it->second);
+        _pendingLastSeen.erase(it);
+    }
+
+    void sendInputMessage()
+    {
+        const BufferInfo &bufferInfo = _channels.at(_random.bounded(_channels.count()));
+        QString tag = QString("[load %1/%2]").arg(_index).arg(++_inputCount);
+        _pendingInput[tag] = now();
+        emit sendInput(bufferInfo, QString("%1 %2").arg(_options.inputText, tag));
+    }
+
+    void recvMessage(const Message &msg)
+    {
+        _stats->count("messages received");
+        updateNewestMsg(msg);
+
+        if (!_pendingInput.isEmpty() && msg.contents().endsWith(']')) {
+            int tagStart = msg.contents().lastIndexOf("[load ");
+            if (tagStart >= 0) {
+                auto it = _pendingInput.find(msg.contents().mid(tagStart));
+                if (it != _pendingInput.end()) {
+                    _stats->record("input echo", it.value());
+                    _pendingInput.erase(it);
+                }
+            }
+        }
+    }
+
+    void onUserAuthenticationRequired(CoreAccount *account, bool *valid, const QString &errorMessage)
+    {
+        // The credentials were given up front, so this means they were wrong
+        Q_UNUSED(account);
+        *valid = false;
+        onError(errorMessage.isEmpty() ? tr("Authentication required") : errorMessage);
+    }
+
+    void acceptNoSsl(bool *accepted) { *accepted = true; }
+
+#ifdef HAVE_SSL
+    void acceptSslErrors(const QSslSocket *socket, bool *accepted, bool *permanently)
+    {
+        Q_UNUSED(socket);
+        *accepted = true;
+        *permanently = false;
+    }
+#endif
+
+    void onError(const QString &errorString)
+    {
+        if (_failed)
+            return;
+        _failed = true;
+        _stats->count("sessions failed");
+        std::cerr << "Session " << _index << ": " << qPrintable(errorString) << std::endl;
+    }
+
+    void onDisconnected()
+    {
+        _backlogTimer.stop();
+        _lastSeenTimer.stop();
+        _inputTimer.stop();
+        onError(tr("Disconnected from core"));
+    }
+
+private:
+    void updateNewestMsg(const Message &msg)
+    {
+        if (msg.isValid() && _newestMsg.value(msg.bufferId()) < msg.msgId())
+            _newestMsg[msg.bufferId()] = msg.msgId();
+    }
+
+    int _index;
+    CoreAccount _account;
+    const LoadOptions &_options;
+    LoadStats *_stats;
+    BenchUtils::Random _random{(quint32)_index};
+
+    ClientAuthHandler *_authHandler{nullptr};
+    SignalProxy *_signalProxy{nullptr};
+    BufferSyncer *_bufferSyncer{nullptr};
+    LoadBacklogManager *_backlogManager{nullptr};
+    bool _failed{false};
+
+    qint64 _connectStart{0};
+    qint64 _syncStart{0};
+    int _pendingInits{0};
+
+    QList<BufferInfo> _buffers;
+    QList<BufferInfo> _channels;
+    QHash<BufferId, MsgId> _newestMsg;
+
+    QTimer _backlogTimer;
+    QTimer _lastSeenTimer;
+    QTimer _inputTimer;
+    QHash<BufferId, QList<qint64>> _pendingBacklog;
+    QHash<BufferId, QPair<MsgId, qint64>> _pendingLastSeen;
+    QHash<QString, qint64> _pendingInput;
+    int _inputCount{0};
+};
+
+
+/**********************************************************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Opens lots of client sessions to a Quassel core and measures its response times.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("host", "Host the core runs on", "host", "localhost"));
+    parser.addOption(QCommandLineOption("port", "Port the core listens on", "port", "4242"));
+    parser.addOption(QCommandLineOption("user", "Core user; %1 is replaced by the session number modulo --users", "name"));
+    parser.addOption(QCommandLineOption("users", "Number of core users to spread the sessions over", "count", "1"));
+    parser.addOption(QCommandLineOption("password", "Password of the core user(s)", "password"));
+    parser.addOption(QCommandLineOption("no-ssl", "Don't use SSL for connecting to the core"));
+    parser.addOption(QCommandLineOption("clients", "Number of sessions to open", "count", "100"));
+    parser.addOption(QCommandLineOption("ramp", "Number of sessions to open per second", "count", "20"));
+    parser.addOption(QCommandLineOption("duration", "Seconds to run before reporting, counted from the first session", "seconds", "60"));
+    parser.addOption(QCommandLineOption("backlog-interval", "Seconds between backlog requests per session; 0 disables them", "seconds", "10"));
+    parser.addOption(QCommandLineOption("backlog-limit", "Number of messages per backlog request", "count", "50"));
+    parser.addOption(QCommandLineOption("lastseen-interval", "Seconds between marking a buffer as read per session; 0 disables it", "seconds", "5"));
+    parser.addOption(QCommandLineOption("input-interval", "Seconds between messages sent to a channel per session; 0 disables them", "seconds", "0"));
+    parser.addOption(QCommandLineOption("input", "Text to send to channels", "text", "Hello from quasselload"));
+    parser.process(app);
+
+    if (!parser.isSet("user") || !parser.isSet("password"))
+        parser.showHelp(EXIT_FAILURE);
+
+    // The handshake and the serializers need these, usually set up by Quassel::init()
+    Quassel::setupBuildInfo();
+    BenchUtils::registerMetaTypes();
+
+    auto seconds = [&parser](const QString &name) { return (int)(parser.value(name).toDouble() * 1000); };
+    LoadOptions options{seconds("backlog-interval"), parser.value("backlog-limit").toInt(), seconds("lastseen-interval"),
+                        seconds("input-interval"), parser.value("input")};
+
+    LoadStats stats;
+    int clients = parser.value("clients").toInt();
+    int users = qMax(1, parser.value("users").toInt());
+    int ramp = qMax(1, parser.value("ramp").toInt());
+    QList<LoadSession *> sessions;
+    for (int i = 0; i < clients; ++i) {
+        CoreAccount account(i + 1);
+        account.setAccountName(QString("load%1").arg(i));
+        account.setHostName(parser.value("host"));
+        account.setPort(parser.value("port").toUInt());
+        QString user = parser.value("user");
+        account.setUser(user.contains("%1") ? user.arg(i % users) : user);
+        account.setPassword(parser.value("password"));
+        account.setUseSsl(!parser.isSet("no-ssl"));
+        sessions << new LoadSession(i, account, options, &stats, &app);
+    }
+
+    QTimer rampTimer;
+    int started = 0;
+    QObject::connect(&rampTimer, &QTimer::timeout, [&]() {
+        // start sessions in small batches to approximate the ramp rate without a timer per session
+        int batch = qMax(1, ramp / 10);
+        for (int i = 0; i < batch && started < sessions.count(); ++i)
+            sessions.at(started++)->start();
+        if (started == sessions.count())
+            rampTimer.stop();
+    });
+    rampTimer.start(qMax(1, 1000 * qMax(1, ramp / 10) / ramp));
+
+    qint64 runStart = now();
+    QTimer durationTimer;
+    durationTimer.setSingleShot(true);
+    QObject::connect(&durationTimer, &QTimer::timeout, [&]() {
+        stats.report((now() - runStart) / 1000000);
+        QCoreApplication::quit();
+    });
+    durationTimer.start(seconds("duration"));
+
+    return app.exec();
+}
+
+#include "quasselload.moc"
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "benchutils.h"
+#include "internalpeer.h"
+#include "ircchannel.h"
+#include "network.h"
+#include "protocols/datastream/datastreampeer.h"
+#include "serializers/serializers.h"
+#include "signalproxy.h"
+
+/**
+ * Benchmarks encoding and decoding of SignalProxy messages the way DataStreamPeer does it, for the two
+ * message kinds dominating the traffic: RPC calls carrying a Message, and InitData for a big network.
+ */
+class SerializersBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void encodeMessages();
+    void decodeMessages();
+    void encodeInitData();
+    void decodeInitData();
+
+private:
+    static QByteArray encode(const QVariantList &packedFunc);
+    bool decode(const QByteArray &data);
+
+    SignalProxy *_proxy{nullptr};
+    InternalPeer *_peer{nullptr};
+    Network *_network{nullptr};
+
+    QList<QVariantList> _rpcCalls;
+    QList<QByteArray> _encodedRpcCalls;
+    QVariantList _initData;
+    QByteArray _encodedInitData;
+};
+
+
+void SerializersBench::initTestCase()
+{
+    BenchUtils::registerMetaTypes();
+
+    // Message's stream operators ask the current SignalProxy for the peer's features
+    _proxy = new SignalProxy(SignalProxy::Server, this);
+    _peer = new InternalPeer(this);
+    _peer->setFeatures(Quassel::Features{});
+    _proxy->setTargetPeer(_peer);
+    _proxy->setSourcePeer(_peer);
+
+    BufferInfo bufferInfo(BufferId(1), NetworkId(1), BufferInfo::ChannelBuffer, 0, "#channel");
+    foreach (const Message &msg, BenchUtils::messages(bufferInfo, 5000)) {
+        _rpcCalls << (QVariantList() << (qint16)DataStreamPeer::RpcCall << QByteArray(SIGNAL(displayMsg(Message))) << QVariant::fromValue(msg));
+        _encodedRpcCalls << encode(_rpcCalls.last());
+    }
+
+    BenchUtils::Random random;
+    _network = new Network(NetworkId(1), this);
+    _network->setProxy(_proxy);
+    for (int c = 0; c < 50; ++c) {
+        IrcChannel *channel = _network->newIrcChannel(QString("#channel%1").arg(c));
+        QStringList nicks, modes;
+        for (int u = 0; u < 200; ++u) {
+            QString nick = random.nick(5000);
+            _network->newIrcUser(QString("%1!~%1@host.example.org").arg(nick));
+            nicks << nick;
+            modes << (random.bounded(10) ? QString() : QString("o"));
+        }
+        channel->joinIrcUsers(nicks, modes);
+    }
+
+    QVariantMap initMap = _network->toVariantMap();
+    QVariantList initList;
+    for (QVariantMap::const_iterator it = initMap.constBegin(); it != initMap.constEnd(); ++it)
+        initList << it.key().toUtf8() << it.value();
+    _initData = QVariantList() << (qint16)DataStreamPeer::InitData << QByteArray("Network") << QByteArray("1") << initList;
+    _encodedInitData = encode(_initData);
+}
+
+
+void SerializersBench::cleanupTestCase()
+{
+    delete _network;
+    _network = nullptr;
+    delete _proxy;
+    _proxy = nullptr;
+}
+
+
+QByteArray SerializersBench::encode(const QVariantList &packedFunc)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_2);
+    stream << packedFunc;
+    return data;
+}
+
+
+bool SerializersBench::decode(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_2);
+    QVariantList list;
+    return Serializers::deserialize(stream, _peer->features(), list);
+}
+
+
+void SerializersBench::encodeMessages()
+{
+    QBENCHMARK {
+        foreach (const QVariantList &rpcCall, _rpcCalls)
+            encode(rpcCall);
+    }
+}
+
+
+void SerializersBench::decodeMessages()
+{
+    QBENCHMARK {
+        foreach (const QByteArray &data, _encodedRpcCalls)
+            QVERIFY(decode(data));
+    }
+}
+
+
+void SerializersBench::encodeInitData()
+{
+    QBENCHMARK {
+        encode(_initData);
+    }
+}
+
+
+void SerializersBench::decodeInitData()
+{
+    QBENCHMARK {
+        QVERIFY(decode(_encodedInitData));
+    }
+}
+
+
+QTEST_GUILESS_MAIN(SerializersBench)
+
+#include "serializersbench.moc"
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <memory>
+
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "benchutils.h"
+#include "postgresqlstorage.h"
+#include "quassel.h"
+#include "sqlitestorage.h"
+
+/**
+ * Benchmarks logging and fetching backlog against a seeded database.
+ *
+ * SQLite works on a temporary database. PostgreSQL is only benchmarked if the DB_PGSQL_* environment variables
+ * (as used by --config-from-environment) point to a database; note that the database is set up if needed and
+ * then filled with benchmark data.
+ */
+class StorageBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void logMessages_data();
+    void logMessages();
+    void requestMsgs_data();
+    void requestMsgs();
+
+private:
+    struct Backend {
+        Storage *storage{nullptr};
+        UserId user;
+        BufferInfo bufferInfo;
+        MsgId firstMsgId;
+        MsgId lastMsgId;
+    };
+
+    //! @return The seeded backend, or nullptr if it is not available
+    Backend *backend(const QString &backendId);
+
+    void addBackendColumn();
+
+    QTemporaryDir _configDir;
+    QHash<QString, Backend> _backends;
+};
+
+
+static const int seedCount = 50000;
+static const int batchSize = 100;
+
+
+void StorageBench::initTestCase()
+{
+    Q_INIT_RESOURCE(sql);
+    BenchUtils::registerMetaTypes();
+
+    QVERIFY(_configDir.isValid());
+    auto cliParser = std::make_shared<BenchUtils::CliParser>();
+    cliParser->setValue("configdir", _configDir.path());
+    Quassel::setCliParser(cliParser);
+}
+
+
+void StorageBench::cleanupTestCase()
+{
+    foreach (const Backend &backend, _backends)
+        delete backend.storage;
+    _backends.clear();
+}
+
+
+StorageBench::Backend *StorageBench::backend(const QString &backendId)
+{
+    if (_backends.contains(backendId))
+        return _backends[backendId].storage ? &_backends[backendId] : nullptr;
+
+    Backend &backend = _backends[backendId];
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    Storage *storage = nullptr;
+    if (backendId == "SQLite")
+        storage = new SqliteStorage;
+    else if (environment.contains("DB_PGSQL_DATABASE"))
+        storage = new PostgreSqlStorage;
+    else
+        return nullptr;
+
+    bool fromEnvironment = backendId != "SQLite";
+    if (!storage->isAvailable()) {
+        delete storage;
+        return nullptr;
+    }
+    Storage::State state = storage->init({}, environment, fromEnvironment);
+    if (state == Storage::NeedsSetup && storage->setup({}, environment, fromEnvironment))
+        state = storage->init({}, environment, fromEnvironment);
+    if (state != Storage::IsReady) {
+        qWarning() << "Could not initialize" << backendId << "storage";
+        delete storage;
+        return nullptr;
+    }
+
+    // Use a fresh user, so we don't collide with data from previous runs in a persistent database
+    backend.user = storage->addUser(QString("bench-%1").arg(QDateTime::currentMSecsSinceEpoch()), "bench");
+    NetworkInfo networkInfo;
+    networkInfo.networkName = "BenchNet";
+    NetworkId networkId = storage->createNetwork(backend.user, networkInfo);
+    backend.bufferInfo = storage->bufferInfo(backend.user, networkId, BufferInfo::ChannelBuffer, "#bench");
+
+    MessageList msgs = BenchUtils::messages(backend.bufferInfo, seedCount);
+    for (int i = 0; i < msgs.count(); i += 500) {
+        MessageList batch = msgs.mid(i, 500);
+        if (!storage->logMessages(batch)) {
+            qWarning() << "Could not seed" << backendId << "storage";
+            delete storage;
+            return nullptr;
+        }
+        if (i == 0)
+            backend.firstMsgId = batch.first().msgId();
+        backend.lastMsgId = batch.last().msgId();
+    }
+
+    backend.storage = storage;
+    return &backend;
+}
+
+
+void StorageBench::addBackendColumn()
+{
+    QTest::addColumn<QString>("backendId");
+    QTest::newRow("SQLite") << "SQLite";
+    QTest::newRow("PostgreSQL") << "PostgreSQL";
+}
+
+
+void StorageBench::logMessages_data()
+{
+    addBackendColumn();
+}
+
+
+void StorageBench::logMessages()
+{
+    QFETCH(QString, backendId);
+    Backend *b = backend(backendId);
+    if (!b)
+        QSKIP("Backend not available");
+
+    MessageList msgs = BenchUtils::messages(b->bufferInfo, batchSize);
+    QBENCHMARK {
+        MessageList batch = msgs;
+        QVERIFY(b->storage->logMessages(batch));
+    }
+}
+
+
+void StorageBench::requestMsgs_data()
+{
+    addBackendColumn();
+}
+
+
+void StorageBench::requestMsgs()
+{
+    QFETCH(QString, backendId);
+    Backend *b = backend(backendId);
+    if (!b)
+        QSKIP("Backend not available");
+
+    // Alternate between the newest messages (as fetched on connect) and an older page (as fetched on scrolling up)
+    MsgId middle = (b->firstMsgId.toQint64() + b->lastMsgId.toQint64()) / 2;
+    QBENCHMARK {
+        QCOMPARE(b->storage->requestMsgs(b->user, b->bufferInfo.bufferId(), -1, -1, 500).count(), 500);
+        QCOMPARE(b->storage->requestMsgs(b->user, b->bufferInfo.bufferId(), -1, middle, 500).count(), 500);
+    }
+}
+
+
+QTEST_GUILESS_MAIN(StorageBench)
+
+#include "storagebench.moc"
@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "benchutils.h"
+#include "clickable.h"
+#include "uistyle.h"
+
+/**
+ * Benchmarks turning coloured chat lines into styled strings, and scanning them for clickables.
+ */
+class UiStyleBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void styleViaInternal();
+    void mircToStyledString();
+    void findClickables();
+
+private:
+    QStringList _lines;
+};
+
+
+void UiStyleBench::initTestCase()
+{
+    BenchUtils::Random random;
+    for (int i = 0; i < 20000; ++i)
+        _lines << random.chatText();
+}
+
+
+void UiStyleBench::styleViaInternal()
+{
+    QBENCHMARK {
+        foreach (const QString &line, _lines)
+            UiStyle::styleString(UiStyle::mircToInternal(line));
+    }
+}
+
+
+void UiStyleBench::mircToStyledString()
+{
+    QBENCHMARK {
+        foreach (const QString &line, _lines)
+            UiStyle::mircToStyledString(line);
+    }
+}
+
+
+void UiStyleBench::findClickables()
+{
+    QStringList plainLines;
+    foreach (const QString &line, _lines)
+        plainLines << UiStyle::mircToStyledString(line).plainText;
+
+    QBENCHMARK {
+        foreach (const QString &line, plainLines)
+            ClickableList::fromString(line);
+    }
+}
+
+
+QTEST_GUILESS_MAIN(UiStyleBench)
+
+#include "uistylebench.moc"
@@ -38,6 +38,14 @@ public:
     inline int dynamicBacklogAmount() { return localValue("DynamicBacklogAmount", 200).toInt(); }
     inline void setDynamicBacklogAmount(int amount) { return setLocalValue("DynamicBacklogAmount", amount); }
 
+    //! Estimated memory the client may use for messages, in MiB (0 for unlimited)
+    inline int memoryBudget() { return localValue("MemoryBudget", 256).toInt(); }
+    inline void setMemoryBudget(int budget) { return setLocalValue("MemoryBudget", budget); }
+
+    //! Number of messages per buffer to keep on disk between sessions (0 to disable the cache)
+    inline int diskCacheSize() { return localValue("DiskCacheSize", 0).toInt(); }
+    inline void setDiskCacheSize(int size) { return setLocalValue("DiskCacheSize", size); }
+
     inline int fixedBacklogAmount() { return localValue("FixedBacklogAmount", 500).toInt(); }
     inline void setFixedBacklogAmount(int amount) { return setLocalValue("FixedBacklogAmount", amount); }
 
@@ -480,6 +480,7 @@ void Client::finishConnectionInitialization()
     disconnect(bufferSyncer(), SIGNAL(initDone()), this, SLOT(finishConnectionInitialization()));
 
     requestInitialBacklog();
+    prefetchChannelUsers();
     if (isCoreFeatureEnabled(Quassel::Feature::BufferActivitySync)) {
         bufferSyncer()->markActivitiesChanged();
         bufferSyncer()->markHighlightCountsChanged();
@@ -493,6 +494,30 @@ void Client::requestInitialBacklog()
 }
 
 
+void Client::prefetchChannelUsers()
+{
+    if (!isCoreFeatureEnabled(Quassel::Feature::LazyChannelUsers))
+        return;
+
+    // Fetch the users of the channels we're most likely to look at first, i.e. those with highlights or unread messages
+    const int maxPrefetched = 5;
+    QList<BufferId> highlighted, active;
+    foreach(BufferId bufferId, bufferSyncer()->lastSeenBufferIds()) {
+        if (bufferSyncer()->highlightCount(bufferId) > 0)
+            highlighted << bufferId;
+        else if (bufferSyncer()->activity(bufferId) & (Message::Plain | Message::Action))
+            active << bufferId;
+    }
+
+    int count = 0;
+    foreach(BufferId bufferId, highlighted + active) {
+        if (count++ >= maxPrefetched)
+            break;
+        fetchChannelUsers(bufferId);
+    }
+}
+
+
 void Client::requestLegacyCoreInfo()
 {
     // On older cores, the CoreInfo object was only synchronized on demand.  Synchronize now if
@@ -636,6 +661,7 @@ void Client::recvMessage(const Message &msg)
 {
     Message msg_ = msg;
     messageProcessor()->process(msg_);
+    backlogManager()->cacheMessage(msg);
 }
 
 
@@ -692,6 +718,22 @@ void Client::purgeKnownBufferIds()
 }
 
 
+void Client::fetchChannelUsers(BufferId bufferId)
+{
+    const BufferInfo bufferInfo = networkModel()->bufferInfo(bufferId);
+    if (bufferInfo.type() != BufferInfo::ChannelBuffer)
+        return;
+
+    Network *network = instance()->_networks.value(bufferInfo.networkId());
+    if (!network)
+        return;
+
+    IrcChannel *ircChannel = network->ircChannel(bufferInfo.bufferName());
+    if (ircChannel)
+        ircChannel->fetchUsers();
+}
+
+
 void Client::bufferRemoved(BufferId bufferId)
 {
     // select a sane buffer (status buffer)
@@ -723,6 +765,8 @@ void Client::bufferRenamed(BufferId bufferId, const QString &newName)
 
 void Client::buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2)
 {
+    backlogManager()->buffersPermanentlyMerged(bufferId1, bufferId2);
+
     QModelIndex idx = networkModel()->bufferIndex(bufferId1);
     bufferModel()->setCurrentIndex(bufferModel()->mapFromSource(idx));
     networkModel()->removeBuffer(bufferId2);
@@ -149,6 +149,9 @@ public:
     static void mergeBuffersPermanently(BufferId bufferId1, BufferId bufferId2);
     static void purgeKnownBufferIds();
 
+    //! Makes sure we know the users of the given channel buffer, if the core didn't send them right away
+    static void fetchChannelUsers(BufferId bufferId);
+
     /**
      * Requests client to resynchronize the CoreInfo object for legacy (pre-0.13) cores
      *
@@ -297,6 +300,7 @@ private:
     void init();
 
     void requestInitialBacklog();
+    void prefetchChannelUsers();
 
     /**
      * Deletes and resynchronizes the CoreInfo object for legacy (pre-0.13) cores
@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "clientbacklogcache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QMap>
+
+#include "util.h"
+
+static const quint32 logMagic = 0x51424c43; // "QBLC"
+static const quint32 logVersion = 1;
+
+// Records that may pile up before the log gets rewritten, beyond twice the records kept at the last rewrite
+static const int compactionSlack = 10000;
+
+ClientBacklogCache::ClientBacklogCache(const QString &fileName, int bufferSize, const QHash<BufferId, BufferInfo> &bufferInfos)
+    : QObject(),
+    _fileName(fileName),
+    _bufferSize(bufferSize),
+    _bufferInfos(bufferInfos),
+    _flushTimer(new QTimer(this))
+{
+    qRegisterMetaType<ClientBacklogCache::Backlog>("ClientBacklogCache::Backlog");
+
+    _flushTimer->setSingleShot(true);
+    _flushTimer->setInterval(5000);
+    connect(_flushTimer, SIGNAL(timeout()), SLOT(flush()));
+
+    moveToThread(&_thread);
+    _thread.start();
+}
+
+
+ClientBacklogCache::~ClientBacklogCache()
+{
+    if (_thread.isRunning()) {
+        QMetaObject::invokeMethod(this, "flush", Qt::BlockingQueuedConnection);
+        _thread.quit();
+        _thread.wait();
+    }
+}
+
+
+void ClientBacklogCache::load()
+{
+    QMetaObject::invokeMethod(this, "readCache", Qt::QueuedConnection);
+}
+
+
+void ClientBacklogCache::readCache()
+{
+    Backlog messages = readLog(true);
+
+    int kept = 0;
+    foreach(const MessageList &msgs, messages)
+        kept += msgs.count();
+
+    // Get rid of superseded records right away
+    if (_records > kept)
+        writeLog(messages);
+
+    emit loaded(messages);
+}
+
+
+int ClientBacklogCache::serialize(QByteArray &data, const MessageList &messages)
+{
+    QDataStream out(&data, QIODevice::Append);
+    out.setVersion(QDataStream::Qt_4_2);
+    int records = 0;
+    foreach(const Message &msg, messages) {
+        if (!msg.msgId().isValid() || !msg.bufferId().isValid())
+            continue;
+
+        out << static_cast<quint8>(MessageRecord) << msg.bufferId().toInt() << msg.msgId().toQint64()
+            << msg.timestamp().toMSecsSinceEpoch() << static_cast<quint32>(msg.type())
+            << static_cast<quint8>(msg.flags()) << msg.sender() << msg.senderPrefixes() << msg.realName()
+            << msg.avatarUrl() << msg.contents();
+        records++;
+    }
+    return records;
+}
+
+
+void ClientBacklogCache::addMessages(const MessageList &messages)
+{
+    {
+        QMutexLocker locker(&_pendingMutex);
+        _pendingRecords += serialize(_pending, messages);
+    }
+    QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+}
+
+
+void ClientBacklogCache::removeBuffer(BufferId bufferId)
+{
+    {
+        QMutexLocker locker(&_pendingMutex);
+        QDataStream out(&_pending, QIODevice::Append);
+        out.setVersion(QDataStream::Qt_4_2);
+        out << static_cast<quint8>(RemoveBufferRecord) << bufferId.toInt();
+        _pendingRecords++;
+    }
+    QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+}
+
+
+void ClientBacklogCache::scheduleFlush()
+{
+    if (!_flushTimer->isActive())
+        _flushTimer->start();
+}
+
+
+void ClientBacklogCache::flush()
+{
+    _flushTimer->stop();
+
+    QByteArray pending;
+    int pendingRecords;
+    {
+        QMutexLocker locker(&_pendingMutex);
+        pending.swap(_pending);
+        pendingRecords = _pendingRecords;
+        _pendingRecords = 0;
+    }
+    if (pending.isEmpty())
+        return;
+
+    QFile file(_fileName);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Append)) {
+        qWarning() << "Could not write backlog cache" << _fileName << ":" << file.errorString();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_2);
+    if (file.size() == 0)
+        out << logMagic << logVersion;
+    file.write(pending);
+    file.close();
+    _records += pendingRecords;
+
+    if (_records > 2 * _compactedRecords + compactionSlack)
+        compact();
+}
+
+
+void ClientBacklogCache::compact()
+{
+    // Buffers created since we loaded the log aren't known here, but are still worth keeping
+    writeLog(readLog(false));
+}
+
+
+ClientBacklogCache::Backlog ClientBacklogCache::readLog(bool knownBuffersOnly)
+{
+    Backlog result;
+    _records = 0;
+
+    QFile file(_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_2);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != logMagic || version != logVersion) {
+        qWarning() << "Ignoring invalid backlog cache" << _fileName;
+        return result;
+    }
+
+    QHash<BufferId, QMap<MsgId, Message> > messages;
+    while (!in.atEnd()) {
+        quint8 recordType;
+        qint32 bufferId;
+        in >> recordType >> bufferId;
+
+        if (recordType == RemoveBufferRecord) {
+            messages.remove(bufferId);
+        }
+        else {
+            qint64 msgId, timestamp;
+            quint32 type;
+            quint8 flags;
+            QString sender, senderPrefixes, realName, avatarUrl, contents;
+            in >> msgId >> timestamp >> type >> flags >> sender >> senderPrefixes >> realName >> avatarUrl >> contents;
+            if (in.status() != QDataStream::Ok)
+                break; // the last record may be incomplete, if we didn't get to finish writing it
+
+            // Buffers may have been removed since
+            BufferInfo bufferInfo = _bufferInfos.value(bufferId);
+            if (!bufferInfo.isValid()) {
+                if (knownBuffersOnly)
+                    continue;
+                bufferInfo = BufferInfo(bufferId, NetworkId(), BufferInfo::InvalidBuffer);
+            }
+
+            Message msg(QDateTime::fromMSecsSinceEpoch(timestamp), bufferInfo, Message::Type(type), contents,
+                internString(sender), internString(senderPrefixes), internString(realName), internString(avatarUrl),
+                Message::Flags(flags) | Message::Backlog);
+            msg.setMsgId(msgId);
+            messages[bufferId].insert(msgId, msg);
+        }
+        if (in.status() != QDataStream::Ok)
+            break;
+        _records++;
+    }
+
+    // Only keep the newest messages of each buffer
+    for (auto iter = messages.constBegin(); iter != messages.constEnd(); ++iter) {
+        if (iter.value().isEmpty())
+            continue;
+        MessageList msgs = iter.value().values();
+        result[iter.key()] = msgs.mid(qMax(0, msgs.count() - _bufferSize));
+    }
+    return result;
+}
+
+
+bool ClientBacklogCache::writeLog(const Backlog &messages)
+{
+    // Write to a new file first, so we don't lose the cache if anything goes wrong
+    QString newFileName = _fileName + ".new";
+    QFile file(newFileName);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning() << "Could not write backlog cache" << newFileName << ":" << file.errorString();
+        return false;
+    }
+
+    QByteArray data;
+    int records = 0;
+    foreach(const MessageList &msgs, messages)
+        records += serialize(data, msgs);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << logMagic << logVersion;
+    file.write(data);
+    file.close();
+
+    if (file.error() != QFile::NoError || (QFile::exists(_fileName) && !QFile::remove(_fileName))
+        || !QFile::rename(newFileName, _fileName)) {
+        qWarning() << "Could not replace backlog cache" << _fileName;
+        return false;
+    }
+
+    _records = _compactedRecords = records;
+    return true;
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+
+#include "bufferinfo.h"
+#include "message.h"
+#include "types.h"
+
+//! Keeps the most recent messages of each buffer in an append-only log on disk
+/** The log consists of a record per message, and records dropping everything cached for a buffer.
+ *  Messages are only ever added contiguously to what is cached for their buffer, so after loading the
+ *  cache, the client only needs to request messages newer than the last cached one of each buffer.
+ *  Whenever the log has grown enough, it is rewritten with just the newest messages of each buffer.
+ *
+ *  All file access happens in a thread of its own, so large logs don't block the GUI.
+ */
+class ClientBacklogCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef QHash<BufferId, MessageList> Backlog;
+
+    //! The object lives in its own thread, so it can't have a parent
+    /** \param bufferInfos The buffers known to the client; cached messages of other buffers are dropped */
+    ClientBacklogCache(const QString &fileName, int bufferSize, const QHash<BufferId, BufferInfo> &bufferInfos);
+    ~ClientBacklogCache() override;
+
+    //! Reads the log in the background, emitting loaded() once done
+    void load();
+
+    void addMessages(const MessageList &messages);
+    void removeBuffer(BufferId bufferId);
+
+signals:
+    //! Emitted once the log has been read, with the cached messages of each buffer sorted by their MsgId
+    void loaded(const ClientBacklogCache::Backlog &messages);
+
+private slots:
+    void readCache();
+    void scheduleFlush();
+    void flush();
+
+private:
+    enum RecordType : quint8 {
+        MessageRecord,
+        RemoveBufferRecord
+    };
+
+    static int serialize(QByteArray &data, const MessageList &messages);
+    Backlog readLog(bool knownBuffersOnly);
+    bool writeLog(const Backlog &messages);
+    void compact();
+
+    QString _fileName;
+    int _bufferSize;
+    QHash<BufferId, BufferInfo> _bufferInfos;
+
+    QMutex _pendingMutex; // guards _pending and _pendingRecords, which are filled from the GUI thread
+    QByteArray _pending;
+    int _pendingRecords{0};
+
+    int _records{0};
+    int _compactedRecords{0};
+
+    QThread _thread;
+    QTimer *_flushTimer;
+};
@@ -24,16 +24,20 @@
 #include "backlogsettings.h"
 #include "backlogrequester.h"
 #include "client.h"
+#include "messagemodel.h"
+#include "quassel.h"
 
 #include <ctime>
 
 #include <QDebug>
+#include <QDir>
 
 INIT_SYNCABLE_OBJECT(ClientBacklogManager)
 ClientBacklogManager::ClientBacklogManager(QObject *parent)
     : BacklogManager(parent),
     _requester(0),
-    _initBacklogRequested(false)
+    _initBacklogRequested(false),
+    _cache(0)
 {
 }
 
@@ -41,6 +45,21 @@ ClientBacklogManager::ClientBacklogManager(QObject *parent)
 QVariantList ClientBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
     _buffersRequested << bufferId;
+
+    // If we have the newest messages of this buffer cached, show them right away and only ask the core for what's newer.
+    // The reply includes the last cached message again, unless there were more new messages than the limit.
+    if (last == -1 && _cachedMessages.contains(bufferId)) {
+        MessageList cached = _cachedMessages.take(bufferId);
+        MsgId lastCached = cached.last().msgId();
+        if (lastCached >= first) {
+            _cacheValidation[bufferId] = lastCached;
+            dispatchMessages(cached);
+            return BacklogManager::requestBacklog(bufferId, lastCached, -1, limit, 0);
+        }
+        // The cache ends before what we're asked for, so the reply won't continue it
+        _cache->removeBuffer(bufferId);
+    }
+
     return BacklogManager::requestBacklog(bufferId, first, last, limit, additional);
 }
 
@@ -58,6 +77,8 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
         msglist << msg;
     }
 
+    updateCache(bufferId, msglist);
+
     if (isBuffering()) {
         bool lastPart = !_requester->buffer(bufferId, msglist);
         updateProgress(_requester->totalBuffers() - _requester->buffersWaiting(), _requester->totalBuffers());
@@ -83,14 +104,14 @@ void ClientBacklogManager::receiveBacklogAll(MsgId first, MsgId last, int limit,
         msglist << msg;
     }
 
+    // We only get here with the global unread requester, which doesn't use the cache
     dispatchMessages(msglist);
 }
 
 
 void ClientBacklogManager::requestInitialBacklog()
 {
-    if (_initBacklogRequested) {
-        Q_ASSERT(_requester);
+    if (_requester) {
         qWarning() << "ClientBacklogManager::requestInitialBacklog() called twice in the same session! (Backlog has already been requested)";
         return;
     }
@@ -108,6 +129,40 @@ void ClientBacklogManager::requestInitialBacklog()
         _requester = new FixedBacklogRequester(this);
     };
 
+    int diskCacheSize = settings.diskCacheSize();
+    AccountId accountId = Client::currentCoreAccount().accountId();
+    if (diskCacheSize > 0 && accountId.isValid() && _requester->type() != BacklogRequester::GlobalUnread) {
+        QString cacheDir = Quassel::configDirPath() + "backlogcache";
+        QDir().mkpath(cacheDir);
+
+        QHash<BufferId, BufferInfo> bufferInfos;
+        foreach(BufferId bufferId, Client::networkModel()->allBufferIds())
+            bufferInfos[bufferId] = Client::networkModel()->bufferInfo(bufferId);
+
+        // The cache is read in the background, so only ask for backlog once we know what's cached
+        _cache = new ClientBacklogCache(QString("%1/%2.log").arg(cacheDir).arg(accountId.toInt()), diskCacheSize, bufferInfos);
+        connect(_cache, SIGNAL(loaded(ClientBacklogCache::Backlog)), SLOT(cacheLoaded(ClientBacklogCache::Backlog)));
+        _cache->load();
+        return;
+    }
+
+    startInitialBacklog();
+}
+
+
+void ClientBacklogManager::cacheLoaded(const ClientBacklogCache::Backlog &messages)
+{
+    // We might have been reset in the meantime
+    if (sender() != _cache || _initBacklogRequested)
+        return;
+
+    _cachedMessages = messages;
+    startInitialBacklog();
+}
+
+
+void ClientBacklogManager::startInitialBacklog()
+{
     _requester->requestInitialBacklog();
     _initBacklogRequested = true;
     if (_requester->isBuffering()) {
@@ -179,10 +234,62 @@ void ClientBacklogManager::dispatchMessages(const MessageList &messages, bool so
 }
 
 
+void ClientBacklogManager::updateCache(BufferId bufferId, const MessageList &messages)
+{
+    if (!_cache)
+        return;
+
+    if (_cacheValidation.contains(bufferId)) {
+        MsgId expected = _cacheValidation.take(bufferId);
+        bool contiguous = false;
+        foreach(const Message &msg, messages) {
+            if (msg.msgId() == expected) {
+                contiguous = true;
+                break;
+            }
+        }
+        if (!contiguous) {
+            // Too many messages arrived while we were away, so there's a gap between the cached messages and the reply
+            Client::messageModel()->removeMessages(bufferId, expected);
+            _cache->removeBuffer(bufferId);
+        }
+    }
+
+    _cache->addMessages(messages);
+}
+
+
+void ClientBacklogManager::cacheMessage(const Message &msg)
+{
+    // Only buffers we requested backlog for are known to be contiguous with what we've cached
+    if (_cache && _buffersRequested.contains(msg.bufferId()))
+        _cache->addMessages(MessageList() << msg);
+}
+
+
+void ClientBacklogManager::buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2)
+{
+    if (!_cache)
+        return;
+
+    // The merged buffer's messages end up among those of the first one, so what we've cached of it no longer is contiguous
+    foreach(BufferId bufferId, QList<BufferId>() << bufferId1 << bufferId2) {
+        _cachedMessages.remove(bufferId);
+        _cacheValidation.remove(bufferId);
+        _cache->removeBuffer(bufferId);
+    }
+}
+
+
 void ClientBacklogManager::reset()
 {
     delete _requester;
     _requester = 0;
     _initBacklogRequested = false;
     _buffersRequested.clear();
+
+    delete _cache;
+    _cache = 0;
+    _cachedMessages.clear();
+    _cacheValidation.clear();
 }
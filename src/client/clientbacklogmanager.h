@@ -22,6 +22,7 @@
 #define CLIENTBACKLOGMANAGER_H
 
 #include "backlogmanager.h"
+#include "clientbacklogcache.h"
 #include "message.h"
 
 class BacklogRequester;
@@ -39,6 +40,12 @@ public:
 
     void reset();
 
+    //! Adds a message received while connected to the on-disk cache, if enabled
+    void cacheMessage(const Message &msg);
+
+    //! Drops what's cached of both buffers, as the second one's messages now belong to the first one
+    void buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2);
+
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     virtual void receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
@@ -56,15 +63,24 @@ signals:
 
     void updateProgress(int, int);
 
+private slots:
+    void cacheLoaded(const ClientBacklogCache::Backlog &messages);
+
 private:
+    void startInitialBacklog();
     bool isBuffering();
     BufferIdList filterNewBufferIds(const BufferIdList &bufferIds);
 
     void dispatchMessages(const MessageList &messages, bool sort = false);
+    void updateCache(BufferId bufferId, const MessageList &messages);
 
     BacklogRequester *_requester;
     bool _initBacklogRequested;
     QSet<BufferId> _buffersRequested;
+
+    ClientBacklogCache *_cache;
+    QHash<BufferId, MessageList> _cachedMessages; // loaded from the cache, but not requested yet
+    QHash<BufferId, MsgId> _cacheValidation; // last cached message expected in the next backlog reply
 };
 
 
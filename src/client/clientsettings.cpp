@@ -163,7 +163,8 @@ QVariantMap CoreAccountSettings::retrieveAccountData(AccountId id)
 
 void CoreAccountSettings::setAccountValue(const QString &key, const QVariant &value)
 {
-    if (!Client::currentCoreAccount().isValid())
+    // Headless users of ClientAuthHandler (like the load client) don't have a Client
+    if (!Client::instanceExists() || !Client::currentCoreAccount().isValid())
         return;
     setLocalValue(QString("%1/%2/%3").arg(Client::currentCoreAccount().accountId().toInt()).arg(_subgroup).arg(key), value);
 }
@@ -171,7 +172,7 @@ void CoreAccountSettings::setAccountValue(const QString &key, const QVariant &va
 
 QVariant CoreAccountSettings::accountValue(const QString &key, const QVariant &def)
 {
-    if (!Client::currentCoreAccount().isValid())
+    if (!Client::instanceExists() || !Client::currentCoreAccount().isValid())
         return QVariant();
     return localValue(QString("%1/%2/%3").arg(Client::currentCoreAccount().accountId().toInt()).arg(_subgroup).arg(key), def);
 }
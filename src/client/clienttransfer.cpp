@@ -19,21 +19,34 @@
  ***************************************************************************/
 
 #include <QFile>
+#include <QFileInfo>
 
 #include "clienttransfer.h"
 
+#include "client.h"
+
+// Size of the ranges fetched from a spooled transfer; the core serves at most 64 KiB at a time
+const quint64 rangeSize = 64 * 1024;
+
 INIT_SYNCABLE_OBJECT(ClientTransfer)
 ClientTransfer::ClientTransfer(const QUuid &uuid, QObject *parent)
     : Transfer(uuid, parent),
+    _resume(false),
+    _fetching(false),
+    _requested(0),
     _file(0)
 {
     connect(this, SIGNAL(statusChanged(Transfer::Status)), SLOT(onStatusChanged(Transfer::Status)));
+
+    // A spooled transfer is fetched once we know where to save it
+    connect(this, SIGNAL(accepted(PeerPtr)), SLOT(startFetching()));
+    connect(this, SIGNAL(spooledChanged(bool)), SLOT(startFetching()));
 }
 
 
 quint64 ClientTransfer::transferred() const
 {
-    if (status() == Status::Completed)
+    if (status() == Status::Completed && !_fetching)
         return fileSize();
 
     return _file ? _file->size() : 0;
@@ -42,6 +55,9 @@ quint64 ClientTransfer::transferred() const
 
 void ClientTransfer::cleanUp()
 {
+    if (_fetching)
+        return; // the core is done, but we still need to fetch the rest of the file
+
     if (_file) {
         _file->close();
         _file->deleteLater();
@@ -65,6 +81,17 @@ void ClientTransfer::accept(const QString &savePath) const
 }
 
 
+void ClientTransfer::resume(const QString &savePath) const
+{
+    _savePath = savePath;
+    _resume = true;
+    PeerPtr ptr = 0;
+    quint64 position = QFileInfo(savePath).size();
+    REQUEST_OTHER(requestResumed, ARG(ptr), ARG(position));
+    emit accepted();
+}
+
+
 void ClientTransfer::reject() const
 {
     PeerPtr ptr = 0;
@@ -78,7 +105,7 @@ void ClientTransfer::dataReceived(PeerPtr, const QByteArray &data)
     // TODO: proper error handling (relay to core)
     if (!_file) {
         _file = new QFile(_savePath, this);
-        if (!_file->open(QFile::WriteOnly|QFile::Truncate)) {
+        if (!_file->open(QFile::WriteOnly|(_resume ? QFile::Append : QFile::Truncate))) {
             qWarning() << Q_FUNC_INFO << "Could not open file:" << _file->errorString();
             return;
         }
@@ -92,6 +119,13 @@ void ClientTransfer::dataReceived(PeerPtr, const QByteArray &data)
         return;
     }
 
+    // Let the core know that we have made room for more data
+    if (Client::isCoreFeatureEnabled(Quassel::Feature::TransferFlowControl)) {
+        PeerPtr ptr = 0;
+        quint64 position = _file->size();
+        REQUEST_OTHER(requestDataAcknowledged, ARG(ptr), ARG(position));
+    }
+
     emit transferredChanged(transferred());
 }
 
@@ -100,10 +134,11 @@ void ClientTransfer::onStatusChanged(Transfer::Status status)
 {
     switch(status) {
         case Status::Completed:
-            if (_file)
+            if (_file && !_fetching)
                 _file->close();
             break;
         case Status::Failed:
+            _fetching = false;
             if (_file)
                 _file->remove();
             break;
@@ -111,3 +146,87 @@ void ClientTransfer::onStatusChanged(Transfer::Status status)
             ;
     }
 }
+
+
+void ClientTransfer::startFetching()
+{
+    if (_fetching || !isSpooled() || _savePath.isEmpty() || status() == Status::Failed)
+        return;
+
+    if (!_file) {
+        _file = new QFile(_savePath, this);
+        if (!_file->open(QFile::WriteOnly|(_resume ? QFile::Append : QFile::Truncate))) {
+            qWarning() << Q_FUNC_INFO << "Could not open file:" << _file->errorString();
+            return;
+        }
+    }
+
+    _fetching = true;
+    _requested = _file->size();
+    if (_requested >= fileSize()) {
+        finishFetching();
+        return;
+    }
+
+    // Keep two ranges in flight, so the core has the next one at hand while we write the current one
+    requestNextRange();
+    requestNextRange();
+}
+
+
+void ClientTransfer::requestNextRange()
+{
+    if (_requested >= fileSize())
+        return;
+
+    PeerPtr ptr = 0;
+    quint64 position = _requested;
+    quint64 length = qMin(rangeSize, fileSize() - _requested);
+    REQUEST_OTHER(requestRange, ARG(ptr), ARG(position), ARG(length));
+    _requested += length;
+}
+
+
+void ClientTransfer::rangeReceived(PeerPtr, quint64 position, const QByteArray &data)
+{
+    if (!_fetching || !_file->isOpen())
+        return;
+
+    if (position != static_cast<quint64>(_file->size())) {
+        qWarning() << Q_FUNC_INFO << "Received range at" << position << "while expecting" << _file->size();
+        return;
+    }
+
+    if (_file->write(data) < 0) {
+        qWarning() << Q_FUNC_INFO << "Could not write to file:" << _file->errorString();
+        _fetching = false;
+        return;
+    }
+
+    emit transferredChanged(transferred());
+
+    if (static_cast<quint64>(_file->size()) >= fileSize())
+        finishFetching();
+    else
+        requestNextRange();
+}
+
+
+void ClientTransfer::rangeRejected(PeerPtr, quint64 position, const QString &reason)
+{
+    if (!_fetching)
+        return;
+
+    // The core doesn't have what we asked for, e.g. the start of a file resumed into a different local file
+    qWarning() << Q_FUNC_INFO << "Range at" << position << "rejected:" << reason;
+    _fetching = false;
+    emit error(reason);
+}
+
+
+void ClientTransfer::finishFetching()
+{
+    _fetching = false;
+    cleanUp();
+    emit transferredChanged(transferred());
+}
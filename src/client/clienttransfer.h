@@ -42,16 +42,26 @@ public:
 public slots:
     // called on the client side
     void accept(const QString &savePath) const override;
+    void resume(const QString &savePath) const override;
     void reject() const override;
 
 private slots:
     void dataReceived(PeerPtr peer, const QByteArray &data) override;
+    void rangeReceived(PeerPtr peer, quint64 position, const QByteArray &data) override;
+    void rangeRejected(PeerPtr peer, quint64 position, const QString &reason) override;
     void onStatusChanged(Transfer::Status status);
+    void startFetching();
 
 private:
     void cleanUp() override;
+    void requestNextRange();
+    void finishFetching();
 
     mutable QString _savePath;
+    mutable bool _resume;
+
+    bool _fetching;
+    quint64 _requested;
 
     QFile *_file;
 };
@@ -20,6 +20,8 @@
 
 #include "messagemodel.h"
 
+#include <algorithm>
+
 #include <QEvent>
 
 #include "backlogsettings.h"
@@ -47,6 +49,11 @@ MessageModel::MessageModel(QObject *parent)
     _dayChangeTimer.setInterval(QDateTime::currentDateTime().secsTo(_nextDayChange) * 1000);
     _dayChangeTimer.start();
     connect(&_dayChangeTimer, SIGNAL(timeout()), this, SLOT(changeOfDay()));
+
+    // Checking the memory budget means going over all messages, so only do that once things have settled
+    _evictionTimer.setSingleShot(true);
+    _evictionTimer.setInterval(10000);
+    connect(&_evictionTimer, SIGNAL(timeout()), this, SLOT(evictMessages()));
 }
 
 
@@ -88,6 +95,8 @@ bool MessageModel::insertMessage(const Message &msg, bool fakeMsg)
     }
 
     insertMessageGroup(QList<Message>() << msg);
+    if (!_evictionTimer.isActive())
+        _evictionTimer.start();
     return true;
 }
 
@@ -97,6 +106,9 @@ void MessageModel::insertMessages(const QList<Message> &msglist)
     if (msglist.isEmpty())
         return;
 
+    if (!_evictionTimer.isActive())
+        _evictionTimer.start();
+
     if (_messageBuffer.isEmpty()) {
         int processedMsgs = insertMessagesGracefully(msglist);
         int remainingMsgs = msglist.count() - processedMsgs;
@@ -426,6 +438,158 @@ void MessageModel::messagesReceived(BufferId bufferId, int count)
 }
 
 
+void MessageModel::bufferShown(BufferId bufferId)
+{
+    _shownBuffer = bufferId;
+    _lastShown[bufferId] = QDateTime::currentMSecsSinceEpoch();
+
+    // the previously shown buffer may have become a candidate
+    if (!_evictionTimer.isActive())
+        _evictionTimer.start();
+}
+
+
+qint64 MessageModel::estimatedCost(const MessageModelItem *item)
+{
+    // Rough guess for the model item, its chat line and layout data, plus the contents being kept both
+    // raw and as styled plain text
+    return 512 + 4 * item->message().contents().size();
+}
+
+
+void MessageModel::evictMessages()
+{
+    qint64 budget = BacklogSettings().memoryBudget() * 1024 * 1024;
+    if (budget <= 0)
+        return;
+
+    // One pass over all messages collects the rows of each buffer along with their cost
+    QHash<BufferId, QList<int> > bufferRows;
+    QHash<BufferId, qint64> bufferCost;
+    qint64 totalCost = 0;
+    for (int i = 0; i < messageCount(); i++) {
+        const MessageModelItem *item = messageItemAt(i);
+        qint64 cost = estimatedCost(item);
+        totalCost += cost;
+        if (item->bufferId().isValid()) {
+            bufferRows[item->bufferId()] << i;
+            bufferCost[item->bufferId()] += cost;
+        }
+    }
+    if (totalCost <= budget)
+        return;
+
+    // Evict from the buffers that have been shown least recently (or never) first. Leave the one on screen
+    // alone, as well as those still waiting for backlog, whose request refers to their current first message.
+    QList<BufferId> candidates;
+    foreach(BufferId bufferId, bufferCost.keys()) {
+        if (bufferId != _shownBuffer && !_messagesWaiting.contains(bufferId))
+            candidates << bufferId;
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](BufferId a, BufferId b) {
+        return _lastShown.value(a) < _lastShown.value(b);
+    });
+
+    QList<int> rows;
+    foreach(BufferId bufferId, candidates) {
+        if (totalCost <= budget)
+            break;
+        const QList<int> &candidateRows = bufferRows[bufferId];
+        int evictCount = evictableCount(bufferId, candidateRows);
+        for (int i = 0; i < evictCount; i++) {
+            rows << candidateRows.at(i);
+            totalCost -= estimatedCost(messageItemAt(candidateRows.at(i)));
+        }
+    }
+    if (rows.isEmpty())
+        return;
+
+    std::sort(rows.begin(), rows.end());
+    removeMessageRows(rows);
+}
+
+
+// Returns how many of the oldest messages of the given buffer, whose rows are passed, can go. We only ever cut
+// from the old end, so scrolling up in the buffer fetches them again through requestBacklog().
+int MessageModel::evictableCount(BufferId bufferId, const QList<int> &rows) const
+{
+    const int markerLineContext = 10;
+
+    // Keep what one backlog request would bring back, and anything unread plus a bit of context
+    BacklogSettings backlogSettings;
+    int keep = backlogSettings.dynamicBacklogAmount();
+    MsgId markerLine = Client::markerLine(bufferId);
+    if (markerLine.isValid()) {
+        int firstUnread = rows.count();
+        while (firstUnread > 0 && messageItemAt(rows.at(firstUnread - 1))->msgId() > markerLine)
+            firstUnread--;
+        keep = qMax(keep, rows.count() - firstUnread + markerLineContext);
+    }
+    int evictCount = rows.count() - keep;
+
+    // Highlights stay with some context too, even if they have been read already
+    for (int i = 0; i < evictCount; i++) {
+        if (messageItemAt(rows.at(i))->msgFlags() & Message::Highlight) {
+            evictCount = i - markerLineContext;
+            break;
+        }
+    }
+    return qMax(evictCount, 0);
+}
+
+
+void MessageModel::removeMessages(BufferId bufferId, MsgId last)
+{
+    QList<int> rows;
+    for (int i = 0; i < messageCount() && messageItemAt(i)->msgId() <= last; i++) {
+        if (messageItemAt(i)->bufferId() == bufferId)
+            rows << i;
+    }
+    removeMessageRows(rows);
+
+    // messages not inserted yet shall not show up later either
+    QList<Message>::iterator iter = _messageBuffer.begin();
+    while (iter != _messageBuffer.end()) {
+        if (iter->bufferId() == bufferId && iter->msgId() <= last)
+            iter = _messageBuffer.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+
+// Removes the given rows, which need to be sorted
+void MessageModel::removeMessageRows(const QList<int> &rows)
+{
+    // Contiguous runs of rows, as (start, end) pairs
+    QList<QPair<int, int> > runs;
+    foreach(int row, rows) {
+        if (!runs.isEmpty() && runs.last().second == row - 1)
+            runs.last().second = row;
+        else
+            runs << qMakePair(row, row);
+    }
+
+    // Each removal has every view and filter on top of us walk its rows, so rows scattered over many buffers
+    // are better dropped under a single reset
+    const int maxRemovalRuns = 16;
+    if (runs.count() > maxRemovalRuns) {
+        beginResetModel();
+        removeMessages__(rows);
+        endResetModel();
+        return;
+    }
+
+    // Starting from the back keeps the remaining row numbers valid
+    for (int i = runs.count() - 1; i >= 0; i--) {
+        beginRemoveRows(QModelIndex(), runs.at(i).first, runs.at(i).second);
+        for (int row = runs.at(i).second; row >= runs.at(i).first; row--)
+            removeMessageAt(row);
+        endRemoveRows();
+    }
+}
+
+
 void MessageModel::buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2)
 {
     for (int i = 0; i < messageCount(); i++) {
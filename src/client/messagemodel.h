@@ -73,6 +73,12 @@ public:
 
     void clear();
 
+    //! Marks the given buffer as the one currently shown, protecting it from eviction
+    void bufferShown(BufferId bufferId);
+
+    //! Removes the messages of the given buffer up to and including the given one
+    void removeMessages(BufferId bufferId, MsgId last);
+
 signals:
     void finishedBacklogFetch(BufferId bufferId);
 
@@ -96,6 +102,7 @@ protected:
     virtual void insertMessage__(int pos, const Message &) = 0;
     virtual void insertMessages__(int pos, const QList<Message> &) = 0;
     virtual void removeMessageAt(int i) = 0;
+    virtual void removeMessages__(const QList<int> &rows) = 0; // rows need to be sorted
     virtual void removeAllMessages() = 0;
     virtual Message takeMessageAt(int i) = 0;
 
@@ -103,11 +110,15 @@ protected:
 
 private slots:
     void changeOfDay();
+    void evictMessages();
 
 private:
     void insertMessageGroup(const QList<Message> &);
     int insertMessagesGracefully(const QList<Message> &); // inserts as many contiguous msgs as possible. returns numer of inserted msgs.
     int indexForId(MsgId);
+    int evictableCount(BufferId bufferId, const QList<int> &rows) const;
+    void removeMessageRows(const QList<int> &rows);
+    static qint64 estimatedCost(const MessageModelItem *item);
 
     //  QList<MessageModelItem *> _messageList;
     QList<Message> _messageBuffer;
@@ -115,6 +126,10 @@ private:
     QDateTime _nextDayChange;
     QHash<BufferId, int> _messagesWaiting;
 
+    QTimer _evictionTimer;
+    BufferId _shownBuffer;
+    QHash<BufferId, qint64> _lastShown;
+
     /// Period of time for one day in milliseconds
     /// 24 hours * 60 minutes * 60 seconds * 1000 milliseconds
     const qint64 DAY_IN_MSECS = 24 * 60 * 60 * 1000;
@@ -149,7 +164,7 @@ public:
     virtual bool setData(int column, const QVariant &value, int role);
 
     virtual const Message &message() const = 0;
-    virtual const QDateTime &timestamp() const = 0;
+    virtual QDateTime timestamp() const = 0;
     virtual const MsgId &msgId() const = 0;
     virtual const BufferId &bufferId() const = 0;
     virtual void setBufferId(BufferId bufferId) = 0;
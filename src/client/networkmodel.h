@@ -211,7 +211,7 @@ public:
     virtual QString toolTip(int column) const;
 
     virtual inline QString topic() const { return (bool)_ircChannel ? _ircChannel->topic() : QString(); }
-    virtual inline int nickCount() const { return (bool)_ircChannel ? _ircChannel->ircUsers().count() : 0; }
+    virtual inline int nickCount() const { return (bool)_ircChannel ? _ircChannel->userCount() : 0; }
 
     void attachIrcChannel(IrcChannel *ircChannel);
 
@@ -90,7 +90,7 @@ QDataStream &operator>>(QDataStream &in, BufferInfo &bufferInfo)
     qint16 bufferType;
     in >> bufferInfo._bufferId >> bufferInfo._netid >> bufferType >> bufferInfo._groupId >> buffername;
     bufferInfo._type = (BufferInfo::Type)bufferType;
-    bufferInfo._bufferName = QString::fromUtf8(buffername);
+    bufferInfo._bufferName = internString(QString::fromUtf8(buffername));
     return in;
 }
 
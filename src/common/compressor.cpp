@@ -165,7 +165,9 @@ void Compressor::readData()
         return;
 
     if (compressionLevel() == NoCompression) {
+        int oldSize = _readBuffer.size();
         _readBuffer.append(_socket->read(maxBufferSize - _readBuffer.size()));
+        _socketBytesRead += _readBuffer.size() - oldSize;
         emit readyRead();
         return;
     }
@@ -178,7 +180,9 @@ void Compressor::readData()
 
     while (_socket->bytesAvailable() && _readBuffer.size() + ioBufferSize < maxBufferSize && _inputBuffer.size() < ioBufferSize) {
         _readBuffer.resize(_readBuffer.size() + ioBufferSize);
+        int oldSize = _inputBuffer.size();
         _inputBuffer.append(_socket->read(ioBufferSize - _inputBuffer.size()));
+        _socketBytesRead += _inputBuffer.size() - oldSize;
 
         _inflater->next_in = reinterpret_cast<unsigned char *>(_inputBuffer.data());
         _inflater->avail_in = _inputBuffer.size();
@@ -225,6 +229,7 @@ void Compressor::writeData()
 {
     if (compressionLevel() == NoCompression) {
         _socket->write(_writeBuffer);
+        _socketBytesWritten += _writeBuffer.size();
         _writeBuffer.clear();
         return;
     }
@@ -251,6 +256,7 @@ void Compressor::writeData()
             emit error(DeviceError);
             return;
         }
+        _socketBytesWritten += ioBufferSize - _deflater->avail_out;
     } while (_deflater->avail_out == 0); // the output buffer being full is the only reason we should have to loop here!
 
     if (_deflater->avail_in > 0) {
@@ -61,6 +61,10 @@ public:
 
     qint64 bytesAvailable() const;
 
+    //! Number of bytes read from/written to the socket so far, i.e. in compressed form
+    inline qint64 socketBytesRead() const { return _socketBytesRead; }
+    inline qint64 socketBytesWritten() const { return _socketBytesWritten; }
+
     qint64 read(char *data, qint64 maxSize);
     qint64 write(const char *data, qint64 count, WriteBufferHint flush = Flush);
 
@@ -89,6 +93,9 @@ private:
 
     z_streamp _inflater;
     z_streamp _deflater;
+
+    qint64 _socketBytesRead{0};
+    qint64 _socketBytesWritten{0};
 };
 
 #endif
@@ -26,6 +26,7 @@
 
 #include "event.h"
 #include "ircevent.h"
+#include "metrics.h"
 
 // ============================================================
 //  QueuedEvent
@@ -259,6 +260,13 @@ void EventManager::dispatchEvent(Event *event)
     QSet<QObject *> ignored;
     uint type = event->type();
 
+    if (Metrics::isEnabled()) {
+        QString typeName = enumName(type);
+        if (typeName.isEmpty())
+            typeName = enumName(type & ~IrcEventNumericMask); // numerics are not in the enum individually
+        Metrics::add("quassel_events_dispatched_total", Metrics::label("type", typeName));
+    }
+
     bool checkDupes = false;
 
     // special handling for numeric IrcEvents
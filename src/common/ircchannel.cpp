@@ -37,6 +37,9 @@ IrcChannel::IrcChannel(const QString &channelname, Network *network)
     _name(channelname),
     _topic(QString()),
     _encrypted(false),
+    _usersPending(false),
+    _usersRequested(false),
+    _pendingUserCount(0),
     _network(network),
     _codecForEncoding(0),
     _codecForDecoding(0)
@@ -80,6 +83,12 @@ bool IrcChannel::isValidChannelUserMode(const QString &mode) const
 }
 
 
+int IrcChannel::userCount() const
+{
+    return _usersPending ? _pendingUserCount : _userModes.count();
+}
+
+
 QString IrcChannel::userModes(IrcUser *ircuser) const
 {
     if (_userModes.contains(ircuser))
@@ -195,7 +204,6 @@ void IrcChannel::joinIrcUsers(const QList<IrcUser *> &users, const QStringList &
 
         _userModes[ircuser] = sortedModes[i];
         ircuser->joinChannel(this, true);
-        connect(ircuser, SIGNAL(nickSet(QString)), this, SLOT(ircUserNickSet(QString)));
 
         // connect(ircuser, SIGNAL(destroyed()), this, SLOT(ircUserDestroyed()));
         // If you wonder why there is no counterpart to ircUserJoined:
@@ -209,6 +217,10 @@ void IrcChannel::joinIrcUsers(const QList<IrcUser *> &users, const QStringList &
     if (newNicks.isEmpty())
         return;
 
+    // Users joining after we got the channel's user count, rather than those we get once fetching them
+    if (_usersPending && isInitialized())
+        _pendingUserCount += newUsers.count();
+
     SYNC_OTHER(joinIrcUsers, ARG(newNicks), ARG(newModes));
     emit ircUsersJoined(newUsers);
 }
@@ -216,9 +228,16 @@ void IrcChannel::joinIrcUsers(const QList<IrcUser *> &users, const QStringList &
 
 void IrcChannel::joinIrcUsers(const QStringList &nicks, const QStringList &modes)
 {
+    if (nicks.count() != modes.count()) {
+        qWarning() << "IrcChannel::joinIrcUsers(): number of nicks does not match number of modes!";
+        return;
+    }
+
+    // New users are part of our joinIrcUsers sync, so the clients create them without being told separately
     QList<IrcUser *> users;
+    users.reserve(nicks.count());
     foreach(QString nick, nicks)
-    users << network()->newIrcUser(nick);
+    users << network()->newIrcUser(nick, QVariantMap(), false);
     joinIrcUsers(users, modes);
 }
 
@@ -236,14 +255,31 @@ void IrcChannel::joinIrcUser(IrcUser *ircuser)
 void IrcChannel::part(IrcUser *ircuser)
 {
     if (isKnownUser(ircuser)) {
+        // Peers that haven't fetched our users may not know the user, and can't learn about the part from it
+        SignalProxy *proxy = network()->proxy();
+        if (proxy && proxy->proxyMode() == SignalProxy::Server) {
+            QSet<Peer *> peers = proxy->peersWithFeature(Quassel::Feature::LazyChannelUsers);
+            if (!peers.isEmpty()) {
+                QString nick = ircuser->nick();
+                proxy->restrictTargetPeers(peers, [&] {
+                    SYNC_OTHER(userParted, ARG(nick))
+                });
+            }
+        }
+
         _userModes.remove(ircuser);
+        if (_usersPending)
+            _pendingUserCount--;
+        // Only the user syncs the part (to peers knowing our users)
+        updateRevision();
         ircuser->partChannel(this);
         // If you wonder why there is no counterpart to ircUserParted:
         // the joins are propagted by the ircuser. The signal ircUserParted is only for convenience
         disconnect(ircuser, 0, this, 0);
         emit ircUserParted(ircuser);
 
-        if (network()->isMe(ircuser) || _userModes.isEmpty()) {
+        // The users of a channel may not have been fetched yet, so it's not empty just because we know no one in it
+        if (network()->isMe(ircuser) || (_userModes.isEmpty() && !_usersPending)) {
             // in either case we're no longer in the channel
             //  -> clean up the channel and destroy it
             QList<IrcUser *> users = _userModes.keys();
@@ -426,24 +462,90 @@ void IrcChannel::initSetChanModes(const QVariantMap &channelModes)
 }
 
 
+void IrcChannel::initSetUserCount(int count)
+{
+    // Only sent instead of the users, which we'll have to fetch later on
+    _usersPending = true;
+    _pendingUserCount = count;
+}
+
+
+void IrcChannel::fetchUsers()
+{
+    if (!_usersPending || _usersRequested)
+        return;
+
+    _usersRequested = true;
+    PeerPtr ptr = nullptr;
+    REQUEST_OTHER(requestUsers, ARG(ptr))
+}
+
+
+void IrcChannel::requestUsers(PeerPtr peer)
+{
+    SignalProxy *proxy = network()->proxy();
+    if (!peer || !proxy)
+        return;
+
+    // The users are encoded according to the features of the peer asking for them
+    proxy->setTargetPeer(peer);
+    QVariantMap users;
+    users["Users"] = network()->ircUsersToVariantMap(ircUsers());
+    users["UserModes"] = initUserModes();
+    proxy->setTargetPeer(nullptr);
+
+    proxy->restrictTargetPeers(peer, [&] {
+        SYNC_OTHER(usersReceived, ARG(peer), ARG(users))
+    });
+}
+
+
+void IrcChannel::userParted(const QString &nick)
+{
+    // Parts of users we know to be in the channel reach us through the user (see part())
+    if (!_usersPending || _userModes.contains(network()->ircUser(nick)))
+        return;
+
+    _pendingUserCount--;
+}
+
+
+void IrcChannel::usersReceived(PeerPtr, const QVariantMap &users)
+{
+    if (!_usersPending)
+        return;
+
+    network()->newIrcUsersFromVariantMap(users["Users"].toMap());
+    _usersPending = false;
+
+    // Users we learned about meanwhile, e.g. ourselves, are already known
+    QList<IrcUser *> newUsers;
+    QStringList newModes;
+    const QVariantMap &userModes = users["UserModes"].toMap();
+    QVariantMap::const_iterator iter = userModes.constBegin();
+    while (iter != userModes.constEnd()) {
+        IrcUser *ircUser = network()->ircUser(iter.key());
+        if (ircUser && !_userModes.contains(ircUser)) {
+            newUsers << ircUser;
+            newModes << iter.value().toString();
+        }
+        ++iter;
+    }
+    joinIrcUsers(newUsers, newModes);
+}
+
+
 void IrcChannel::ircUserDestroyed()
 {
     IrcUser *ircUser = static_cast<IrcUser *>(sender());
     Q_ASSERT(ircUser);
     _userModes.remove(ircUser);
+    updateRevision();
     // no further propagation.
     // this leads only to fuck ups.
 }
 
 
-void IrcChannel::ircUserNickSet(QString nick)
-{
-    IrcUser *ircUser = qobject_cast<IrcUser *>(sender());
-    Q_ASSERT(ircUser);
-    emit ircUserNickSet(ircUser, nick);
-}
-
-
 /*******************************************************************************
  *
  * 3.3 CHANMODES
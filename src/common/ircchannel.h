@@ -27,6 +27,7 @@
 #include <QStringList>
 #include <QVariantMap>
 
+#include "peer.h"
 #include "syncableobject.h"
 
 class IrcUser;
@@ -56,6 +57,11 @@ public :
     inline Network *network() const { return _network; }
 
     inline QList<IrcUser *> ircUsers() const { return _userModes.keys(); }
+    inline bool hasUser(IrcUser *ircuser) const { return _userModes.contains(ircuser); }
+
+    //! Whether the channel was synced without its users, which are only fetched once needed
+    inline bool usersPending() const { return _usersPending; }
+    int userCount() const;
 
     QString userModes(IrcUser *ircuser) const;
     QString userModes(const QString &nick) const;
@@ -99,6 +105,12 @@ public slots:
     void addChannelMode(const QChar &mode, const QString &value);
     void removeChannelMode(const QChar &mode, const QString &value);
 
+    //! Asks the core for the users of a channel that was synced without them (see Quassel::Feature::LazyChannelUsers)
+    void fetchUsers();
+    void requestUsers(PeerPtr peer);
+    void usersReceived(PeerPtr, const QVariantMap &users);
+    void userParted(const QString &nick);
+
     // init geters
     QVariantMap initUserModes() const;
     QVariantMap initChanModes() const;
@@ -106,6 +118,7 @@ public slots:
     // init seters
     void initSetUserModes(const QVariantMap &usermodes);
     void initSetChanModes(const QVariantMap &chanModes);
+    void initSetUserCount(int count);
 
 signals:
     void topicSet(const QString &topic); // needed by NetworkModel
@@ -129,9 +142,11 @@ signals:
 
 private slots:
     void ircUserDestroyed();
-    void ircUserNickSet(QString nick);
 
 private:
+    // Emits ircUserNickSet() for its channels, instead of each channel connecting to each of its users
+    friend class IrcUser;
+
     bool _initialized;
     QString _name;
     QString _topic;
@@ -140,6 +155,10 @@ private:
 
     QHash<IrcUser *, QString> _userModes;
 
+    bool _usersPending;
+    bool _usersRequested;
+    int _pendingUserCount;
+
     Network *_network;
 
     QTextCodec *_codecForEncoding;
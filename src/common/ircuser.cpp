@@ -259,6 +259,11 @@ void IrcUser::setNick(const QString &nick)
         updateObjectName();
         SYNC(ARG(nick))
         emit nickSet(nick);
+        // The state of our channels refers to us by nick
+        foreach(IrcChannel *channel, _channels) {
+            channel->updateRevision();
+            emit channel->ircUserNickSet(this, nick);
+        }
     }
 }
 
@@ -312,6 +317,8 @@ void IrcUser::joinChannel(IrcChannel *channel, bool skip_channel_join)
     Q_ASSERT(channel);
     if (!_channels.contains(channel)) {
         _channels.insert(channel);
+        // Only the channel syncs the join, but our channels are part of our state as well
+        updateRevision();
         if (!skip_channel_join)
             channel->joinIrcUser(this);
     }
@@ -370,6 +377,7 @@ void IrcUser::channelDestroyed()
     IrcChannel *channel = static_cast<IrcChannel *>(sender());
     if (_channels.contains(channel)) {
         _channels.remove(channel);
+        updateRevision();
         if (_channels.isEmpty() && !network()->isMe(this))
             quit();
     }
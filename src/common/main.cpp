@@ -186,9 +186,11 @@ int main(int argc, char **argv)
     // put core-only arguments here
     cliParser->addOption("listen", 0, "The address(es) quasselcore will listen on", "<address>[,<address>[,...]]", "::,0.0.0.0");
     cliParser->addOption("port", 'p', "The port quasselcore will listen at", "port", "4242");
+    cliParser->addOption("session-threads", 0, "Number of threads running the user sessions (0 uses one per CPU core)", "count", "0");
     cliParser->addSwitch("norestore", 'n', "Don't restore last core's state");
     cliParser->addSwitch("config-from-environment", 0, "Load configuration from environment variables");
     cliParser->addOption("select-backend", 0, "Switch storage backend (migrating data if possible)", "backendidentifier");
+    cliParser->addOption("migration-threads", 0, "Number of threads copying the backlog when switching storage backends", "count", "4");
     cliParser->addOption("select-authenticator", 0, "Select authentication backend", "authidentifier");
     cliParser->addSwitch("add-user", 0, "Starts an interactive session to add a new core user");
     cliParser->addOption("change-userpass", 0, "Starts an interactive session to change the password of the user identified by <username>", "username");
@@ -197,12 +199,24 @@ int main(int argc, char **argv)
     cliParser->addSwitch("strict-ident", 0, "Use users' quasselcore username as ident reply. Ignores each user's configured ident setting.");
     cliParser->addSwitch("ident-daemon", 0, "Enable internal ident daemon");
     cliParser->addOption("ident-port", 0, "The port quasselcore will listen at for ident requests. Only meaningful with --ident-daemon", "port", "10113");
+    cliParser->addOption("connect-interval", 0, "Minimum time between two IRC connection attempts of the core", "ms", "200");
+    cliParser->addOption("connect-host-interval", 0, "Minimum time between two IRC connection attempts to the same server", "seconds", "2");
+    cliParser->addOption("metrics-port", 0, "Serve performance metrics in the Prometheus text format on the given port of the loopback interfaces", "port");
+    cliParser->addOption("metrics-socket", 0, "Serve performance metrics in the Prometheus text format on the given UNIX domain socket", "path");
+    cliParser->addOption("backlog-cache-size", 0, "Number of recent messages per buffer kept in memory for serving backlog requests (0 disables the cache)", "count", "500");
+    cliParser->addOption("backlog-cache-memory", 0, "Maximum memory used for cached backlog per user session", "MiB", "32");
+    cliParser->addOption("backlog-max-age", 0, "Delete backlog older than the given number of days", "days");
+    cliParser->addOption("backlog-max-messages", 0, "Keep at most the given number of messages per buffer", "count");
+    cliParser->addOption("backlog-max-size", 0, "Limit the backlog of each user to the given size of message text", "MiB");
+    cliParser->addOption("backlog-archive-dir", 0, "Save backlog deleted by the limits above to compressed per-buffer files in the given directory", "path");
 #ifdef HAVE_SSL
     cliParser->addSwitch("require-ssl", 0, "Require SSL for remote (non-loopback) client connections");
     cliParser->addOption("ssl-cert", 0, "Specify the path to the SSL Certificate", "path", "configdir/quasselCert.pem");
     cliParser->addOption("ssl-key", 0, "Specify the path to the SSL key", "path", "ssl-cert-path");
 #endif
     cliParser->addSwitch("enable-experimental-dcc", 0, "Enable highly experimental and unfinished support for CTCP DCC (DANGEROUS)");
+    cliParser->addOption("dcc-spool-dir", 0, "Receive accepted DCC transfers into per-user directories below the given path, so they complete without a connected client", "path");
+    cliParser->addOption("dcc-spool-expiry", 0, "Delete spooled DCC transfers the given number of hours after they completed", "hours", "24");
 #endif
 
 #ifdef HAVE_KDE4
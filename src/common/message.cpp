@@ -26,9 +26,13 @@
 
 #include <QDataStream>
 
+#include <limits>
+
+const qint64 Message::InvalidTimestamp = std::numeric_limits<qint64>::min();
+
 Message::Message(const BufferInfo &bufferInfo, Type type, const QString &contents, const QString &sender,
                  const QString &senderPrefixes, const QString &realName, const QString &avatarUrl, Flags flags)
-    : _timestamp(QDateTime::currentDateTime().toUTC()),
+    : _timestamp(QDateTime::currentMSecsSinceEpoch()),
     _bufferInfo(bufferInfo),
     _contents(contents),
     _sender(sender),
@@ -44,7 +48,7 @@ Message::Message(const BufferInfo &bufferInfo, Type type, const QString &content
 Message::Message(const QDateTime &ts, const BufferInfo &bufferInfo, Type type, const QString &contents,
                  const QString &sender, const QString &senderPrefixes, const QString &realName,
                  const QString &avatarUrl, Flags flags)
-    : _timestamp(ts),
+    : _timestamp(ts.isValid() ? ts.toMSecsSinceEpoch() : InvalidTimestamp),
     _bufferInfo(bufferInfo),
     _contents(contents),
     _sender(sender),
@@ -57,6 +61,19 @@ Message::Message(const QDateTime &ts, const BufferInfo &bufferInfo, Type type, c
 }
 
 
+QDateTime Message::timestamp() const
+{
+    if (_timestamp == InvalidTimestamp)
+        return QDateTime();
+
+#if QT_VERSION >= 0x050000
+    return QDateTime::fromMSecsSinceEpoch(_timestamp, Qt::UTC);
+#else
+    return QDateTime::fromMSecsSinceEpoch(_timestamp).toUTC();
+#endif
+}
+
+
 QDataStream &operator<<(QDataStream &out, const Message &msg)
 {
     Q_ASSERT(SignalProxy::current());
@@ -99,13 +116,11 @@ QDataStream &operator>>(QDataStream &in, Message &msg)
 
     if (SignalProxy::current()->sourcePeer()->hasFeature(Quassel::Feature::LongTime)) {
         // timestamp is a qint64, signed rather than unsigned
-        qint64 timeStamp;
-        in >> timeStamp;
-        msg._timestamp = QDateTime::fromMSecsSinceEpoch(timeStamp);
+        in >> msg._timestamp;
     } else {
         quint32 timeStamp;
         in >> timeStamp;
-        msg._timestamp = QDateTime::fromTime_t(timeStamp);
+        msg._timestamp = static_cast<qint64>(timeStamp) * 1000;
     }
 
     quint32 type;
@@ -120,12 +135,13 @@ QDataStream &operator>>(QDataStream &in, Message &msg)
 
     QByteArray sender;
     in >> sender;
-    msg._sender = QString::fromUtf8(sender);
+    // The same few senders, prefixes and real names recur in many messages, so share their data
+    msg._sender = internString(QString::fromUtf8(sender));
 
     QByteArray senderPrefixes;
     if (SignalProxy::current()->sourcePeer()->hasFeature(Quassel::Feature::SenderPrefixes))
         in >> senderPrefixes;
-    msg._senderPrefixes = QString::fromUtf8(senderPrefixes);
+    msg._senderPrefixes = internString(QString::fromUtf8(senderPrefixes));
 
     QByteArray realName;
     QByteArray avatarUrl;
@@ -133,8 +149,8 @@ QDataStream &operator>>(QDataStream &in, Message &msg)
         in >> realName;
         in >> avatarUrl;
     }
-    msg._realName = QString::fromUtf8(realName);
-    msg._avatarUrl = QString::fromUtf8(avatarUrl);
+    msg._realName = internString(QString::fromUtf8(realName));
+    msg._avatarUrl = internString(QString::fromUtf8(avatarUrl));
 
     QByteArray contents;
     in >> contents;
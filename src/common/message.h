@@ -89,14 +89,17 @@ public:
     inline Type type() const { return _type; }
     inline Flags flags() const { return _flags; }
     inline void setFlags(Flags flags) { _flags = flags; }
-    inline const QDateTime &timestamp() const { return _timestamp; }
+    QDateTime timestamp() const;
 
     inline bool isValid() const { return _msgId.isValid(); }
 
     inline bool operator<(const Message &other) const { return _msgId < other._msgId; }
 
 private:
-    QDateTime _timestamp;
+    // Clients keep a lot of messages around, so store the timestamp without QDateTime's private data
+    qint64 _timestamp;
+    // Stands in for an invalid QDateTime, which has no representation in milliseconds
+    static const qint64 InvalidTimestamp;
     MsgId _msgId;
     BufferInfo _bufferInfo;
     QString _contents;
@@ -0,0 +1,207 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "metrics.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+bool Metrics::_enabled = false;
+
+namespace {
+
+enum class MetricType {
+    Counter,
+    Gauge,
+    Histogram
+};
+
+// Upper bounds of the histogram buckets; suitable for durations in seconds
+const double bucketBounds[] = { 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5 };
+const int bucketCount = sizeof(bucketBounds) / sizeof(bucketBounds[0]);
+
+struct Series {
+    double value{0};             //!< Counter/gauge value, or the sum of observations
+    quint64 count{0};            //!< Number of observations
+    QVector<quint64> buckets;    //!< Observations per bucket (not cumulative)
+};
+
+struct Metric {
+    MetricType type;
+    QMap<QString, Series> series; // by label set
+};
+
+QMutex metricsMutex;
+QMap<QString, Metric> metrics; // by name
+
+Series &series(const QString &name, const QString &labels, MetricType type)
+{
+    QMap<QString, Metric>::iterator it = metrics.find(name);
+    if (it == metrics.end()) {
+        Metric metric;
+        metric.type = type;
+        it = metrics.insert(name, metric);
+    }
+    return it->series[labels];
+}
+
+QString formatValue(double value)
+{
+    return QString::number(value, 'g', 15);
+}
+
+QString withLabels(const QString &name, const QString &labels, const QString &extra = QString())
+{
+    if (labels.isEmpty() && extra.isEmpty())
+        return name;
+    if (labels.isEmpty() || extra.isEmpty())
+        return QString("%1{%2}").arg(name, labels + extra);
+    return QString("%1{%2,%3}").arg(name, labels, extra);
+}
+
+}
+
+
+void Metrics::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+}
+
+
+QString Metrics::label(const QString &name, const QString &value)
+{
+    QString escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return QString("%1=\"%2\"").arg(name, escaped);
+}
+
+
+void Metrics::add(const QString &name, const QString &labels, double value)
+{
+    if (!_enabled)
+        return;
+    QMutexLocker locker(&metricsMutex);
+    series(name, labels, MetricType::Counter).value += value;
+}
+
+
+void Metrics::set(const QString &name, const QString &labels, double value)
+{
+    if (!_enabled)
+        return;
+    QMutexLocker locker(&metricsMutex);
+    series(name, labels, MetricType::Gauge).value = value;
+}
+
+
+void Metrics::set(std::initializer_list<Gauge> gauges)
+{
+    if (!_enabled)
+        return;
+    QMutexLocker locker(&metricsMutex);
+    for (const Gauge &gauge : gauges)
+        series(gauge.name, gauge.labels, MetricType::Gauge).value = gauge.value;
+}
+
+
+void Metrics::observe(const QString &name, const QString &labels, double value)
+{
+    if (!_enabled)
+        return;
+    QMutexLocker locker(&metricsMutex);
+    Series &s = series(name, labels, MetricType::Histogram);
+    if (s.buckets.isEmpty())
+        s.buckets.fill(0, bucketCount);
+    for (int i = 0; i < bucketCount; i++) {
+        if (value <= bucketBounds[i]) {
+            s.buckets[i]++;
+            break;
+        }
+    }
+    s.value += value;
+    s.count++;
+}
+
+
+void Metrics::remove(const QString &labels)
+{
+    if (!_enabled)
+        return;
+    QMutexLocker locker(&metricsMutex);
+    for (QMap<QString, Metric>::iterator it = metrics.begin(); it != metrics.end(); ++it) {
+        it->series.remove(labels);
+    }
+}
+
+
+QByteArray Metrics::exposition()
+{
+    QMutexLocker locker(&metricsMutex);
+    QString result;
+    for (QMap<QString, Metric>::const_iterator it = metrics.constBegin(); it != metrics.constEnd(); ++it) {
+        const QString &name = it.key();
+        const Metric &metric = it.value();
+        if (metric.series.isEmpty())
+            continue;
+
+        switch (metric.type) {
+        case MetricType::Counter:
+            result += QString("# TYPE %1 counter\n").arg(name);
+            break;
+        case MetricType::Gauge:
+            result += QString("# TYPE %1 gauge\n").arg(name);
+            break;
+        case MetricType::Histogram:
+            result += QString("# TYPE %1 histogram\n").arg(name);
+            break;
+        }
+
+        for (QMap<QString, Series>::const_iterator s = metric.series.constBegin(); s != metric.series.constEnd(); ++s) {
+            if (metric.type != MetricType::Histogram) {
+                result += QString("%1 %2\n").arg(withLabels(name, s.key()), formatValue(s->value));
+                continue;
+            }
+            quint64 cumulative = 0;
+            for (int i = 0; i < bucketCount; i++) {
+                cumulative += s->buckets.value(i);
+                result += QString("%1 %2\n").arg(withLabels(name + "_bucket", s.key(), label("le", formatValue(bucketBounds[i]))),
+                                                QString::number(cumulative));
+            }
+            result += QString("%1 %2\n").arg(withLabels(name + "_bucket", s.key(), label("le", "+Inf")), QString::number(s->count));
+            result += QString("%1 %2\n").arg(withLabels(name + "_sum", s.key()), formatValue(s->value));
+            result += QString("%1 %2\n").arg(withLabels(name + "_count", s.key()), QString::number(s->count));
+        }
+    }
+    return result.toUtf8();
+}
+
+
+qint64 Metrics::monotonicTime()
+{
+    static QElapsedTimer timer = []() {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.nsecsElapsed() + 1;
+}
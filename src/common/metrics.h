@@ -0,0 +1,76 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <initializer_list>
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * Registry of runtime metrics, exported in the Prometheus text format.
+ *
+ * Collection is opt-in: unless enabled via setEnabled() (the core does so if a metrics listener is
+ * configured), the recording methods return right away. A series is identified by the metric name
+ * and a label set, as built by label(). All methods are threadsafe.
+ */
+class Metrics
+{
+public:
+    //! A gauge value, for setting several of them at once
+    struct Gauge {
+        QString name;
+        QString labels;
+        double value;
+    };
+
+    static inline bool isEnabled() { return _enabled; }
+
+    //! Enable collection. Must be called before other threads start recording.
+    static void setEnabled(bool enabled);
+
+    //! Format a label for use in a label set, e.g. label("user", "1") + "," + label("network", "2")
+    static QString label(const QString &name, const QString &value);
+
+    //! Increase a counter
+    static void add(const QString &name, const QString &labels, double value = 1);
+
+    //! Set a gauge
+    static void set(const QString &name, const QString &labels, double value);
+
+    //! Set several gauges, taking the registry's lock only once
+    static void set(std::initializer_list<Gauge> gauges);
+
+    //! Record an observation (e.g. a duration in seconds) in a histogram
+    static void observe(const QString &name, const QString &labels, double value);
+
+    //! Drop all series with the given label set, e.g. when the object they describe is gone
+    static void remove(const QString &labels);
+
+    //! All series in the Prometheus text exposition format
+    static QByteArray exposition();
+
+    //! Monotonic clock for measuring latencies across threads, in nanoseconds (never 0)
+    static qint64 monotonicTime();
+
+private:
+    static bool _enabled;
+};
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 
+#include <QSet>
 #include <QTextCodec>
 
 #include "network.h"
@@ -302,7 +303,7 @@ bool Network::saslMaybeSupports(const QString &saslMechanism) const
 }
 
 
-IrcUser *Network::newIrcUser(const QString &hostmask, const QVariantMap &initData)
+IrcUser *Network::newIrcUser(const QString &hostmask, const QVariantMap &initData, bool announce)
 {
     QString nick(nickFromMask(hostmask).toLower());
     if (!_ircUsers.contains(nick)) {
@@ -324,8 +325,10 @@ IrcUser *Network::newIrcUser(const QString &hostmask, const QVariantMap &initDat
         // This method will be called with a nick instead of hostmask by setInitIrcUsersAndChannels().
         // Not a problem because initData contains all we need; however, making sure here to get the real
         // hostmask out of the IrcUser afterwards.
-        QString mask = ircuser->hostmask();
-        SYNC_OTHER(addIrcUser, ARG(mask));
+        if (announce) {
+            QString mask = ircuser->hostmask();
+            SYNC_OTHER(addIrcUser, ARG(mask));
+        }
         // emit ircUserAdded(mask);
         emit ircUserAdded(ircuser);
     }
@@ -924,47 +927,59 @@ QVariantMap Network::initIrcUsersAndChannels() const
     Q_ASSERT(proxy()->targetPeer());
     QVariantMap usersAndChannels;
 
+    // Peers supporting it fetch the users of a channel only once they need them (see IrcChannel::fetchUsers()),
+    // so we only send them ourselves, the users not in any channel and those we have an open query with
+    bool lazy = proxy()->targetPeer()->hasFeature(Quassel::Feature::LazyChannelUsers);
+
+    // A peer resuming its connection still has the users and channels that didn't change since, so we only name those
+    quint64 baseRevision = proxy()->initBaseRevision();
+
     if (_ircUsers.count()) {
-        QHash<QString, QVariantList> users;
-        QHash<QString, IrcUser *>::const_iterator it = _ircUsers.begin();
-        QHash<QString, IrcUser *>::const_iterator end = _ircUsers.end();
-        while (it != end) {
-            QVariantMap map = it.value()->toVariantMap();
-            // If the peer doesn't support LongTime, replace the lastAwayMessageTime field
-            // with the 32-bit numerical seconds value (lastAwayMessage) used in older versions
-            if (!proxy()->targetPeer()->hasFeature(Quassel::Feature::LongTime)) {
-#if QT_VERSION >= 0x050800
-                int lastAwayMessage = it.value()->lastAwayMessageTime().toSecsSinceEpoch();
-#else
-                // toSecsSinceEpoch() was added in Qt 5.8.  Manually downconvert to seconds for now.
-                // See https://doc.qt.io/qt-5/qdatetime.html#toMSecsSinceEpoch
-                int lastAwayMessage = it.value()->lastAwayMessageTime().toMSecsSinceEpoch() / 1000;
-#endif
-                map.remove("lastAwayMessageTime");
-                map["lastAwayMessage"] = lastAwayMessage;
+        QList<IrcUser *> users;
+        if (lazy) {
+            QSet<IrcUser *> queryUsers = queryIrcUsers().toSet();
+            foreach(IrcUser *ircUser, _ircUsers) {
+                if (ircUser->channels().isEmpty() || isMe(ircUser) || queryUsers.contains(ircUser))
+                    users << ircUser;
             }
-
-            QVariantMap::const_iterator mapiter = map.begin();
-            while (mapiter != map.end()) {
-                users[mapiter.key()] << mapiter.value();
-                ++mapiter;
+        }
+        else {
+            users = _ircUsers.values();
+        }
+        if (baseRevision > 0) {
+            QStringList unchangedUsers;
+            QList<IrcUser *> changedUsers;
+            foreach(IrcUser *ircUser, users) {
+                if (ircUser->revision() <= baseRevision)
+                    unchangedUsers << ircUser->nick();
+                else
+                    changedUsers << ircUser;
             }
-            ++it;
+            usersAndChannels["UnchangedUsers"] = unchangedUsers;
+            users = changedUsers;
         }
-        // Can't have a container with a value type != QVariant in a QVariant :(
-        // However, working directly on a QVariantMap is awkward for appending, thus the detour via the hash above.
-        QVariantMap userMap;
-        foreach(const QString &key, users.keys())
-            userMap[key] = users[key];
-        usersAndChannels["Users"] = userMap;
+        usersAndChannels["Users"] = ircUsersToVariantMap(users);
     }
 
     if (_ircChannels.count()) {
         QHash<QString, QVariantList> channels;
+        QStringList unchangedChannels;
         QHash<QString, IrcChannel *>::const_iterator it = _ircChannels.begin();
         QHash<QString, IrcChannel *>::const_iterator end = _ircChannels.end();
         while (it != end) {
-            const QVariantMap &map = it.value()->toVariantMap();
+            if (baseRevision > 0 && it.value()->revision() <= baseRevision) {
+                unchangedChannels << it.value()->name();
+                ++it;
+                continue;
+            }
+            QVariantMap map = it.value()->toVariantMap();
+            if (lazy) {
+                QVariantMap userModes;
+                if (me() && it.value()->hasUser(me()))
+                    userModes[me()->nick()] = it.value()->userModes(me());
+                map["UserModes"] = userModes;
+                map["UserCount"] = it.value()->userCount();
+            }
             QVariantMap::const_iterator mapiter = map.begin();
             while (mapiter != map.end()) {
                 channels[mapiter.key()] << mapiter.value();
@@ -976,12 +991,98 @@ QVariantMap Network::initIrcUsersAndChannels() const
         foreach(const QString &key, channels.keys())
             channelMap[key] = channels[key];
         usersAndChannels["Channels"] = channelMap;
+        if (baseRevision > 0)
+            usersAndChannels["UnchangedChannels"] = unchangedChannels;
     }
 
     return usersAndChannels;
 }
 
 
+// Appends the named entries of a previous users or channels map in the format of initIrcUsersAndChannels()
+static bool appendPreviousEntries(QVariantMap &entries, const QVariantMap &previous, const QString &nameKey, const QStringList &names)
+{
+    if (names.isEmpty())
+        return true;
+
+    QHash<QString, int> previousIndex;
+    const QVariantList previousNames = previous[nameKey].toList();
+    for (int i = 0; i < previousNames.count(); i++)
+        previousIndex[previousNames.at(i).toString()] = i;
+
+    QHash<QString, QVariantList> columns;
+    foreach(const QString &key, previous.keys())
+        columns[key] = entries[key].toList();
+    foreach(const QString &name, names) {
+        if (!previousIndex.contains(name))
+            return false;
+        int i = previousIndex[name];
+        foreach(const QString &key, previous.keys())
+            columns[key] << previous[key].toList().value(i);
+    }
+    foreach(const QString &key, columns.keys())
+        entries[key] = columns[key];
+    return true;
+}
+
+
+bool Network::mergeInitData(QVariantMap &properties, const QVariantMap &previous) const
+{
+    QVariantMap usersAndChannels = properties["IrcUsersAndChannels"].toMap();
+    if (!usersAndChannels.contains("UnchangedUsers") && !usersAndChannels.contains("UnchangedChannels"))
+        return true;
+
+    const QVariantMap previousUsersAndChannels = previous["IrcUsersAndChannels"].toMap();
+    QVariantMap users = usersAndChannels["Users"].toMap();
+    QVariantMap channels = usersAndChannels["Channels"].toMap();
+    if (!appendPreviousEntries(users, previousUsersAndChannels["Users"].toMap(), "nick", usersAndChannels.take("UnchangedUsers").toStringList())
+        || !appendPreviousEntries(channels, previousUsersAndChannels["Channels"].toMap(), "name", usersAndChannels.take("UnchangedChannels").toStringList()))
+        return false;
+
+    usersAndChannels["Users"] = users;
+    usersAndChannels["Channels"] = channels;
+    properties["IrcUsersAndChannels"] = usersAndChannels;
+    return true;
+}
+
+
+QVariantMap Network::ircUsersToVariantMap(const QList<IrcUser *> &ircUsers) const
+{
+    Q_ASSERT(proxy());
+    Q_ASSERT(proxy()->targetPeer());
+
+    QHash<QString, QVariantList> users;
+    foreach(IrcUser *ircUser, ircUsers) {
+        QVariantMap map = ircUser->toVariantMap();
+        // If the peer doesn't support LongTime, replace the lastAwayMessageTime field
+        // with the 32-bit numerical seconds value (lastAwayMessage) used in older versions
+        if (!proxy()->targetPeer()->hasFeature(Quassel::Feature::LongTime)) {
+#if QT_VERSION >= 0x050800
+            int lastAwayMessage = ircUser->lastAwayMessageTime().toSecsSinceEpoch();
+#else
+            // toSecsSinceEpoch() was added in Qt 5.8.  Manually downconvert to seconds for now.
+            // See https://doc.qt.io/qt-5/qdatetime.html#toMSecsSinceEpoch
+            int lastAwayMessage = ircUser->lastAwayMessageTime().toMSecsSinceEpoch() / 1000;
+#endif
+            map.remove("lastAwayMessageTime");
+            map["lastAwayMessage"] = lastAwayMessage;
+        }
+
+        QVariantMap::const_iterator mapiter = map.begin();
+        while (mapiter != map.end()) {
+            users[mapiter.key()] << mapiter.value();
+            ++mapiter;
+        }
+    }
+    // Can't have a container with a value type != QVariant in a QVariant :(
+    // However, working directly on a QVariantMap is awkward for appending, thus the detour via the hash above.
+    QVariantMap userMap;
+    foreach(const QString &key, users.keys())
+        userMap[key] = users[key];
+    return userMap;
+}
+
+
 void Network::initSetIrcUsersAndChannels(const QVariantMap &usersAndChannels)
 {
     Q_ASSERT(proxy());
@@ -991,11 +1092,37 @@ void Network::initSetIrcUsersAndChannels(const QVariantMap &usersAndChannels)
         return;
     }
 
+    newIrcUsersFromVariantMap(usersAndChannels["Users"].toMap());
+
+    // same thing for IrcChannels
+    const QVariantMap &channels = usersAndChannels["Channels"].toMap();
+
+    // sanity check
+    int count = channels["name"].toList().count();
+    foreach(const QString &key, channels.keys()) {
+        if (channels[key].toList().count() != count) {
+            qWarning() << "Received invalid usersAndChannels init data, sizes of attribute lists don't match!";
+            return;
+        }
+    }
+    // now create the individual IrcChannels
+    for(int i = 0; i < count; i++) {
+        QVariantMap map;
+        foreach(const QString &key, channels.keys())
+            map[key] = channels[key].toList().at(i);
+        newIrcChannel(map["name"].toString(), map);
+    }
+}
+
+
+void Network::newIrcUsersFromVariantMap(const QVariantMap &users)
+{
+    Q_ASSERT(proxy());
+    Q_ASSERT(proxy()->sourcePeer());
+
     // toMap() and toList() are cheap, so we can avoid copying to lists...
     // However, we really have to make sure to never accidentally detach from the shared data!
 
-    const QVariantMap &users = usersAndChannels["Users"].toMap();
-
     // sanity check
     int count = users["nick"].toList().count();
     foreach(const QString &key, users.keys()) {
@@ -1028,25 +1155,6 @@ void Network::initSetIrcUsersAndChannels(const QVariantMap &usersAndChannels)
 
         newIrcUser(map["nick"].toString(), map); // newIrcUser() properly handles the hostmask being just the nick
     }
-
-    // same thing for IrcChannels
-    const QVariantMap &channels = usersAndChannels["Channels"].toMap();
-
-    // sanity check
-    count = channels["name"].toList().count();
-    foreach(const QString &key, channels.keys()) {
-        if (channels[key].toList().count() != count) {
-            qWarning() << "Received invalid usersAndChannels init data, sizes of attribute lists don't match!";
-            return;
-        }
-    }
-    // now create the individual IrcChannels
-    for(int i = 0; i < count; i++) {
-        QVariantMap map;
-        foreach(const QString &key, channels.keys())
-            map[key] = channels[key].toList().at(i);
-        newIrcChannel(map["name"].toString(), map);
-    }
 }
 
 
@@ -369,13 +369,29 @@ public :
      */
     bool saslMaybeSupports(const QString &saslMechanism) const;
 
-    IrcUser *newIrcUser(const QString &hostmask, const QVariantMap &initData = QVariantMap());
+    /**
+     * Returns the IrcUser for the given hostmask (or nick), creating it if needed
+     *
+     * @param hostmask  Hostmask or nick of the user
+     * @param initData  Properties of a new user
+     * @param announce  Whether to tell the clients about a new user; pass false if they learn about it anyway, as
+     *                  with IrcChannel::joinIrcUsers()
+     */
+    IrcUser *newIrcUser(const QString &hostmask, const QVariantMap &initData = QVariantMap(), bool announce = true);
     inline IrcUser *newIrcUser(const QByteArray &hostmask) { return newIrcUser(decodeServerString(hostmask)); }
     IrcUser *ircUser(QString nickname) const;
     inline IrcUser *ircUser(const QByteArray &nickname) const { return ircUser(decodeServerString(nickname)); }
     inline QList<IrcUser *> ircUsers() const { return _ircUsers.values(); }
     inline quint32 ircUserCount() const { return _ircUsers.count(); }
 
+    //! Serializes the given users in the compact format used by initIrcUsersAndChannels(), for proxy()->targetPeer()
+    QVariantMap ircUsersToVariantMap(const QList<IrcUser *> &ircUsers) const;
+    //! Creates the users serialized by ircUsersToVariantMap() on proxy()->sourcePeer()
+    void newIrcUsersFromVariantMap(const QVariantMap &users);
+
+    //! Adds the users and channels the core left out as unchanged to our init data
+    bool mergeInitData(QVariantMap &properties, const QVariantMap &previous) const override;
+
     IrcChannel *newIrcChannel(const QString &channelname, const QVariantMap &initData = QVariantMap());
     inline IrcChannel *newIrcChannel(const QByteArray &channelname) { return newIrcChannel(decodeServerString(channelname)); }
     IrcChannel *ircChannel(QString channelname) const;
@@ -691,6 +707,9 @@ protected:
     inline virtual IrcChannel *ircChannelFactory(const QString &channelname) { return new IrcChannel(channelname, this); }
     inline virtual IrcUser *ircUserFactory(const QString &hostmask) { return new IrcUser(hostmask, this); }
 
+    //! Users we have a query buffer with, which peers fetching channel users lazily still get along with the network
+    inline virtual QList<IrcUser *> queryIrcUsers() const { return QList<IrcUser *>(); }
+
 private:
     QPointer<SignalProxy> _proxy;
 
@@ -141,6 +141,11 @@ public:
 #endif
         LongMessageId,            ///< 64-bit IDs for messages
         SyncedCoreInfo,           ///< CoreInfo dynamically updated using signals
+        SyncCoalescing,           ///< Property updates to a syncable object are merged into one message
+        TransferFlowControl,      ///< DCC transfers are acknowledged by the client and can be resumed
+        TransferSpooling,         ///< DCC transfers can be spooled on the core and fetched in ranges
+        DeltaSync,                ///< Objects that didn't change since the client's previous connection aren't sent again
+        LazyChannelUsers,         ///< Channel users are only synced once the client needs them
     };
     Q_ENUMS(Feature)
 
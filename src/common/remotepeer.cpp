@@ -20,6 +20,7 @@
 
 #include <QtEndian>
 
+#include <QAtomicInt>
 #include <QHostAddress>
 #include <QTimer>
 
@@ -30,11 +31,23 @@
 #endif
 
 #include "remotepeer.h"
+#include "metrics.h"
 
 using namespace Protocol;
 
 const quint32 maxMessageSize = 64 * 1024 * 1024; // This is uncompressed size. 64 MB should be enough for any sort of initData or backlog chunk
 
+namespace {
+
+// Peer ids are only unique within a SignalProxy, i.e. per user, so the metrics number peers on their own
+QAtomicInt nextMetricsPeer;
+
+const QString payloadBytesMetric("quassel_peer_payload_bytes");
+const QString wireBytesMetric("quassel_peer_wire_bytes");
+const QString compressionRatioMetric("quassel_peer_compression_ratio");
+
+}
+
 RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
     : Peer(authHandler, parent),
     _socket(socket),
@@ -63,6 +76,15 @@ RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compresso
 }
 
 
+RemotePeer::~RemotePeer()
+{
+    if (!_metricsLabelsIn.isEmpty()) {
+        Metrics::remove(_metricsLabelsIn);
+        Metrics::remove(_metricsLabelsOut);
+    }
+}
+
+
 void RemotePeer::onSocketStateChanged(QAbstractSocket::SocketState state)
 {
     if (state == QAbstractSocket::ClosingState) {
@@ -253,6 +275,9 @@ bool RemotePeer::readMessage(QByteArray &msg)
         return false;
     }
 
+    _payloadBytesRead += 4 + bytesRead;
+    updateTrafficMetrics();
+
     _msgSize = 0;
     return true;
 }
@@ -263,6 +288,34 @@ void RemotePeer::writeMessage(const QByteArray &msg)
     quint32 size = qToBigEndian<quint32>(msg.size());
     _compressor->write((const char*)&size, 4, Compressor::NoFlush);
     _compressor->write(msg.constData(), msg.size());
+
+    _payloadBytesWritten += 4 + msg.size();
+    updateTrafficMetrics();
+}
+
+
+void RemotePeer::updateTrafficMetrics()
+{
+    // Peers only get an id once they're added to a SignalProxy, so the authentication isn't counted
+    if (!Metrics::isEnabled() || id() < 0)
+        return;
+
+    if (_metricsLabelsIn.isEmpty()) {
+        QString peer = Metrics::label("peer", QString::number(nextMetricsPeer.fetchAndAddRelaxed(1)));
+        _metricsLabelsIn = peer + "," + Metrics::label("direction", "in");
+        _metricsLabelsOut = peer + "," + Metrics::label("direction", "out");
+    }
+
+    qint64 wireBytesRead = _compressor->socketBytesRead();
+    qint64 wireBytesWritten = _compressor->socketBytesWritten();
+    Metrics::set({
+        { payloadBytesMetric, _metricsLabelsIn, double(_payloadBytesRead) },
+        { payloadBytesMetric, _metricsLabelsOut, double(_payloadBytesWritten) },
+        { wireBytesMetric, _metricsLabelsIn, double(wireBytesRead) },
+        { wireBytesMetric, _metricsLabelsOut, double(wireBytesWritten) },
+        { compressionRatioMetric, _metricsLabelsIn, _payloadBytesRead > 0 ? double(wireBytesRead) / _payloadBytesRead : 1.0 },
+        { compressionRatioMetric, _metricsLabelsOut, _payloadBytesWritten > 0 ? double(wireBytesWritten) / _payloadBytesWritten : 1.0 }
+    });
 }
 
 
@@ -294,6 +347,8 @@ void RemotePeer::sendHeartBeat()
         emit lagUpdated(_lag);
     }
 
+    // Queued property updates go first, so they're part of the measured lag
+    signalProxy()->flushPendingUpdates(this);
     dispatch(HeartBeat(QDateTime::currentDateTime().toUTC()));
     ++_heartBeatCount;
 }
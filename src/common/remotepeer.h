@@ -42,6 +42,7 @@ public:
     using Peer::dispatch;
 
     RemotePeer(AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent = 0);
+    ~RemotePeer();
 
     void setSignalProxy(SignalProxy *proxy);
 
@@ -96,6 +97,7 @@ private slots:
 
 private:
     bool readMessage(QByteArray &msg);
+    void updateTrafficMetrics();
 
 private:
     QTcpSocket *_socket;
@@ -105,6 +107,10 @@ private:
     int _heartBeatCount;
     int _lag;
     quint32 _msgSize;
+    qint64 _payloadBytesRead{0};
+    qint64 _payloadBytesWritten{0};
+    QString _metricsLabelsIn;   //!< Built once the peer has been added to a SignalProxy
+    QString _metricsLabelsOut;
 };
 
 #endif
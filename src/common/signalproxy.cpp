@@ -23,6 +23,8 @@
 #include <QMetaMethod>
 #include <QMetaProperty>
 #include <QThread>
+#include <QTimer>
+#include <QUuid>
 
 #ifdef HAVE_SSL
     #include <QSslSocket>
@@ -241,12 +243,22 @@ void SignalProxy::init()
 
 void SignalProxy::initServer()
 {
+    _epoch = QUuid::createUuid().toByteArray();
+    attachSlot("__resumeSync__", this, SLOT(resumeSync(QVariantMap)));
+
+    if (!_announceTimer) {
+        _announceTimer = new QTimer(this);
+        _announceTimer->setInterval(10000);
+        connect(_announceTimer, SIGNAL(timeout()), SLOT(announceRevision()));
+        _announceTimer->start();
+    }
 }
 
 
 void SignalProxy::initClient()
 {
     attachSlot("__objectRenamed__", this, SLOT(objectRenamed(QByteArray,QString,QString)));
+    attachSlot("__syncRevision__", this, SLOT(syncRevision(QVariantMap)));
 }
 
 
@@ -304,6 +316,20 @@ bool SignalProxy::addPeer(Peer *peer)
 
     peer->setSignalProxy(this);
 
+    // Ask the core to skip objects we still know from the previous connection, if they're unchanged
+    if (proxyMode() == Client && !_storedInitData.isEmpty()) {
+        if (peer->hasFeature(Quassel::Feature::DeltaSync)) {
+            QVariantMap state;
+            state["epoch"] = _storedEpoch;
+            state["revision"] = _storedRevision;
+            state["objects"] = QStringList(_storedInitData.keys());
+            dispatch(peer, RpcCall("__resumeSync__", QVariantList() << state));
+        }
+        else {
+            _storedInitData.clear();
+        }
+    }
+
     if (peerCount() == 1)
         emit connected();
 
@@ -340,9 +366,15 @@ void SignalProxy::removePeer(Peer *peer)
         return;
     }
 
+    if (proxyMode() == Client)
+        storeInitData(peer);
+
     disconnect(peer, 0, this, 0);
     peer->setSignalProxy(0);
 
+    _pendingUpdates.remove(peer);
+    _announcedRevisions.remove(peer);
+    _resumeStates.remove(peer);
     _peerMap.remove(peer->id());
     emit peerRemoved(peer);
 
@@ -367,6 +399,8 @@ void SignalProxy::renameObject(const SyncableObject *obj, const QString &newname
     if (proxyMode() == Client)
         return;
 
+    updateRevision(obj);
+
     const QMetaObject *meta = obj->syncMetaObject();
     const QByteArray className(meta->className());
     objectRenamed(className, newname, oldname);
@@ -459,6 +493,7 @@ void SignalProxy::synchronize(SyncableObject *obj)
     _syncSlave[className][obj->objectName()] = obj;
 
     if (proxyMode() == Server) {
+        updateRevision(obj);
         obj->setInitialized();
         emit objectInitialized(obj);
     }
@@ -501,6 +536,12 @@ void SignalProxy::detachSlots(QObject *receiver)
 
 void SignalProxy::stopSynchronize(SyncableObject *obj)
 {
+    // Send what's pending for the object while the peers still know it
+    for (Peer *peer : _pendingUpdates.keys()) {
+        if (_pendingUpdates[peer].index.contains(obj))
+            flushPendingUpdates(peer);
+    }
+
     // we can't use a className here, since it might be effed up, if we receive the call as a result of a decon
     // gladly the objectName() is still valid. So we have only to iterate over the classes not each instance! *sigh*
     QHash<QByteArray, ObjectId>::iterator classIter = _syncSlave.begin();
@@ -527,6 +568,9 @@ void SignalProxy::dispatch(const T &protoMessage)
 template<class T>
 void SignalProxy::dispatch(Peer *peer, const T &protoMessage)
 {
+    // Anything else sent to the peer must not overtake pending property updates
+    flushPendingUpdates(peer);
+
     _targetPeer = peer;
 
     if (peer && peer->isOpen())
@@ -541,6 +585,9 @@ void SignalProxy::dispatch(Peer *peer, const T &protoMessage)
 void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
 {
     if (!_syncSlave.contains(syncMessage.className) || !_syncSlave[syncMessage.className].contains(syncMessage.objectName)) {
+        // With lazily synced channel users, we're legitimately not told about users in channels we didn't look at yet
+        if (syncMessage.className == "IrcUser" && peer->hasFeature(Quassel::Feature::LazyChannelUsers))
+            return;
         qWarning() << QString("no registered receiver for sync call: %1::%2 (objectName=\"%3\"). Params are:").arg(syncMessage.className, syncMessage.slotName, syncMessage.objectName)
                    << syncMessage.params;
         return;
@@ -577,6 +624,7 @@ void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
         if (eMeta->argTypes(receiverId).count() > 1)
             returnParams << syncMessage.params;
         returnParams << returnValue;
+        flushPendingUpdates(peer);
         _targetPeer = peer;
         peer->dispatch(SyncMessage(syncMessage.className, syncMessage.objectName, eMeta->methodName(receiverId), returnParams));
         _targetPeer = nullptr;
@@ -602,16 +650,38 @@ void SignalProxy::handle(Peer *peer, const InitRequest &initRequest)
     }
 
     SyncableObject *obj = _syncSlave[initRequest.className][initRequest.objectName];
+    flushPendingUpdates(peer);
     _targetPeer = peer;
-    peer->dispatch(InitData(initRequest.className, initRequest.objectName, initData(obj)));
+
+    // Nothing changed since the client's previous connection, so it can use what it already has. This only holds for
+    // the first request of each object; the client has given up its copy once it's answered.
+    bool isUnchanged = false;
+    quint64 baseRevision = 0;
+    auto resumeState = _resumeStates.find(peer);
+    if (resumeState != _resumeStates.end() && resumeState->objects.remove(initKey(initRequest.className, initRequest.objectName))) {
+        baseRevision = resumeState->revision;
+        isUnchanged = obj->revision() <= baseRevision;
+        if (resumeState->objects.isEmpty())
+            _resumeStates.erase(resumeState);
+    }
+
+    if (isUnchanged) {
+        QVariantMap unchanged;
+        unchanged["__unchanged__"] = true;
+        peer->dispatch(InitData(initRequest.className, initRequest.objectName, unchanged));
+    }
+    else {
+        // Even then, the children it includes (e.g. a Network's IrcUsers) may be unchanged
+        _initBaseRevision = baseRevision;
+        peer->dispatch(InitData(initRequest.className, initRequest.objectName, initData(obj)));
+        _initBaseRevision = 0;
+    }
     _targetPeer = nullptr;
 }
 
 
 void SignalProxy::handle(Peer *peer, const InitData &initData)
 {
-    Q_UNUSED(peer)
-
     if (!_syncSlave.contains(initData.className)) {
         qWarning() << "SignalProxy::handleInitData() received initData for unregistered Class:"
                    << initData.className;
@@ -625,7 +695,28 @@ void SignalProxy::handle(Peer *peer, const InitData &initData)
     }
 
     SyncableObject *obj = _syncSlave[initData.className][initData.objectName];
-    setInitData(obj, initData.initData);
+    QString key = initKey(initData.className, initData.objectName);
+    if (initData.initData.contains("__unchanged__")) {
+        if (!_storedInitData.contains(key)) {
+            // We don't have the object's state anymore, so ask for all of it; the core only skips it once
+            qDebug() << "SignalProxy::handleInitData() requesting full init data for Object without stored state:"
+                     << initData.className << initData.objectName;
+            dispatch(peer, InitRequest(initData.className, initData.objectName));
+            return;
+        }
+        setInitData(obj, _storedInitData.take(key));
+    }
+    else {
+        QVariantMap properties = initData.initData;
+        if (!obj->mergeInitData(properties, _storedInitData.take(key))) {
+            qDebug() << "SignalProxy::handleInitData() requesting full init data for Object with incomplete stored state:"
+                     << initData.className << initData.objectName;
+            dispatch(peer, InitRequest(initData.className, initData.objectName));
+            return;
+        }
+        setInitData(obj, properties);
+    }
+    _initDataReceived << key;
 }
 
 
@@ -663,6 +754,8 @@ bool SignalProxy::invokeSlot(QObject *receiver, int methodId, const QVariantList
                    0, 0, 0, 0, 0, // and 10 args - that's the max size qt can handle with signals and slots
                    0, 0, 0, 0, 0 };
 
+    PeerPtr sourcePeer = peer;
+
     // check for argument compatibility and build params array
     for (int i = 0; i < numArgs; i++) {
         if (!params[i].isValid()) {
@@ -679,7 +772,11 @@ bool SignalProxy::invokeSlot(QObject *receiver, int methodId, const QVariantList
             return false;
         }
 
-        _a[i+1] = const_cast<void *>(params[i].constData());
+        // PeerPtr arguments are meaningless on the wire, hand the receiver the peer that actually sent the call
+        if (peer && args[i] == qMetaTypeId<PeerPtr>())
+            _a[i+1] = &sourcePeer;
+        else
+            _a[i+1] = const_cast<void *>(params[i].constData());
     }
 
     if (returnValue.type() != QVariant::Invalid)
@@ -735,6 +832,85 @@ void SignalProxy::setInitData(SyncableObject *obj, const QVariantMap &properties
 }
 
 
+// Children are part of their parent's init data (e.g. a Network's IrcUsers), so they change it as well. They keep
+// revisions of their own though, so a changed parent can leave out those that didn't change.
+void SignalProxy::updateRevision(const SyncableObject *obj)
+{
+    _revision++;
+    for (const QObject *object = obj; object; object = object->parent()) {
+        if (const SyncableObject *syncObject = qobject_cast<const SyncableObject *>(object))
+            syncObject->_revision = _revision;
+    }
+}
+
+
+void SignalProxy::announceRevision()
+{
+    QVariantMap state;
+    state["epoch"] = _epoch;
+    state["revision"] = _revision;
+    for (auto peer : _peerMap.values()) {
+        if (!peer->hasFeature(Quassel::Feature::DeltaSync)
+            || (_announcedRevisions.contains(peer) && _announcedRevisions[peer] == _revision))
+            continue;
+        // dispatch() sends the pending updates first, so the peer knows everything up to the revision
+        dispatch(peer, RpcCall("__syncRevision__", QVariantList() << state));
+        _announcedRevisions[peer] = _revision;
+    }
+}
+
+
+void SignalProxy::resumeSync(const QVariantMap &state)
+{
+    Peer *peer = sourcePeer();
+    if (!peer || state["epoch"].toByteArray() != _epoch)
+        return; // the client's state is from a different session (or core run)
+
+    ResumeState &resumeState = _resumeStates[peer];
+    resumeState.revision = state["revision"].toULongLong();
+    resumeState.objects = state["objects"].toStringList().toSet();
+}
+
+
+void SignalProxy::syncRevision(const QVariantMap &state)
+{
+    _syncEpoch = state["epoch"].toByteArray();
+    _syncRevision = state["revision"].toULongLong();
+
+    // The core can't have used what we kept from a different session
+    if (_storedEpoch != _syncEpoch)
+        _storedInitData.clear();
+}
+
+
+// Keeps the state of the objects the core sent us, so they needn't be sent again if the connection is resumed
+void SignalProxy::storeInitData(Peer *peer)
+{
+    _storedInitData.clear();
+    if (!_syncEpoch.isEmpty() && peer->hasFeature(Quassel::Feature::DeltaSync)) {
+        _targetPeer = peer;
+        for (auto classIter = _syncSlave.constBegin(); classIter != _syncSlave.constEnd(); ++classIter) {
+            for (auto objIter = classIter->constBegin(); objIter != classIter->constEnd(); ++objIter) {
+                QString key = initKey(classIter.key(), objIter.key());
+                if (objIter.value()->isInitialized() && _initDataReceived.contains(key))
+                    _storedInitData[key] = initData(objIter.value());
+            }
+        }
+        _targetPeer = nullptr;
+        _storedEpoch = _syncEpoch;
+        _storedRevision = _syncRevision;
+    }
+    _syncEpoch.clear();
+    _initDataReceived.clear();
+}
+
+
+QString SignalProxy::initKey(const QByteArray &className, const QString &objectName)
+{
+    return QString::fromLatin1(className) + '/' + objectName;
+}
+
+
 void SignalProxy::customEvent(QEvent *event)
 {
     switch ((int)event->type()) {
@@ -745,6 +921,12 @@ void SignalProxy::customEvent(QEvent *event)
         break;
     }
 
+    case FlushUpdatesEvent:
+        _flushScheduled = false;
+        flushPendingUpdates();
+        event->accept();
+        break;
+
     default:
         qWarning() << Q_FUNC_INFO << "Received unknown custom event:" << event->type();
         return;
@@ -758,11 +940,15 @@ void SignalProxy::sync_call__(const SyncableObject *obj, SignalProxy::ProxyMode
     if (modeType != _proxyMode)
         return;
 
+    if (_proxyMode == Server)
+        updateRevision(obj);
+
     ExtendedMetaObject *eMeta = extendedMetaObject(obj);
 
     QVariantList params;
 
-    const QList<int> &argTypes = eMeta->argTypes(eMeta->methodId(QByteArray(funcname)));
+    int methodId = eMeta->methodId(QByteArray(funcname));
+    const QList<int> &argTypes = eMeta->argTypes(methodId);
 
     for (int i = 0; i < argTypes.size(); i++) {
         if (argTypes[i] == 0) {
@@ -773,13 +959,70 @@ void SignalProxy::sync_call__(const SyncableObject *obj, SignalProxy::ProxyMode
         params << QVariant(argTypes[i], va_arg(ap, void *));
     }
 
+    // Peers that support it get all property changes of an object within one event loop iteration as a single
+    // update; e.g. a WHO reply changes up to five properties of an IrcUser.
+    const QByteArray &property = (_proxyMode == Server && methodId >= 0) ? eMeta->setterProperty(methodId) : QByteArray();
+    auto send = [&](Peer *peer) {
+        if (!property.isEmpty() && peer->hasFeature(Quassel::Feature::SyncCoalescing))
+            queueUpdate(peer, obj, eMeta->metaObject()->className(), property, params.first());
+        else
+            dispatch(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+    };
+
     if (_restrictMessageTarget) {
         for (auto peer : _restrictedTargets) {
             if (peer != nullptr)
-                dispatch(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+                send(peer);
+        }
+    } else {
+        for (auto peer : _peerMap.values())
+            send(peer);
+    }
+}
+
+
+void SignalProxy::queueUpdate(Peer *peer, const SyncableObject *obj, const QByteArray &className, const QByteArray &property, const QVariant &value)
+{
+    PendingUpdates &pending = _pendingUpdates[peer];
+    auto it = pending.index.constFind(obj);
+    if (it == pending.index.constEnd()) {
+        it = pending.index.insert(obj, pending.updates.count());
+        pending.updates.append(PendingUpdate{className, obj->objectName(), QVariantList()});
+    }
+    // Replaces an earlier value that hasn't been sent yet, and moves it behind the changes made since
+    QVariantList &properties = pending.updates[it.value()].properties;
+    const QString name = QString::fromLatin1(property);
+    for (int i = 0; i < properties.count(); i += 2) {
+        if (properties.at(i).toString() == name) {
+            properties.erase(properties.begin() + i, properties.begin() + i + 2);
+            break;
         }
-    } else
-        dispatch(SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+    }
+    properties << name << value;
+
+    if (!_flushScheduled) {
+        _flushScheduled = true;
+        QCoreApplication::postEvent(this, new QEvent(QEvent::Type(FlushUpdatesEvent)));
+    }
+}
+
+
+void SignalProxy::flushPendingUpdates(Peer *peer)
+{
+    if (!_pendingUpdates.contains(peer))
+        return;
+
+    // Take them first, dispatch() flushes too
+    PendingUpdates pending = _pendingUpdates.take(peer);
+    for (const PendingUpdate &update : pending.updates)
+        dispatch(peer, SyncMessage(update.className, update.objectName, "setProperties", QVariantList() << QVariant(update.properties)));
+}
+
+
+void SignalProxy::flushPendingUpdates()
+{
+    for (Peer *peer : _pendingUpdates.keys())
+        flushPendingUpdates(peer);
 }
 
 
@@ -846,6 +1089,16 @@ QVariantList SignalProxy::peerData() {
     return result;
 }
 
+QSet<Peer *> SignalProxy::peersWithFeature(Quassel::Feature feature) const
+{
+    QSet<Peer *> peers;
+    for (auto &&peer : _peerMap.values()) {
+        if (peer->hasFeature(feature))
+            peers.insert(peer);
+    }
+    return peers;
+}
+
 Peer *SignalProxy::peerById(int peerId) {
     // We use ::value() here instead of the [] operator because the latter has the side-effect
     // of automatically inserting a null value with the passed key into the map.  See
@@ -948,6 +1201,28 @@ const SignalProxy::ExtendedMetaObject::MethodDescriptor &SignalProxy::ExtendedMe
 }
 
 
+const QByteArray &SignalProxy::ExtendedMetaObject::setterProperty(int methodId)
+{
+    auto it = _setterProperties.constFind(methodId);
+    if (it == _setterProperties.constEnd()) {
+        // setFoo(T) is the setter of foo, if that is a writable property of type T
+        QByteArray property;
+        const QByteArray &name = methodName(methodId);
+        if (name.length() > 3 && name.startsWith("set") && argTypes(methodId).count() == 1) {
+            QByteArray candidate = name.mid(3, 1).toLower() + name.mid(4);
+            int propertyIndex = _meta->indexOfProperty(candidate.constData());
+            if (propertyIndex >= 0) {
+                QMetaProperty metaProperty = _meta->property(propertyIndex);
+                if (metaProperty.isWritable() && metaProperty.userType() == argTypes(methodId).first())
+                    property = candidate;
+            }
+        }
+        it = _setterProperties.insert(methodId, property);
+    }
+    return it.value();
+}
+
+
 const QHash<int, int> &SignalProxy::ExtendedMetaObject::receiveMap()
 {
     if (_receiveMap.isEmpty()) {
@@ -30,6 +30,7 @@
 
 struct QMetaObject;
 class QIODevice;
+class QTimer;
 
 class Peer;
 class SyncableObject;
@@ -47,7 +48,8 @@ public:
     };
 
     enum EventType {
-        RemovePeerEvent = QEvent::User
+        RemovePeerEvent = QEvent::User,
+        FlushUpdatesEvent
     };
 
     SignalProxy(QObject *parent);
@@ -110,6 +112,9 @@ public:
     inline int peerCount() const { return _peerMap.size(); }
     QVariantList peerData();
 
+    //! The peers supporting the given feature, e.g. for restricting a call to them
+    QSet<Peer *> peersWithFeature(Quassel::Feature feature) const;
+
     Peer *peerById(int peerId);
 
     /**
@@ -124,6 +129,12 @@ public:
     Peer *targetPeer();
     void setTargetPeer(Peer *targetPeer);
 
+    /**
+     * @return If sending init data to a peer resuming its connection, the revision of the state the peer still has,
+     *         so parts unchanged since can be left out (see SyncableObject::mergeInitData()); 0 otherwise
+     */
+    inline quint64 initBaseRevision() const { return _initBaseRevision; }
+
 public slots:
     void detachObject(QObject *obj);
     void detachSignals(QObject *sender);
@@ -139,6 +150,10 @@ private slots:
     void objectRenamed(const QByteArray &classname, const QString &newname, const QString &oldname);
     void updateSecureState();
 
+    void announceRevision();
+    void resumeSync(const QVariantMap &state);
+    void syncRevision(const QVariantMap &state);
+
 signals:
     void peerRemoved(Peer *peer);
     void connected();
@@ -182,10 +197,18 @@ private:
     bool invokeSlot(QObject *receiver, int methodId, const QVariantList &params, QVariant &returnValue, Peer *peer = 0);
     bool invokeSlot(QObject *receiver, int methodId, const QVariantList &params = QVariantList(), Peer *peer = 0);
 
+    void queueUpdate(Peer *peer, const SyncableObject *obj, const QByteArray &className, const QByteArray &property, const QVariant &value);
+    void flushPendingUpdates(Peer *peer);
+    void flushPendingUpdates();
+
     void requestInit(SyncableObject *obj);
     QVariantMap initData(SyncableObject *obj) const;
     void setInitData(SyncableObject *obj, const QVariantMap &properties);
 
+    void updateRevision(const SyncableObject *obj);
+    void storeInitData(Peer *peer);
+    static QString initKey(const QByteArray &className, const QString &objectName);
+
     static void disconnectDevice(QIODevice *dev, const QString &reason = QString());
 
     QHash<int, Peer*> _peerMap;
@@ -216,14 +239,51 @@ private:
     QSet<Peer *> _restrictedTargets;
     bool _restrictMessageTarget = false;
 
+    // Property updates not sent yet, merged per object and kept in the order of the first change
+    struct PendingUpdate {
+        QByteArray className;
+        QString objectName;
+        QVariantList properties; // pairs of name and value, in the order of their last change
+    };
+    struct PendingUpdates {
+        QList<PendingUpdate> updates;
+        QHash<const SyncableObject *, int> index;
+    };
+    QHash<Peer *, PendingUpdates> _pendingUpdates;
+    bool _flushScheduled = false;
+
     Peer *_sourcePeer = nullptr;
     Peer *_targetPeer = nullptr;
 
+    // Delta sync (see Quassel::Feature::DeltaSync). On the core, every change to a synced object gets a new
+    // revision, which is periodically announced to the clients once everything up to it has been sent. A client
+    // that reconnects to the same session presents the last revision it saw, and gets told which of the objects
+    // it still holds are unchanged.
+    QByteArray _epoch;        // identifies the session the revisions belong to
+    quint64 _revision = 0;
+    QHash<Peer *, quint64> _announcedRevisions;
+    QTimer *_announceTimer = nullptr;
+    struct ResumeState {
+        quint64 revision;
+        QSet<QString> objects;
+    };
+    QHash<Peer *, ResumeState> _resumeStates;
+    quint64 _initBaseRevision = 0;
+
+    // ...and on the client
+    QByteArray _syncEpoch;    // last announced by the core
+    quint64 _syncRevision = 0;
+    QSet<QString> _initDataReceived;
+    QByteArray _storedEpoch;  // state of the previous connection
+    quint64 _storedRevision = 0;
+    QHash<QString, QVariantMap> _storedInitData;
+
     thread_local static SignalProxy *_current;
 
     friend class SignalRelay;
     friend class SyncableObject;
     friend class Peer;
+    friend class RemotePeer;
 };
 
 
@@ -264,6 +324,9 @@ public:
 
     inline int methodId(const QByteArray &methodName) { return _methodIds.contains(methodName) ? _methodIds[methodName] : -1; }
 
+    //! Returns the name of the property the given slot is the setter of, or an empty QByteArray for other slots
+    const QByteArray &setterProperty(int methodId);
+
     inline int updatedRemotelyId() { return _updatedRemotelyId; }
 
     inline const QHash<QByteArray, int> &slotMap() { return _methodIds; }
@@ -283,4 +346,5 @@ private:
     QHash<int, MethodDescriptor> _methods;
     QHash<QByteArray, int> _methodIds;
     QHash<int, int> _receiveMap; // if slot x is called then hand over the result to slot y
+    QHash<int, QByteArray> _setterProperties;
 };
@@ -197,6 +197,13 @@ void SyncableObject::update(const QVariantMap &properties)
 }
 
 
+void SyncableObject::setProperties(const QVariantList &properties)
+{
+    for (int i = 0; i + 1 < properties.count(); i += 2)
+        setProperty(properties.at(i).toString().toLatin1(), properties.at(i + 1));
+}
+
+
 void SyncableObject::requestUpdate(const QVariantMap &properties)
 {
     if (allowClientUpdates()) {
@@ -218,6 +225,23 @@ void SyncableObject::sync_call__(SignalProxy::ProxyMode modeType, const char *fu
 }
 
 
+void SyncableObject::updateRevision() const
+{
+    foreach(SignalProxy *proxy, _signalProxies) {
+        if (proxy->proxyMode() == SignalProxy::Server)
+            proxy->updateRevision(this);
+    }
+}
+
+
+bool SyncableObject::mergeInitData(QVariantMap &properties, const QVariantMap &previous) const
+{
+    Q_UNUSED(properties);
+    Q_UNUSED(previous);
+    return true;
+}
+
+
 void SyncableObject::synchronize(SignalProxy *proxy)
 {
     if (_signalProxies.contains(proxy))
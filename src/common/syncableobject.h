@@ -84,11 +84,35 @@ public:
     inline void setAllowClientUpdates(bool allow) { _allowClientUpdates = allow; }
     inline bool allowClientUpdates() const { return _allowClientUpdates; }
 
+    //! Returns the revision of the core session's state in which this object (or a child of it) was last changed
+    inline quint64 revision() const { return _revision; }
+
+    //! Gives the object a new revision for a change that isn't synced through the object itself
+    /** E.g. IrcChannel::joinIrcUsers() also changes the channels of the joining IrcUsers, but only the channel syncs.
+     */
+    void updateRevision() const;
+
+    //! Completes init data that leaves out parts of the object the receiver still has
+    /** A core resuming a client's connection may omit what didn't change since (see SignalProxy::initBaseRevision()).
+     *  The default implementation leaves \a properties alone.
+     *  \param properties The init data received, completed in place
+     *  \param previous   The object's init data as of the previous connection, or an empty map
+     *  \return false, if \a properties refers to state missing from \a previous
+     */
+    virtual bool mergeInitData(QVariantMap &properties, const QVariantMap &previous) const;
+
 public slots:
     virtual void setInitialized();
     void requestUpdate(const QVariantMap &properties);
     virtual void update(const QVariantMap &properties);
 
+    //! Sets the given properties through their setters, as if each had been synced on its own
+    /** Used by the SignalProxy for sending several property changes in one message (see Quassel::Feature::SyncCoalescing).
+     *  Unlike update(), this doesn't emit updated().
+     *  \param properties Pairs of property name and value, applied in the order given
+     */
+    void setProperties(const QVariantList &properties);
+
 protected:
     void sync_call__(SignalProxy::ProxyMode modeType, const char *funcname, ...) const;
 
@@ -108,6 +132,7 @@ private:
 
     bool _initialized;
     bool _allowClientUpdates;
+    mutable quint64 _revision = 0;
 
     QList<SignalProxy *> _signalProxies;
 
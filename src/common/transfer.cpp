@@ -27,6 +27,7 @@ Transfer::Transfer(const QUuid &uuid, QObject *parent)
     _direction(Direction::Receive),
     _port(0),
     _fileSize(0),
+    _spooled(false),
     _uuid(uuid)
 {
     init();
@@ -41,6 +42,7 @@ Transfer::Transfer(Direction direction, const QString &nick, const QString &file
     _port(port),
     _fileSize(fileSize),
     _nick(nick),
+    _spooled(false),
     _uuid(QUuid::createUuid())
 {
     init();
@@ -210,6 +212,22 @@ void Transfer::setNick(const QString &nick)
 }
 
 
+bool Transfer::isSpooled() const
+{
+    return _spooled;
+}
+
+
+void Transfer::setSpooled(bool spooled)
+{
+    if (_spooled != spooled) {
+        _spooled = spooled;
+        SYNC(ARG(spooled));
+        emit spooledChanged(spooled);
+    }
+}
+
+
 void Transfer::setError(const QString &errorString)
 {
     qWarning() << Q_FUNC_INFO << errorString;
@@ -40,6 +40,7 @@ class Transfer : public SyncableObject
     Q_PROPERTY(QString fileName READ fileName WRITE setFileName NOTIFY fileNameChanged);
     Q_PROPERTY(quint64 fileSize READ fileSize WRITE setFileSize NOTIFY fileSizeChanged);
     Q_PROPERTY(QString nick READ nick WRITE setNick NOTIFY nickChanged);
+    Q_PROPERTY(bool spooled READ isSpooled WRITE setSpooled NOTIFY spooledChanged);
 
 public:
     enum class Status {
@@ -74,16 +75,23 @@ public:
     quint64 fileSize() const;
     QString nick() const;
 
+    //! Whether the core receives this transfer into its spool directory, from where clients fetch it in ranges
+    bool isSpooled() const;
+
     virtual quint64 transferred() const = 0;
 
 public slots:
     // called on the client side
     virtual void accept(const QString &savePath) const { Q_UNUSED(savePath); }
+    virtual void resume(const QString &savePath) const { Q_UNUSED(savePath); }
     virtual void reject() const {}
 
     // called on the core side through sync calls
     virtual void requestAccepted(PeerPtr peer) { Q_UNUSED(peer); }
+    virtual void requestResumed(PeerPtr peer, quint64 position) { Q_UNUSED(peer); Q_UNUSED(position); }
     virtual void requestRejected(PeerPtr peer) { Q_UNUSED(peer); }
+    virtual void requestDataAcknowledged(PeerPtr peer, quint64 position) { Q_UNUSED(peer); Q_UNUSED(position); }
+    virtual void requestRange(PeerPtr peer, quint64 position, quint64 length) { Q_UNUSED(peer); Q_UNUSED(position); Q_UNUSED(length); }
 
 signals:
     void statusChanged(Transfer::Status state);
@@ -94,6 +102,7 @@ signals:
     void fileSizeChanged(quint64 fileSize);
     void transferredChanged(quint64 transferred);
     void nickChanged(const QString &nick);
+    void spooledChanged(bool spooled);
 
     void error(const QString &errorString);
 
@@ -103,9 +112,12 @@ signals:
 protected slots:
     void setStatus(Transfer::Status status);
     void setError(const QString &errorString);
+    void setSpooled(bool spooled);
 
     // called on the client side through sync calls
     virtual void dataReceived(PeerPtr, const QByteArray &data) { Q_UNUSED(data); }
+    virtual void rangeReceived(PeerPtr, quint64 position, const QByteArray &data) { Q_UNUSED(position); Q_UNUSED(data); }
+    virtual void rangeRejected(PeerPtr, quint64 position, const QString &reason) { Q_UNUSED(position); Q_UNUSED(reason); }
 
     virtual void cleanUp() = 0;
 
@@ -127,6 +139,7 @@ private:
     quint16 _port;
     quint64 _fileSize;
     QString _nick;
+    bool _spooled;
     QUuid _uuid;
 };
 
@@ -24,12 +24,21 @@
 #include <array>
 #include <utility>
 
+#include <cstring>
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
 #include <QTextCodec>
 #include <QVector>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "quassel.h"
 
 // MIBenum values from http://www.iana.org/assignments/character-sets/character-sets.xml#table-character-sets-1
@@ -96,18 +105,47 @@ QString stripAcceleratorMarkers(const QString &label_)
 }
 
 
+//! Returns the length of the 7-bit prefix of the given data, looking at 16 (or 8) bytes at a time
+static int asciiPrefixLength(const char *data, int size)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= size; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        quint64 chunk;
+        memcpy(&chunk, data + i, sizeof(chunk));
+        if (chunk & Q_UINT64_C(0x8080808080808080))
+            break;
+    }
+#endif
+    while (i < size && !(data[i] & 0x80))
+        i++;
+    return i;
+}
+
+
 QString decodeString(const QByteArray &input, QTextCodec *codec)
 {
     if (codec && utf8DetectionBlacklist.contains(codec->mibEnum()))
         return codec->toUnicode(input);
 
+    // Most of what we see on IRC is plain ASCII, which needs neither validating nor a codec
+    int asciiLength = asciiPrefixLength(input.constData(), input.size());
+    if (asciiLength == input.size())
+        return QString::fromLatin1(input);
+
     // First, we check if it's utf8. It is very improbable to encounter a string that looks like
     // valid utf8, but in fact is not. This means that if the input string passes as valid utf8, it
     // is safe to assume that it is.
     // Q_ASSERT(sizeof(const char) == sizeof(quint8));  // In God we trust...
     bool isUtf8 = true;
     int cnt = 0;
-    for (int i = 0; i < input.size(); i++) {
+    for (int i = asciiLength; i < input.size(); i++) {
         if (cnt) {
             // We check a part of a multibyte char. These need to be of the form 10yyyyyy.
             if ((input[i] & 0xc0) != 0x80) { isUtf8 = false; break; }
@@ -131,6 +169,14 @@ QString decodeString(const QByteArray &input, QTextCodec *codec)
 }
 
 
+bool isCodecIndependent(const QByteArray &input)
+{
+    // The blacklisted codecs are 7-bit, but switch character sets with escape sequences
+    return asciiPrefixLength(input.constData(), input.size()) == input.size()
+           && !memchr(input.constData(), '\x1b', input.size());
+}
+
+
 uint editingDistance(const QString &s1, const QString &s2)
 {
     uint n = s1.size()+1;
@@ -194,6 +240,29 @@ QString secondsToString(int timeInSeconds)
 }
 
 
+// Sessions on the core deserialize concurrently, so the pool needs to be locked
+static QMutex stringPoolMutex;
+static QSet<QString> stringPool;
+static const int maxStringPoolSize = 64 * 1024;
+
+QString internString(const QString &string)
+{
+    if (string.isEmpty())
+        return string;
+
+    QMutexLocker locker(&stringPoolMutex);
+    auto it = stringPool.constFind(string);
+    if (it != stringPool.constEnd())
+        return *it;
+
+    // Strings already handed out keep their data, we only lose the chance to share it with future copies
+    if (stringPool.size() >= maxStringPoolSize)
+        stringPool.clear();
+    stringPool.insert(string);
+    return string;
+}
+
+
 QByteArray prettyDigest(const QByteArray &digest)
 {
     QByteArray hexDigest = digest.toHex().toUpper();
@@ -46,6 +46,23 @@ QString secondsToString(int timeInSeconds);
  */
 QString decodeString(const QByteArray &input, QTextCodec *codec = 0);
 
+//! Check if a string decodes the same regardless of the text codec.
+/** This is the case for 7-bit input without escape sequences, which decodeString() turns into
+ *  QString::fromLatin1(input) with any codec. Callers can use this to skip looking up the codec.
+ *  \param input The input string containing encoded data
+ *  \return true, if the codec does not matter for decoding \a input
+ */
+bool isCodecIndependent(const QByteArray &input);
+
+//! Return a string equal to the given one, sharing its data with earlier equal strings.
+/** Strings that repeat a lot, like the senders or buffer names of received messages, would otherwise
+ *  occupy memory for each copy separately. The pool is bounded, so this never returns a string that
+ *  compares unequal, but may stop deduplicating strings passed before the pool was last reset.
+ *  \param string The string to intern
+ *  \return An implicitly shared copy of \a string
+ */
+QString internString(const QString &string);
+
 uint editingDistance(const QString &s1, const QString &s2);
 
 template<typename T>
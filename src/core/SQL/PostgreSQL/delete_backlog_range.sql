@@ -0,0 +1,5 @@
+DELETE FROM backlog
+WHERE bufferid = :bufferid
+    AND bufferid IN (SELECT bufferid FROM buffer WHERE userid = :userid)
+    AND messageid >= :firstmsg
+    AND messageid < :lastmsg
@@ -0,0 +1,4 @@
+INSERT INTO backlog (time, bufferid, type, flags, senderid, senderprefixes, message)
+SELECT *
+FROM unnest($1::timestamp[], $2::integer[], $3::integer[], $4::integer[], $5::bigint[], $6::text[], $7::text[])
+RETURNING messageid
@@ -0,0 +1,2 @@
+DELETE FROM backlog
+WHERE messageid > ? AND messageid <= ?
@@ -1,2 +0,0 @@
-INSERT INTO backlog (messageid, time, bufferid, type, flags, senderid, senderprefixes, message)
-VALUES (?, ?, ?, ?, ?, ?, ?, ?)
@@ -0,0 +1,3 @@
+INSERT INTO backlog (messageid, time, bufferid, type, flags, senderid, senderprefixes, message)
+SELECT *
+FROM unnest($1::bigint[], $2::timestamp[], $3::integer[], $4::integer[], $5::integer[], $6::bigint[], $7::text[], $8::text[])
@@ -0,0 +1,8 @@
+SELECT messageid
+FROM backlog
+JOIN buffer ON backlog.bufferid = buffer.bufferid
+WHERE buffer.bufferid = :bufferid
+    AND buffer.userid = :userid
+    AND backlog.time < :time
+ORDER BY backlog.time DESC
+LIMIT 1
@@ -0,0 +1,7 @@
+SELECT messageid, length(message)
+FROM backlog
+JOIN buffer ON backlog.bufferid = buffer.bufferid
+WHERE buffer.userid = :userid
+    AND backlog.messageid < :lastmsg
+ORDER BY messageid DESC
+LIMIT :limit
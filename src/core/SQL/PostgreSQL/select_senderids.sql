@@ -0,0 +1,3 @@
+SELECT sender.senderid, s.sender, s.realname, s.avatarurl
+FROM unnest($1::text[], $2::text[], $3::text[]) AS s(sender, realname, avatarurl)
+JOIN sender ON sender.sender = s.sender AND coalesce(sender.realname, '') = coalesce(s.realname, '') AND coalesce(sender.avatarurl, '') = coalesce(s.avatarurl, '')
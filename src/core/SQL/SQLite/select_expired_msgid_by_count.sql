@@ -0,0 +1,7 @@
+SELECT messageid
+FROM backlog
+JOIN buffer ON backlog.bufferid = buffer.bufferid
+WHERE buffer.bufferid = :bufferid
+    AND buffer.userid = :userid
+ORDER BY messageid DESC
+LIMIT 1 OFFSET :keepcount
@@ -20,13 +20,17 @@
 
 #include "abstractsqlstorage.h"
 
+#include <QElapsedTimer>
 #include <QMutexLocker>
+#include <QSet>
 #include <QSqlDriver>
 #include <QSqlError>
 #include <QSqlField>
 #include <QSqlQuery>
+#include <QThread>
 
 #include "logmessage.h"
+#include "metrics.h"
 #include "quassel.h"
 
 int AbstractSqlStorage::_nextConnectionId = 0;
@@ -183,10 +187,30 @@ QString AbstractSqlStorage::queryString(const QString &queryName, int version)
     QFile queryFile(queryInfo.filePath());
     if (!queryFile.open(QIODevice::ReadOnly | QIODevice::Text))
         return QString();
-    QString query = QTextStream(&queryFile).readAll();
+    QString query = QTextStream(&queryFile).readAll().trimmed();
     queryFile.close();
 
-    return query.trimmed();
+    if (Metrics::isEnabled() && version == 0) {
+        QMutexLocker locker(&_queryNamesMutex);
+        _queryNames[query] = queryName;
+    }
+
+    return query;
+}
+
+
+QString AbstractSqlStorage::queryName(const QString &query) const
+{
+    QMutexLocker locker(&_queryNamesMutex);
+    return _queryNames.value(query, "other");
+}
+
+
+void AbstractSqlStorage::observeQueryTime(const QString &queryName, const QElapsedTimer &timer) const
+{
+    Metrics::observe("quassel_storage_query_duration_seconds",
+                     Metrics::label("backend", displayName()) + "," + Metrics::label("query", queryName),
+                     timer.nsecsElapsed() / 1e9);
 }
 
 
@@ -495,7 +519,56 @@ AbstractSqlMigrationReader::AbstractSqlMigrationReader()
 }
 
 
-bool AbstractSqlMigrationReader::migrateTo(AbstractSqlMigrationWriter *writer)
+bool AbstractSqlMigrationReader::migrateTo(AbstractSqlMigrationWriter *writer, int threadCount)
+{
+    // If a previous migration was interrupted, everything but (parts of) the backlog has been transferred already
+    qint64 checkpoint = writer->backlogCheckpoint();
+    if (checkpoint >= 0) {
+        qDebug() << qPrintable(QString("Resuming migration of Backlog after message %1...").arg(checkpoint));
+        // The failed attempt has undone its preparations, see abortProcess()
+        writer->resetQuery();
+        if (!writer->preProcess()) {
+            qWarning() << "AbstractSqlMigrationReader::migrateTo(): unable to prepare the writer for resuming the migration!";
+            return false;
+        }
+    }
+    else {
+        if (!transferObjects(writer))
+            return false;
+        checkpoint = 0;
+    }
+
+    if (!transferBacklog(writer, checkpoint, threadCount)) {
+        qWarning() << "Migration Failed! Transferred backlog has been kept, run the migration again to resume it.";
+        writer->abortProcess();
+        return false;
+    }
+
+    if (!writer->transaction()) {
+        qWarning() << "AbstractSqlMigrationReader::migrateTo(): unable to start writer's transaction!";
+        writer->abortProcess();
+        return false;
+    }
+    if (!writer->postProcess() || !writer->clearBacklogCheckpoint()) {
+        qWarning() << "Migration Failed!";
+        if (writer->lastError().isValid()) {
+            qWarning() << "WriterError:";
+            writer->dumpStatus();
+        }
+        writer->rollback();
+        writer->abortProcess();
+        return false;
+    }
+    writer->resetQuery();
+    if (!writer->commit()) {
+        writer->abortProcess();
+        return false;
+    }
+    return true;
+}
+
+
+bool AbstractSqlMigrationReader::transferObjects(AbstractSqlMigrationWriter *writer)
 {
     if (!transaction()) {
         qWarning() << "AbstractSqlMigrationReader::migrateTo(): unable to start reader's transaction!";
@@ -534,9 +607,7 @@ bool AbstractSqlMigrationReader::migrateTo(AbstractSqlMigrationWriter *writer)
     if (!transferMo(Sender, senderMo))
         return false;
 
-    BacklogMO backlogMo;
-    if (!transferMo(Backlog, backlogMo))
-        return false;
+    // the backlog is transferred in chunks afterwards, see transferBacklog()
 
     IrcServerMO ircServerMo;
     if (!transferMo(IrcServer, ircServerMo))
@@ -550,12 +621,132 @@ bool AbstractSqlMigrationReader::migrateTo(AbstractSqlMigrationWriter *writer)
     if (!transferMo(CoreState, coreStateMO))
         return false;
 
-    if (!_writer->postProcess())
+    // Committed together with the objects above, so an interrupted migration can be resumed from here on
+    _writer->resetQuery();
+    if (!_writer->preProcess() || !_writer->setBacklogCheckpoint(0)) {
         abortMigration();
+        return false;
+    }
     return finalizeMigration();
 }
 
 
+// Number of messages (by id) copied per chunk; each chunk is written in a transaction of its own
+static const qint64 backlogChunkSize = 50000;
+
+namespace {
+
+struct BacklogMigrationState
+{
+    QMutex mutex;
+    qint64 nextChunk;
+    qint64 maxId;
+    qint64 checkpoint;               //!< All messages up to here have been written
+    QSet<qint64> finishedChunks;     //!< Chunks written beyond the checkpoint
+    qint64 messageCount{0};
+    bool failed{false};
+};
+
+
+class BacklogMigrationThread : public QThread
+{
+public:
+    BacklogMigrationThread(AbstractSqlMigrationReader *reader, AbstractSqlMigrationWriter *writer, BacklogMigrationState *state)
+        : _reader(reader), _writer(writer), _state(state) {}
+
+protected:
+    void run() override
+    {
+        forever {
+            qint64 first;
+            {
+                QMutexLocker locker(&_state->mutex);
+                if (_state->failed || _state->nextChunk >= _state->maxId)
+                    return;
+                first = _state->nextChunk;
+                _state->nextChunk += backlogChunkSize;
+            }
+
+            qint64 last = first + backlogChunkSize;
+            QList<AbstractSqlMigrator::BacklogMO> backlog;
+            bool success = _reader->readBacklog(first, last, backlog) && _writer->writeBacklog(first, last, backlog);
+
+            QMutexLocker locker(&_state->mutex);
+            if (!success) {
+                qWarning() << qPrintable(QString("Unable to transfer messages %1 to %2 of the Backlog!").arg(first + 1).arg(last));
+                _state->failed = true;
+                return;
+            }
+            _state->messageCount += backlog.count();
+            _state->finishedChunks << first;
+            while (_state->finishedChunks.remove(_state->checkpoint))
+                _state->checkpoint += backlogChunkSize;
+        }
+    }
+
+private:
+    AbstractSqlMigrationReader *_reader;
+    AbstractSqlMigrationWriter *_writer;
+    BacklogMigrationState *_state;
+};
+
+}
+
+
+bool AbstractSqlMigrationReader::transferBacklog(AbstractSqlMigrationWriter *writer, qint64 checkpoint, int threadCount)
+{
+    BacklogMigrationState state;
+    state.nextChunk = checkpoint;
+    state.checkpoint = checkpoint;
+    state.maxId = maxBacklogId();
+    if (state.maxId <= checkpoint)
+        return true;
+
+    threadCount = qMax(1, threadCount);
+    qDebug() << qPrintable(QString("Transferring Backlog using %1 threads...").arg(threadCount));
+
+    QList<BacklogMigrationThread *> threads;
+    for (int i = 0; i < threadCount; i++) {
+        threads << new BacklogMigrationThread(this, writer, &state);
+        threads.last()->start();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 savedCheckpoint = checkpoint;
+    auto reportProgress = [&]() {
+        qint64 currentCheckpoint, messageCount;
+        {
+            QMutexLocker locker(&state.mutex);
+            currentCheckpoint = qMin(state.checkpoint, state.maxId);
+            messageCount = state.messageCount;
+        }
+        // the checkpoint is only advisory, so a failure to store it doesn't abort the migration
+        if (currentCheckpoint != savedCheckpoint && writer->setBacklogCheckpoint(currentCheckpoint))
+            savedCheckpoint = currentCheckpoint;
+
+        qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+        qDebug() << qPrintable(QString("Transferred %1 messages (%2% done), %3 messages/s")
+                               .arg(messageCount)
+                               .arg(100.0 * currentCheckpoint / state.maxId, 0, 'f', 1)
+                               .arg(messageCount * 1000 / elapsed));
+    };
+
+    foreach(BacklogMigrationThread *thread, threads) {
+        while (!thread->wait(5000))
+            reportProgress();
+    }
+    reportProgress();
+    qDeleteAll(threads);
+
+    if (state.failed)
+        return false;
+
+    qDebug() << "Done.";
+    return true;
+}
+
+
 void AbstractSqlMigrationReader::abortMigration(const QString &errorMsg)
 {
     qWarning() << "Migration Failed!";
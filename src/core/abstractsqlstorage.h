@@ -24,6 +24,7 @@
 
 #include <memory>
 
+#include <QElapsedTimer>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -81,6 +82,12 @@ protected:
 
     bool watchQuery(QSqlQuery &query);
 
+    //! Name of the query as passed to queryString(), or "other" for queries not loaded from a file
+    QString queryName(const QString &query) const;
+
+    //! Record the execution time of a query for the metrics (see Metrics)
+    void observeQueryTime(const QString &queryName, const QElapsedTimer &timer) const;
+
     int schemaVersion();
     virtual int installedSchemaVersion() { return -1; };
     virtual bool updateSchemaVersion(int newVersion) = 0;
@@ -122,6 +129,9 @@ private:
     // which allows us thread safe termination of a connection
     class Connection;
     QHash<QThread *, Connection *> _connectionPool;
+
+    mutable QMutex _queryNamesMutex;
+    QHash<QString, QString> _queryNames; // query text -> name, only filled if metrics are enabled
 };
 
 struct SenderData {
@@ -349,17 +359,24 @@ public:
     virtual bool readMo(NetworkMO &network) = 0;
     virtual bool readMo(BufferMO &buffer) = 0;
     virtual bool readMo(SenderMO &sender) = 0;
-    virtual bool readMo(BacklogMO &backlog) = 0;
     virtual bool readMo(IrcServerMO &ircserver) = 0;
     virtual bool readMo(UserSettingMO &userSetting) = 0;
     virtual bool readMo(CoreStateMO &coreState) = 0;
 
-    bool migrateTo(AbstractSqlMigrationWriter *writer);
+    //! Read all messages with first < messageid <= last, ordered by messageid
+    /** This doesn't use the migrator's query, and may be called from several threads at once.
+     */
+    virtual bool readBacklog(qint64 first, qint64 last, QList<BacklogMO> &backlog) = 0;
+    virtual qint64 maxBacklogId() = 0;
+
+    bool migrateTo(AbstractSqlMigrationWriter *writer, int threadCount = 1);
 
 private:
     void abortMigration(const QString &errorMsg = QString());
     bool finalizeMigration();
 
+    bool transferObjects(AbstractSqlMigrationWriter *writer);
+    bool transferBacklog(AbstractSqlMigrationWriter *writer, qint64 checkpoint, int threadCount);
     template<typename T> bool transferMo(MigrationObject moType, T &mo);
 
     AbstractSqlMigrationWriter *_writer;
@@ -375,14 +392,28 @@ public:
     virtual bool writeMo(const NetworkMO &network) = 0;
     virtual bool writeMo(const BufferMO &buffer) = 0;
     virtual bool writeMo(const SenderMO &sender) = 0;
-    virtual bool writeMo(const BacklogMO &backlog) = 0;
     virtual bool writeMo(const IrcServerMO &ircserver) = 0;
     virtual bool writeMo(const UserSettingMO &userSetting) = 0;
     virtual bool writeMo(const CoreStateMO &coreState) = 0;
 
-    inline bool migrateFrom(AbstractSqlMigrationReader *reader) { return reader->migrateTo(this); }
+    //! Replace all messages with first < messageid <= last by the given ones, in a transaction of its own
+    /** Writing the same range twice yields the same result, so chunks that might have been written before an
+     *  interrupted migration can simply be written again. May be called from several threads at once.
+     */
+    virtual bool writeBacklog(qint64 first, qint64 last, const QList<BacklogMO> &backlog) = 0;
+
+    //! The message id up to which the backlog has been migrated, or -1 if no migration is in progress
+    virtual qint64 backlogCheckpoint() = 0;
+    virtual bool setBacklogCheckpoint(qint64 msgId) = 0;
+    virtual bool clearBacklogCheckpoint() = 0;
+
+    inline bool migrateFrom(AbstractSqlMigrationReader *reader, int threadCount = 1) { return reader->migrateTo(this, threadCount); }
 
+    // called before the backlog is transferred
+    virtual inline bool preProcess() { return true; }
     // called after migration process
     virtual inline bool postProcess() { return true; }
+    // called if the migration fails after preProcess(), to undo what it changed
+    virtual inline bool abortProcess() { return true; }
     friend class AbstractSqlMigrationReader;
 };
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+
+#include "backlogcache.h"
+
+#include <QDebug>
+
+BacklogCache::BacklogCache(int maxMessagesPerBuffer, qint64 maxMemory)
+    : _maxMessagesPerBuffer(qMax(maxMessagesPerBuffer, 0)),
+    _maxMemory(qMax(maxMemory, Q_INT64_C(0)))
+{
+}
+
+
+void BacklogCache::addMessages(const MessageList &messages)
+{
+    if (!isEnabled())
+        return;
+
+    foreach(const Message &msg, messages) {
+        if (!msg.msgId().isValid())
+            continue;
+
+        BufferCache &bufferCache = _buffers[msg.bufferId()];
+        if (bufferCache.messages.capacity() != _maxMessagesPerBuffer)
+            bufferCache.messages.setCapacity(_maxMessagesPerBuffer);
+
+        // we rely on messages arriving in storage order; anything else would break the
+        // invariant that the cache holds a contiguous range of the newest messages
+        if (!bufferCache.messages.isEmpty() && bufferCache.messages.last().msgId() >= msg.msgId()) {
+            qWarning() << "BacklogCache::addMessages(): received message out of order for buffer" << msg.bufferId();
+            removeBuffer(msg.bufferId());
+            continue;
+        }
+
+        if (bufferCache.messages.isFull())
+            removeOldestMessage(bufferCache);
+        bufferCache.messages.append(msg);
+        bufferCache.lastUsed = ++_usageCounter;
+        _memoryUsage += messageSize(msg);
+    }
+
+    if (_memoryUsage > _maxMemory)
+        shrink();
+}
+
+
+void BacklogCache::removeBuffer(BufferId bufferId)
+{
+    auto it = _buffers.find(bufferId);
+    if (it == _buffers.end())
+        return;
+
+    while (!it->messages.isEmpty())
+        removeOldestMessage(*it);
+    _buffers.erase(it);
+}
+
+
+void BacklogCache::clear()
+{
+    _buffers.clear();
+    _memoryUsage = 0;
+}
+
+
+MessageList BacklogCache::requestMsgs(BufferId bufferId, MsgId first, MsgId &last, int &limit,
+                                      Message::Types type, Message::Flags flags, bool &complete) const
+{
+    MessageList messages;
+    complete = false;
+
+    if (limit == 0) {
+        complete = true;
+        return messages;
+    }
+
+    auto it = _buffers.constFind(bufferId);
+    if (it == _buffers.constEnd() || it->messages.isEmpty())
+        return messages;
+
+    const QContiguousCache<Message> &cache = it->messages;
+    MsgId oldest = cache.first().msgId();
+    if (last != -1 && last <= oldest)
+        return messages; // requested range is older than anything we have
+
+    for (int i = cache.lastIndex(); i >= cache.firstIndex(); --i) {
+        const Message &msg = cache.at(i);
+        if (last != -1 && msg.msgId() >= last)
+            continue;
+        if (first != -1 && msg.msgId() < first)
+            break;
+        // same semantics as the *_filtered queries of the storage backends
+        if (!(type & msg.type()))
+            continue;
+        if (flags && !(flags & msg.flags()))
+            continue;
+
+        messages << msg;
+        if (limit != -1 && messages.count() >= limit)
+            break;
+    }
+
+    if ((limit != -1 && messages.count() >= limit) || (first != -1 && first >= oldest)) {
+        complete = true;
+        return messages;
+    }
+
+    // everything from oldest on has been served; the rest must come from storage
+    last = oldest;
+    if (limit != -1)
+        limit -= messages.count();
+    return messages;
+}
+
+
+qint64 BacklogCache::messageSize(const Message &message)
+{
+    // Rough estimate; the buffer name is shared between all messages of a buffer
+    return sizeof(Message)
+           + (message.contents().size() + message.sender().size() + message.senderPrefixes().size()
+              + message.realName().size() + message.avatarUrl().size()) * sizeof(QChar);
+}
+
+
+void BacklogCache::removeOldestMessage(BufferCache &bufferCache)
+{
+    _memoryUsage -= messageSize(bufferCache.messages.first());
+    bufferCache.messages.removeFirst();
+}
+
+
+void BacklogCache::shrink()
+{
+    // Free a bit more than strictly needed, so we don't have to do this for every new message
+    qint64 target = _maxMemory - _maxMemory / 8;
+
+    while (_memoryUsage > target && !_buffers.isEmpty()) {
+        auto lru = _buffers.begin();
+        for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+            if (it->lastUsed < lru->lastUsed)
+                lru = it;
+        }
+
+        while (_memoryUsage > target && !lru->messages.isEmpty())
+            removeOldestMessage(*lru);
+        if (lru->messages.isEmpty())
+            _buffers.erase(lru);
+    }
+}
@@ -0,0 +1,107 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <QContiguousCache>
+#include <QHash>
+
+#include "message.h"
+#include "types.h"
+
+/**
+ * In-memory cache of the newest messages of each buffer of a session.
+ *
+ * The cache is fed from the live message stream after messages have been stored, so for every
+ * buffer it holds a contiguous range of the newest messages, i.e. every stored message with an
+ * id greater than or equal to the oldest cached one is in the cache. This allows serving the
+ * common "last N messages" backlog requests without touching the storage backend; requests
+ * reaching further back are completed from storage.
+ *
+ * The cache is bounded both per buffer (number of messages) and per session (approximate memory
+ * usage). When the memory limit is exceeded, the oldest messages of the least recently active
+ * buffers are dropped first.
+ *
+ * @note This class is not threadsafe; it is meant to be used from the session thread only.
+ */
+class BacklogCache
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param maxMessagesPerBuffer Maximum number of messages kept per buffer; 0 disables the cache
+     * @param maxMemory            Approximate upper bound for the memory used by all buffers, in bytes
+     */
+    BacklogCache(int maxMessagesPerBuffer, qint64 maxMemory);
+
+    inline bool isEnabled() const { return _maxMessagesPerBuffer > 0 && _maxMemory > 0; }
+    inline qint64 memoryUsage() const { return _memoryUsage; }
+
+    /**
+     * Adds stored messages to the cache.
+     *
+     * Messages must have a valid MsgId, and must be given in the order they were stored.
+     */
+    void addMessages(const MessageList &messages);
+
+    //! Drops all cached messages of the given buffer
+    void removeBuffer(BufferId bufferId);
+
+    //! Drops all cached messages
+    void clear();
+
+    /**
+     * Serves a backlog request from the cache, as far as possible.
+     *
+     * The semantics of the parameters and of the returned list (newest messages first) match
+     * Storage::requestMsgsFiltered(). If the cache cannot answer the request completely, the
+     * messages it can provide are returned and @a last and @a limit are adjusted to describe
+     * the remaining, older range that must be fetched from storage.
+     *
+     * @param[in]     bufferId  The buffer
+     * @param[in]     first     if != -1, only messages with a MsgId >= first are requested
+     * @param[in,out] last      if != -1, only messages with a MsgId < last are requested
+     * @param[in,out] limit     if != -1, the maximum number of messages requested
+     * @param[in]     type      The Message::Types to return
+     * @param[in]     flags     The Message::Flags to filter for (0 matches every message)
+     * @param[out]    complete  Set to true if no storage lookup is needed to complete the request
+     * @return The cached messages matching the request, newest first
+     */
+    MessageList requestMsgs(BufferId bufferId, MsgId first, MsgId &last, int &limit,
+                            Message::Types type, Message::Flags flags, bool &complete) const;
+
+private:
+    struct BufferCache {
+        QContiguousCache<Message> messages;
+        quint64 lastUsed{0};
+    };
+
+    static qint64 messageSize(const Message &message);
+    void removeOldestMessage(BufferCache &bufferCache);
+    void shrink();
+
+    int _maxMessagesPerBuffer;
+    qint64 _maxMemory;
+    qint64 _memoryUsage{0};
+    quint64 _usageCounter{0};
+    QHash<BufferId, BufferCache> _buffers;
+};
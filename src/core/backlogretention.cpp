@@ -0,0 +1,205 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "backlogretention.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+#include "core.h"
+#include "logmessage.h"
+#include "quassel.h"
+
+// Number of messages deleted per batch, and the time the storage is left alone in between
+static const int batchSize = 500;
+static const int batchInterval = 50;
+
+BacklogRetention::BacklogRetention()
+    : QObject(),
+    _maxAge(Quassel::optionValue("backlog-max-age").toInt()),
+    _maxBufferMessages(Quassel::optionValue("backlog-max-messages").toInt()),
+    _maxUserSize(Quassel::optionValue("backlog-max-size").toLongLong() * 1024 * 1024),
+    _archiveDir(Quassel::optionValue("backlog-archive-dir")),
+    _passTimer(new QTimer(this)),
+    _batchTimer(new QTimer(this))
+{
+    if (!isEnabled())
+        return;
+
+    if (!_archiveDir.isEmpty() && !QDir().mkpath(_archiveDir)) {
+        quWarning() << qPrintable(tr("Cannot create backlog archive directory %1, disabling backlog retention!").arg(_archiveDir));
+        _maxAge = _maxBufferMessages = 0;
+        _maxUserSize = 0;
+        return;
+    }
+
+    connect(_passTimer, SIGNAL(timeout()), SLOT(startPass()));
+    _batchTimer->setSingleShot(true);
+    _batchTimer->setInterval(batchInterval);
+    connect(_batchTimer, SIGNAL(timeout()), SLOT(processBatch()));
+
+    // The timers move along with us, but have to be started from within the thread
+    moveToThread(&_thread);
+    _thread.start();
+    QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+}
+
+
+BacklogRetention::~BacklogRetention()
+{
+    if (_thread.isRunning()) {
+        QMetaObject::invokeMethod(this, "stop", Qt::BlockingQueuedConnection);
+        _thread.quit();
+        _thread.wait();
+    }
+}
+
+
+void BacklogRetention::start()
+{
+    _passTimer->start(60 * 60 * 1000); // 1 hour
+
+    // Don't delay the core startup
+    QTimer::singleShot(60 * 1000, this, SLOT(startPass()));
+}
+
+
+void BacklogRetention::stop()
+{
+    _passTimer->stop();
+    _batchTimer->stop();
+    _pendingUsers.clear();
+    _jobs.clear();
+}
+
+
+void BacklogRetention::startPass()
+{
+    if (!_pendingUsers.isEmpty() || !_jobs.isEmpty())
+        return; // previous pass still running
+
+    _passStart = QDateTime::currentDateTime();
+    _deletedCount = 0;
+    foreach(UserId user, Core::getAllAuthUserNames().keys()) {
+        _pendingUsers.enqueue(user);
+    }
+    _batchTimer->start();
+}
+
+
+void BacklogRetention::checkUser(UserId user)
+{
+    QDateTime before;
+    if (_maxAge > 0)
+        before = QDateTime::currentDateTime().addDays(-_maxAge);
+
+    MsgId userLast;
+    if (_maxUserSize > 0)
+        userLast = Core::oversizedMsgId(user, _maxUserSize);
+
+    foreach(const BufferInfo &bufferInfo, Core::requestBuffers(user)) {
+        MsgId last = Core::expiredMsgId(user, bufferInfo.bufferId(), before, _maxBufferMessages);
+        if (userLast > last)
+            last = userLast;
+        if (last.isValid())
+            _jobs.enqueue({user, bufferInfo.bufferId(), last});
+    }
+}
+
+
+void BacklogRetention::processBatch()
+{
+    if (_jobs.isEmpty()) {
+        if (_pendingUsers.isEmpty()) {
+            if (_deletedCount > 0) {
+                quInfo() << qPrintable(tr("Backlog retention: deleted %1 messages in %2 seconds")
+                                       .arg(_deletedCount).arg(_passStart.secsTo(QDateTime::currentDateTime())));
+            }
+            return;
+        }
+        checkUser(_pendingUsers.dequeue());
+        _batchTimer->start();
+        return;
+    }
+
+    // Messages are deleted from the newest expired one downwards; the batch is fetched first, so
+    // it can be archived before it's gone
+    PruneJob &job = _jobs.head();
+    QList<Message> msgs = Core::requestMsgs(job.user, job.bufferId, -1, job.last.toQint64() + 1, batchSize);
+    if (msgs.isEmpty()) {
+        _jobs.dequeue();
+        _batchTimer->start();
+        return;
+    }
+
+    if (!_archiveDir.isEmpty() && !archive(job.user, job.bufferId, msgs)) {
+        quWarning() << qPrintable(tr("Backlog retention: cannot write to archive directory %1, stopping!").arg(_archiveDir));
+        _pendingUsers.clear();
+        _jobs.clear();
+        return;
+    }
+
+    // requestMsgs() returns the newest messages first
+    MsgId first = msgs.last().msgId();
+    int deleted = Core::deleteMsgs(job.user, job.bufferId, first, job.last.toQint64() + 1);
+    if (deleted < 0) {
+        quWarning() << qPrintable(tr("Backlog retention: deleting messages of buffer %1 failed!").arg(job.bufferId.toInt()));
+        _jobs.dequeue();
+    }
+    else {
+        _deletedCount += deleted;
+        emit backlogPruned(job.user, job.bufferId);
+        if (msgs.count() < batchSize)
+            _jobs.dequeue();
+        else
+            job.last = first.toQint64() - 1;
+    }
+    _batchTimer->start();
+}
+
+
+bool BacklogRetention::archive(UserId user, BufferId bufferId, const QList<Message> &msgs)
+{
+    QDir dir(_archiveDir);
+    QString userDir = QString::number(user.toInt());
+    if (!dir.mkpath(userDir))
+        return false;
+
+    QByteArray lines;
+    for (int i = msgs.count() - 1; i >= 0; i--) {
+        const Message &msg = msgs.at(i);
+        lines += QString("%1\t%2\t%3\t%4\t%5\n")
+                 .arg(msg.msgId().toQint64())
+                 .arg(msg.timestamp().toUTC().toString(Qt::ISODate))
+                 .arg(msg.type())
+                 .arg(msg.sender(), msg.contents())
+                 .toUtf8();
+    }
+
+    QFile file(dir.filePath(QString("%1/%2.qz").arg(userDir).arg(bufferId.toInt())));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+
+    QDataStream out(&file);
+    out << qCompress(lines);
+    file.close();
+    return out.status() == QDataStream::Ok && file.error() == QFile::NoError;
+}
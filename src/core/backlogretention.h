@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QThread>
+#include <QTimer>
+
+#include "message.h"
+#include "types.h"
+
+/**
+ * Deletes backlog exceeding the configured retention limits.
+ *
+ * Limits can be given for the age of messages, the number of messages per buffer and the size of
+ * each user's backlog (see the backlog-max-* command line options). Once per hour, the backlog of
+ * every user is checked against these limits; expired messages are then deleted in small batches,
+ * so the storage backend is never locked for long. All of this happens in a thread of its own, so
+ * neither the Core nor the sessions have to wait for it.
+ *
+ * If an archive directory is configured, deleted messages are appended to a per-buffer archive
+ * file <archive dir>/<user id>/<buffer id>.qz first. The file is a sequence of QByteArrays as
+ * written by QDataStream, each holding a qCompress()ed batch of tab-separated log lines
+ * (message id, UTC timestamp, type, sender, contents).
+ */
+class BacklogRetention : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! The object lives in its own thread, so it can't have a parent
+    BacklogRetention();
+    ~BacklogRetention() override;
+
+    inline bool isEnabled() const { return _maxAge > 0 || _maxBufferMessages > 0 || _maxUserSize > 0; }
+
+signals:
+    //! Emitted after messages have been deleted from a buffer
+    void backlogPruned(UserId user, BufferId bufferId);
+
+private slots:
+    void start();
+    void stop();
+    void startPass();
+    void processBatch();
+
+private:
+    //! Delete all messages of a buffer with an id up to and including last
+    struct PruneJob {
+        UserId user;
+        BufferId bufferId;
+        MsgId last;
+    };
+
+    void checkUser(UserId user);
+    bool archive(UserId user, BufferId bufferId, const QList<Message> &msgs);
+
+    int _maxAge;                //!< in days
+    int _maxBufferMessages;
+    qint64 _maxUserSize;        //!< in bytes
+    QString _archiveDir;
+
+    QThread _thread;
+    QTimer *_passTimer;
+    QTimer *_batchTimer;
+    QDateTime _passStart;
+    QQueue<UserId> _pendingUsers;
+    QQueue<PruneJob> _jobs;
+    int _deletedCount{0};
+};
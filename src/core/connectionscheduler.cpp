@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "connectionscheduler.h"
+
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include "corenetwork.h"
+#include "logmessage.h"
+#include "quassel.h"
+
+// Interval for logging the queue length while attempts are waiting
+static const int reportInterval = 30 * 1000;
+
+ConnectionScheduler::ConnectionScheduler(QObject *parent)
+    : QObject(parent),
+    _globalInterval(qMax(0, Quassel::optionValue("connect-interval").toInt())),
+    _hostInterval(qMax(0, Quassel::optionValue("connect-host-interval").toInt()) * 1000)
+{
+    _timer.setSingleShot(true);
+    connect(&_timer, SIGNAL(timeout()), SLOT(processQueue()));
+}
+
+
+int ConnectionScheduler::enqueue(CoreNetwork *network, UserId user, const QString &host)
+{
+    QMutexLocker locker(&_mutex);
+    for (int i = 0; i < _queue.count(); ++i) {
+        if (_queue[i].network == network) {
+            _queue[i].host = host.toLower(); // may have cycled to another server meanwhile
+            return i;
+        }
+    }
+    Entry entry = { network, user, host.toLower(), QDateTime::currentMSecsSinceEpoch() };
+    _queue.append(entry);
+    QMetaObject::invokeMethod(this, "processQueue", Qt::QueuedConnection);
+    return _queue.count() - 1;
+}
+
+
+void ConnectionScheduler::cancel(CoreNetwork *network)
+{
+    QMutexLocker locker(&_mutex);
+    for (int i = 0; i < _queue.count(); ++i) {
+        if (_queue[i].network == network) {
+            _queue.removeAt(i);
+            return;
+        }
+    }
+}
+
+
+void ConnectionScheduler::setUserActive(UserId user, bool active)
+{
+    QMutexLocker locker(&_mutex);
+    if (active)
+        _activeUsers.insert(user);
+    else
+        _activeUsers.remove(user);
+}
+
+
+QVariantMap ConnectionScheduler::queueState() const
+{
+    QMutexLocker locker(&_mutex);
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVariantList entries;
+    foreach(const Entry &entry, _queue) {
+        QVariantMap map;
+        map["user"] = entry.user.toInt();
+        map["host"] = entry.host;
+        map["waiting"] = now - entry.queuedAt;
+        map["prioritized"] = _activeUsers.contains(entry.user);
+        entries << map;
+    }
+    QVariantMap state;
+    state["queued"] = _queue.count();
+    state["entries"] = entries;
+    return state;
+}
+
+
+int ConnectionScheduler::nextEntry(qint64 now, qint64 &wait) const
+{
+    wait = _lastAttempt + _globalInterval - now;
+    if (wait > 0)
+        return -1;
+
+    int candidate = -1;
+    for (int i = 0; i < _queue.count(); ++i) {
+        const Entry &entry = _queue[i];
+        qint64 hostWait = _lastHostAttempt.value(entry.host, 0) + _hostInterval - now;
+        if (hostWait > 0) {
+            if (wait <= 0 || hostWait < wait)
+                wait = hostWait;
+            continue;
+        }
+        if (_activeUsers.contains(entry.user))
+            return i;
+        if (candidate < 0)
+            candidate = i;
+    }
+    return candidate;
+}
+
+
+void ConnectionScheduler::processQueue()
+{
+    QMutexLocker locker(&_mutex);
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    // Forget about hosts that may be connected to again anyway
+    QHash<QString, qint64>::iterator it = _lastHostAttempt.begin();
+    while (it != _lastHostAttempt.end()) {
+        if (it.value() + _hostInterval <= now)
+            it = _lastHostAttempt.erase(it);
+        else
+            ++it;
+    }
+
+    while (!_queue.isEmpty()) {
+        qint64 wait;
+        int index = nextEntry(now, wait);
+        if (index < 0) {
+            _timer.start(wait);
+            break;
+        }
+        Entry entry = _queue.takeAt(index);
+        _lastAttempt = now;
+        _lastHostAttempt[entry.host] = now;
+        // Invoked while holding the lock, so a network can't be deleted in between (see cancel())
+        QMetaObject::invokeMethod(entry.network, "startConnection", Qt::QueuedConnection);
+    }
+
+    if (!_queue.isEmpty() && now - _lastReport >= reportInterval) {
+        _lastReport = now;
+        quInfo() << qPrintable(tr("%n IRC connection attempt(s) waiting to be scheduled", "", _queue.count()));
+    }
+}
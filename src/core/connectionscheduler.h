@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "types.h"
+
+class CoreNetwork;
+
+/**
+ * Spreads outgoing IRC connection attempts over time.
+ *
+ * When the core starts or loses its uplink, every network of every user tries to (re)connect at
+ * once, which easily gets the core's address throttled or K-lined by the IRC servers. Networks
+ * therefore don't open their socket right away, but queue up here; the scheduler keeps at least
+ * --connect-interval milliseconds between two attempts overall, and --connect-host-interval seconds
+ * between two attempts to the same server host. Networks of users that currently have a client attached
+ * go first.
+ *
+ * Granted networks get their startConnection() slot invoked in their own thread. All public
+ * methods are threadsafe, as networks live in the session threads.
+ */
+class ConnectionScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    ConnectionScheduler(QObject *parent = nullptr);
+
+    //! Queue a connection attempt of the given network to host
+    /** \return The number of attempts queued before this one */
+    int enqueue(CoreNetwork *network, UserId user, const QString &host);
+
+    //! Remove a network from the queue, e.g. when the connection attempt has been aborted
+    void cancel(CoreNetwork *network);
+
+    //! Mark a user as having clients attached (or not), which prioritizes its connection attempts
+    void setUserActive(UserId user, bool active);
+
+    //! Snapshot of the queue, e.g. for diagnostics
+    /** \return A map with the overall "queued" count and an "entries" list, in queue order, of
+     *          maps holding "user", "host", "waiting" (in ms) and "prioritized"
+     */
+    QVariantMap queueState() const;
+
+private slots:
+    void processQueue();
+
+private:
+    struct Entry {
+        CoreNetwork *network;
+        UserId user;
+        QString host;
+        qint64 queuedAt;
+    };
+
+    //! Pick the next entry that may connect now; otherwise sets wait to the time until one may
+    int nextEntry(qint64 now, qint64 &wait) const;
+
+    int _globalInterval;        //!< in ms
+    int _hostInterval;          //!< in ms
+
+    mutable QMutex _mutex;
+    QList<Entry> _queue;
+    QSet<UserId> _activeUsers;
+    QHash<QString, qint64> _lastHostAttempt;
+    qint64 _lastAttempt{0};
+    qint64 _lastReport{0};
+
+    QTimer _timer;
+};
@@ -28,6 +28,7 @@
 #include "coresettings.h"
 #include "internalpeer.h"
 #include "logmessage.h"
+#include "metrics.h"
 #include "network.h"
 #include "postgresqlstorage.h"
 #include "quassel.h"
@@ -96,6 +97,8 @@ Core::~Core()
     saveState();
     qDeleteAll(_connectingClients);
     qDeleteAll(_sessions);
+    qDeleteAll(_sessionWorkers);
+    delete _backlogRetention;
     syncStorage();
     _instance = nullptr;
 }
@@ -171,6 +174,18 @@ void Core::init()
         throw ExitException{success ? EXIT_SUCCESS : EXIT_FAILURE};
     }
 
+    // Sessions rely on it even if the core is only configured later on by a client
+    _connectionScheduler = new ConnectionScheduler(this);
+
+    if (!config_from_environment) {
+        QString migrationTarget = CoreSettings().storageMigrationTarget();
+        if (!migrationTarget.isEmpty()) {
+            throw ExitException{EXIT_FAILURE,
+                                tr("A migration to the %1 storage backend has not been finished. Run the core with\n"
+                                   "--select-backend=%1 to resume it, or select the current backend to abandon it.").arg(migrationTarget)};
+        }
+    }
+
     if (!_configured) {
         if (config_from_environment) {
             try {
@@ -228,6 +243,14 @@ void Core::init()
             _identServer = new IdentServer(this);
         }
 
+        if (Quassel::isOptionSet("metrics-port") || Quassel::isOptionSet("metrics-socket")) {
+            Metrics::setEnabled(true);
+            _metricsServer = new MetricsServer(this);
+        }
+
+        _backlogRetention = new BacklogRetention();
+        connect(_backlogRetention, SIGNAL(backlogPruned(UserId, BufferId)), this, SIGNAL(backlogPruned(UserId, BufferId)));
+
         Quassel::registerReloadHandler([]() {
             // Currently, only reloading SSL certificates and the sysident cache is supported
             if (Core::instance()) {
@@ -690,6 +713,10 @@ bool Core::startListening()
         _identServer->startListening();
     }
 
+    if (_metricsServer) {
+        _metricsServer->startListening();
+    }
+
     return success;
 }
 
@@ -700,6 +727,10 @@ void Core::stopListening(const QString &reason)
         _identServer->stopListening(reason);
     }
 
+    if (_metricsServer) {
+        _metricsServer->stopListening(QString());
+    }
+
     bool wasListening = false;
     if (_server.isListening()) {
         wasListening = true;
@@ -852,11 +883,32 @@ SessionThread *Core::sessionForUser(UserId uid, bool restore)
 
     SessionThread *session = new SessionThread(uid, restore, strictIdentEnabled(), this);
     _sessions[uid] = session;
-    session->start();
+    session->start(sessionWorker());
     return session;
 }
 
 
+SessionWorker *Core::sessionWorker()
+{
+    if (_sessionWorkers.isEmpty()) {
+        int count = Quassel::optionValue("session-threads").toInt();
+        if (count <= 0)
+            count = qMax(QThread::idealThreadCount(), 1);
+        for (int i = 0; i < count; i++) {
+            _sessionWorkers << new SessionWorker();
+        }
+    }
+
+    // Sessions stay with their worker for their lifetime, so new ones go to the least busy one
+    SessionWorker *worker = _sessionWorkers.first();
+    foreach(SessionWorker *candidate, _sessionWorkers) {
+        if (candidate->sessionCount() < worker->sessionCount())
+            worker = candidate;
+    }
+    return worker;
+}
+
+
 void Core::socketError(QAbstractSocket::SocketError err, const QString &errorString)
 {
     quWarning() << QString("Socket error %1: %2").arg(err).arg(errorString);
@@ -932,12 +984,29 @@ bool Core::selectBackend(const QString &backend)
     Storage::State storageState = storage->init(settings);
     switch (storageState) {
     case Storage::IsReady:
+    {
+        // A migration may have been interrupted, possibly before it got to write a backlog checkpoint
+        auto writer = getMigrationWriter(storage.get());
+        MigrationResumption resumption = migrationResumption(backend, CoreSettings().storageMigrationTarget(),
+                                                             writer ? writer->backlogCheckpoint() : -1);
+        if (resumption != MigrationResumption::None) {
+            if (!_storage || !writer || !getMigrationReader(_storage.get())) {
+                quWarning() << qPrintable(tr("Cannot continue the interrupted migration to: %1").arg(backend));
+                return false;
+            }
+            if (resumption == MigrationResumption::Resume)
+                quWarning() << qPrintable(tr("Resuming interrupted migration to: %1").arg(backend));
+            else
+                quWarning() << qPrintable(tr("Restarting interrupted migration to: %1").arg(backend));
+            break;
+        }
         if (!saveBackendSettings(backend, settings)) {
             qCritical() << qPrintable(QString("Could not save backend settings, probably a permission problem."));
         }
         quWarning() << qPrintable(tr("Switched storage backend to: %1").arg(backend));
         quWarning() << qPrintable(tr("Backend already initialized. Skipping Migration..."));
         return true;
+    }
     case Storage::NotAvailable:
         qCritical() << qPrintable(tr("Storage backend is not available: %1").arg(backend));
         return false;
@@ -952,10 +1021,8 @@ bool Core::selectBackend(const QString &backend)
             return false;
         }
 
-        if (!saveBackendSettings(backend, settings)) {
-            qCritical() << qPrintable(QString("Could not save backend settings, probably a permission problem."));
-        }
-        quWarning() << qPrintable(tr("Switched storage backend to: %1").arg(backend));
+        // Settings are only saved once the migration has finished, as an interrupted migration
+        // needs to be resumed from the current backend
         break;
     }
 
@@ -966,13 +1033,17 @@ bool Core::selectBackend(const QString &backend)
         qDebug() << qPrintable(tr("Migrating storage backend %1 to %2...").arg(_storage->displayName(), storage->displayName()));
         _storage.reset();
         storage.reset();
-        if (reader->migrateTo(writer.get())) {
+        // Until the migration is finished, the core must not run on the old backend, as data added in the
+        // meantime wouldn't be migrated when resuming. Cleared by saveBackendSettings().
+        CoreSettings().setStorageMigrationTarget(backend);
+        if (reader->migrateTo(writer.get(), Quassel::optionValue("migration-threads").toInt())) {
             qDebug() << "Migration finished!";
             qDebug() << qPrintable(tr("Migration finished!"));
             if (!saveBackendSettings(backend, settings)) {
                 qCritical() << qPrintable(QString("Could not save backend settings, probably a permission problem."));
                 return false;
             }
+            quWarning() << qPrintable(tr("Switched storage backend to: %1").arg(backend));
             return true;
         }
         quWarning() << qPrintable(tr("Unable to migrate storage backend! (No migration writer for %1)").arg(backend));
@@ -990,12 +1061,30 @@ bool Core::selectBackend(const QString &backend)
         quWarning() << qPrintable(tr("New storage backend does not support migration: %1").arg(backend));
     }
 
+    if (!saveBackendSettings(backend, settings)) {
+        qCritical() << qPrintable(QString("Could not save backend settings, probably a permission problem."));
+    }
+
     // so we were unable to merge, but let's create a user \o/
     _storage = std::move(storage);
     createUser();
     return true;
 }
 
+Core::MigrationResumption Core::migrationResumption(const QString &backend, const QString &migrationTarget, qint64 backlogCheckpoint)
+{
+    if (backlogCheckpoint >= 0)
+        return MigrationResumption::Resume;
+
+    // The objects are transferred in a single transaction together with the first checkpoint, so without one, the
+    // backend holds nothing but its schema
+    if (!migrationTarget.isEmpty() && migrationTarget == backend)
+        return MigrationResumption::Restart;
+
+    return MigrationResumption::None;
+}
+
+
 // TODO: I am not sure if this function is implemented correctly.
 // There is currently no concept of migraiton between auth backends.
 bool Core::selectAuthenticator(const QString &backend)
@@ -1200,6 +1289,7 @@ bool Core::saveBackendSettings(const QString &backend, const QVariantMap &settin
     dbsettings["ConnectionProperties"] = settings;
     CoreSettings s = CoreSettings();
     s.setStorageSettings(dbsettings);
+    s.setStorageMigrationTarget(QString());
     return s.sync();
 }
 
@@ -38,10 +38,13 @@
 #endif
 
 #include "authenticator.h"
+#include "backlogretention.h"
 #include "bufferinfo.h"
+#include "connectionscheduler.h"
 #include "deferredptr.h"
 #include "identserver.h"
 #include "message.h"
+#include "metricsserver.h"
 #include "oidentdconfiggenerator.h"
 #include "sessionthread.h"
 #include "storage.h"
@@ -51,6 +54,7 @@ class CoreAuthHandler;
 class CoreSession;
 class InternalPeer;
 class SessionThread;
+class SessionWorker;
 class SignalProxy;
 
 struct NetworkInfo;
@@ -477,6 +481,47 @@ public:
     }
 
 
+    //! Get the newest message of a buffer that exceeds the given retention limits
+    /** \note This method is threadsafe.
+     *
+     *  \param bufferId   The buffer in question
+     *  \param before     Messages older than this are expired; an invalid QDateTime disables the limit
+     *  \param keepCount  Number of newest messages to keep in the buffer; 0 disables the limit
+     *  \return The MsgId of the newest expired message, or an invalid MsgId if nothing has expired
+     */
+    static inline MsgId expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount)
+    {
+        return instance()->_storage->expiredMsgId(user, bufferId, before, keepCount);
+    }
+
+
+    //! Get the newest message of a user that doesn't fit into the given backlog size anymore
+    /** \note This method is threadsafe.
+     *
+     *  \param maxSize  The maximum size of the user's backlog in bytes
+     *  \return The MsgId of the newest message exceeding the size, or an invalid MsgId if the backlog fits
+     */
+    static inline MsgId oversizedMsgId(UserId user, qint64 maxSize)
+    {
+        return instance()->_storage->oversizedMsgId(user, maxSize);
+    }
+
+
+    //! Permanently delete messages from a buffer
+    /** This call cannot be reverted!
+     *  \note This method is threadsafe.
+     *
+     *  \param bufferId The buffer to delete messages from
+     *  \param first    Delete only messages with a MsgId >= first
+     *  \param last     Delete only messages with a MsgId < last
+     *  \return The number of deleted messages, or -1 on error
+     */
+    static inline int deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last)
+    {
+        return instance()->_storage->deleteMsgs(user, bufferId, first, last);
+    }
+
+
     //! Request a list of all buffers known to a user.
     /** This method is used to get a list of all buffers we have stored a backlog from.
      *  \note This method is threadsafe.
@@ -564,6 +609,13 @@ public:
         return instance()->_storage->getAuthUserName(user);
     }
 
+    //! Fetch all authusernames
+    /** \return      Map of all current UserIds to permitted idents
+     */
+    static inline QMap<UserId, QString> getAllAuthUserNames() {
+        return instance()->_storage->getAllAuthUserNames();
+    }
+
     //! Get a usable sysident for the given user in oidentd-strict mode
     /** \param user    The user to retrieve the sysident for
      *  \return The authusername
@@ -692,10 +744,27 @@ public:
 
     static QString setup(const QString &adminUser, const QString &adminPassword, const QString &backend, const QVariantMap &setupData, const QString &authenticator, const QVariantMap &authSetupMap);
 
+    //! What to do about a migration to an already initialized storage backend
+    enum class MigrationResumption {
+        None,    ///< No migration to the backend is pending, so just switch to it
+        Restart, ///< Interrupted before any backlog was transferred; the objects are transferred again
+        Resume   ///< Interrupted while transferring the backlog; continue after the checkpoint
+    };
+
+    /**
+     * Decides how to continue a migration to an already initialized storage backend
+     *
+     * @param backend           The backend selected
+     * @param migrationTarget   The backend a migration was started to, if any (see CoreSettings::storageMigrationTarget())
+     * @param backlogCheckpoint The backend's backlog checkpoint, or -1 if it has none
+     */
+    static MigrationResumption migrationResumption(const QString &backend, const QString &migrationTarget, qint64 backlogCheckpoint);
+
     static inline QTimer *syncTimer() { return &instance()->_storageSyncTimer; }
 
     inline OidentdConfigGenerator *oidentdConfigGenerator() const { return _oidentdConfigGenerator; }
     inline IdentServer *identServer() const { return _identServer; }
+    inline ConnectionScheduler *connectionScheduler() const { return _connectionScheduler; }
 
     static const int AddClientEventId;
 
@@ -712,6 +781,9 @@ signals:
     //! Emitted when a fatal error was encountered during async initialization
     void exitRequested(int exitCode, const QString &reason);
 
+    //! Emitted after backlog retention has deleted messages from a buffer
+    void backlogPruned(UserId user, BufferId bufferId);
+
 public slots:
     void initAsync();
 
@@ -757,6 +829,7 @@ private slots:
 
 private:
     SessionThread *sessionForUser(UserId userId, bool restoreState = false);
+    SessionWorker *sessionWorker();
     void addClientHelper(RemotePeer *peer, UserId uid);
     //void processCoreSetup(QTcpSocket *socket, QVariantMap &msg);
     QString setupCoreForInternalUsage();
@@ -792,6 +865,7 @@ private:
     static Core *_instance;
     QSet<CoreAuthHandler *> _connectingClients;
     QHash<UserId, SessionThread *> _sessions;
+    QList<SessionWorker *> _sessionWorkers;
     DeferredSharedPtr<Storage>       _storage;        ///< Active storage backend
     DeferredSharedPtr<Authenticator> _authenticator;  ///< Active authenticator
     QMap<UserId, QString> _authUserNames;
@@ -813,6 +887,12 @@ private:
 
     IdentServer *_identServer {nullptr};
 
+    BacklogRetention *_backlogRetention {nullptr};
+
+    ConnectionScheduler *_connectionScheduler {nullptr};
+
+    MetricsServer *_metricsServer {nullptr};
+
     bool _initialized{false};
     bool _configured{false};
 
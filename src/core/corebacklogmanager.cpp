@@ -32,11 +32,33 @@ CoreBacklogManager::CoreBacklogManager(CoreSession *coreSession)
 }
 
 
+QList<Message> CoreBacklogManager::requestMsgs(BufferId bufferId, MsgId first, MsgId last, int limit)
+{
+    bool complete;
+    QList<Message> msgList = coreSession()->backlogCache()->requestMsgs(bufferId, first, last, limit,
+                                                                         Message::Types{-1}, Message::Flags{0}, complete);
+    if (!complete)
+        msgList << Core::requestMsgs(coreSession()->user(), bufferId, first, last, limit);
+    return msgList;
+}
+
+
+QList<Message> CoreBacklogManager::requestMsgsFiltered(BufferId bufferId, MsgId first, MsgId last, int limit,
+                                                       Message::Types type, Message::Flags flags)
+{
+    bool complete;
+    QList<Message> msgList = coreSession()->backlogCache()->requestMsgs(bufferId, first, last, limit, type, flags, complete);
+    if (!complete)
+        msgList << Core::requestMsgsFiltered(coreSession()->user(), bufferId, first, last, limit, type, flags);
+    return msgList;
+}
+
+
 QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
     QVariantList backlog;
     QList<Message> msgList;
-    msgList = Core::requestMsgs(coreSession()->user(), bufferId, first, last, limit);
+    msgList = requestMsgs(bufferId, first, last, limit);
 
     QList<Message>::const_iterator msgIter = msgList.constBegin();
     QList<Message>::const_iterator msgListEnd = msgList.constEnd();
@@ -64,7 +86,7 @@ QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first,
         // only fetch additional messages if they continue seemlessly
         // that is, if the list of messages is not truncated by the limit
         if (last == oldestMessage) {
-            msgList = Core::requestMsgs(coreSession()->user(), bufferId, -1, last, additional);
+            msgList = requestMsgs(bufferId, -1, last, additional);
             msgIter = msgList.constBegin();
             msgListEnd = msgList.constEnd();
             while (msgIter != msgListEnd) {
@@ -82,7 +104,7 @@ QVariantList CoreBacklogManager::requestBacklogFiltered(BufferId bufferId, MsgId
 {
     QVariantList backlog;
     QList<Message> msgList;
-    msgList = Core::requestMsgsFiltered(coreSession()->user(), bufferId, first, last, limit, Message::Types{type}, Message::Flags{flags});
+    msgList = requestMsgsFiltered(bufferId, first, last, limit, Message::Types{type}, Message::Flags{flags});
 
     QList<Message>::const_iterator msgIter = msgList.constBegin();
     QList<Message>::const_iterator msgListEnd = msgList.constEnd();
@@ -110,7 +132,7 @@ QVariantList CoreBacklogManager::requestBacklogFiltered(BufferId bufferId, MsgId
         // only fetch additional messages if they continue seemlessly
         // that is, if the list of messages is not truncated by the limit
         if (last == oldestMessage) {
-            msgList = Core::requestMsgsFiltered(coreSession()->user(), bufferId, -1, last, additional, Message::Types{type}, Message::Flags{flags});
+            msgList = requestMsgsFiltered(bufferId, -1, last, additional, Message::Types{type}, Message::Flags{flags});
             msgIter = msgList.constBegin();
             msgListEnd = msgList.constEnd();
             while (msgIter != msgListEnd) {
@@ -44,6 +44,11 @@ public slots:
                                            int type = -1, int flags = -1) override;
 
 private:
+    //! Request messages of a buffer, serving them from the session's BacklogCache if possible
+    QList<Message> requestMsgs(BufferId bufferId, MsgId first, MsgId last, int limit);
+    QList<Message> requestMsgsFiltered(BufferId bufferId, MsgId first, MsgId last, int limit,
+                                       Message::Types type, Message::Flags flags);
+
     CoreSession *_coreSession;
 };
 
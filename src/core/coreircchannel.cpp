@@ -58,6 +58,26 @@ CoreIrcChannel::~CoreIrcChannel()
 }
 
 
+void CoreIrcChannel::addPendingNames(const QStringList &nicks, const QStringList &modes)
+{
+    _pendingNicks << nicks;
+    _pendingModes << modes;
+}
+
+
+void CoreIrcChannel::joinPendingNames()
+{
+    if (_pendingNicks.isEmpty())
+        return;
+
+    // One sync for the whole channel instead of one per reply line
+    QStringList nicks, modes;
+    nicks.swap(_pendingNicks);
+    modes.swap(_pendingModes);
+    joinIrcUsers(nicks, modes);
+}
+
+
 #ifdef HAVE_QCA2
 Cipher *CoreIrcChannel::cipher() const
 {
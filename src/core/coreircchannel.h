@@ -46,9 +46,18 @@ public:
     inline bool receivedWelcomeMsg() const { return _receivedWelcomeMsg; }
     inline void setReceivedWelcomeMsg() { _receivedWelcomeMsg = true; }
 
+    //! Collect users from a NAMES reply, to be joined at once when the reply is complete
+    void addPendingNames(const QStringList &nicks, const QStringList &modes);
+
+    //! Join the users collected by addPendingNames() (on RPL_ENDOFNAMES)
+    void joinPendingNames();
+
 private:
     bool _receivedWelcomeMsg;
 
+    QStringList _pendingNicks;
+    QStringList _pendingModes;
+
 #ifdef HAVE_QCA2
     mutable Cipher *_cipher;
 #endif
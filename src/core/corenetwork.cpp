@@ -18,20 +18,31 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
  ***************************************************************************/
 
+#include <random>
+
+#include <QElapsedTimer>
 #include <QHostInfo>
 
 #include "corenetwork.h"
 
+#include "connectionscheduler.h"
 #include "core.h"
 #include "coreidentity.h"
 #include "corenetworkconfig.h"
 #include "coresession.h"
 #include "coreuserinputhandler.h"
+#include "metrics.h"
 #include "networkevent.h"
 
 // IRCv3 capabilities
 #include "irccap.h"
 
+// Upper bound for the exponential reconnect backoff, unless the configured interval is even longer
+static const qint64 maxAutoReconnectDelay = 15 * 60 * 1000;
+
+// Time (in ms) a network may spend processing received lines before other networks of the session get their turn
+static const qint64 socketReadTimeSlice = 10;
+
 INIT_SYNCABLE_OBJECT(CoreNetwork)
 CoreNetwork::CoreNetwork(const NetworkId &networkid, CoreSession *session)
     : Network(networkid, session),
@@ -46,6 +57,9 @@ CoreNetwork::CoreNetwork(const NetworkId &networkid, CoreSession *session)
 
     _requestedUserModes('-')
 {
+    _metricsLabels = Metrics::label("user", QString::number(userId().toInt())) + ","
+                     + Metrics::label("network", QString::number(networkid.toInt()));
+
     _autoReconnectTimer.setSingleShot(true);
     connect(&_socketCloseTimer, SIGNAL(timeout()), this, SLOT(socketCloseTimeout()));
 
@@ -132,8 +146,23 @@ CoreNetwork::~CoreNetwork()
                           "(user ID " << userId() << ")";
         }
     }
+    if (Core::instance()->connectionScheduler())
+        Core::instance()->connectionScheduler()->cancel(this);
     disconnect(&socket, 0, this, 0); // this keeps the socket from triggering events during clean up
     delete _userInputHandler;
+    Metrics::remove(_metricsLabels);
+}
+
+
+QList<IrcUser *> CoreNetwork::queryIrcUsers() const
+{
+    QList<IrcUser *> users;
+    foreach(const BufferInfo &bufferInfo, coreSession()->queryBuffers(networkId())) {
+        IrcUser *ircUser = this->ircUser(bufferInfo.bufferName());
+        if (ircUser)
+            users << ircUser;
+    }
+    return users;
 }
 
 
@@ -152,6 +181,10 @@ bool CoreNetwork::forceDisconnect(int msecs)
 
 QString CoreNetwork::channelDecode(const QString &bufferName, const QByteArray &string) const
 {
+    // No need to look up the channel if its codec doesn't make a difference
+    if (isCodecIndependent(string))
+        return QString::fromLatin1(string);
+
     if (!bufferName.isEmpty()) {
         IrcChannel *channel = ircChannel(bufferName);
         if (channel)
@@ -163,6 +196,9 @@ QString CoreNetwork::channelDecode(const QString &bufferName, const QByteArray &
 
 QString CoreNetwork::userDecode(const QString &userNick, const QByteArray &string) const
 {
+    if (isCodecIndependent(string))
+        return QString::fromLatin1(string);
+
     IrcUser *user = ircUser(userNick);
     if (user)
         return user->decodeString(string);
@@ -192,9 +228,8 @@ QByteArray CoreNetwork::userEncode(const QString &userNick, const QString &strin
 
 void CoreNetwork::connectToIrc(bool reconnecting)
 {
-    if (Core::instance()->identServer()) {
-        _socketId = Core::instance()->identServer()->addWaitingSocket();
-    }
+    if (!reconnecting)
+        _autoReconnectAttempts = 0;
 
     if (!reconnecting && useAutoReconnect() && _autoReconnectCount == 0) {
         _autoReconnectTimer.setInterval(autoReconnectInterval() * 1000);
@@ -240,6 +275,28 @@ void CoreNetwork::connectToIrc(bool reconnecting)
         _lastUsedServerIndex = 0;
     }
 
+    Server server = usedServer();
+    ConnectionScheduler *scheduler = Core::instance()->connectionScheduler();
+    if (!scheduler) {
+        startConnection();
+        return;
+    }
+    // Don't hit the servers with all networks at once, e.g. on core startup
+    int waiting = scheduler->enqueue(this, userId(), server.useProxy ? server.proxyHost : server.host);
+    if (waiting > 0)
+        displayStatusMsg(tr("Waiting to connect to %1:%2...").arg(server.host).arg(server.port));
+}
+
+
+void CoreNetwork::startConnection()
+{
+    if (socket.state() != QAbstractSocket::UnconnectedState || serverList().isEmpty())
+        return;
+
+    if (Core::instance()->identServer()) {
+        _socketId = Core::instance()->identServer()->addWaitingSocket();
+    }
+
     Server server = usedServer();
     displayStatusMsg(tr("Connecting to %1:%2...").arg(server.host).arg(server.port));
     displayMsg(Message::Server, BufferInfo::StatusBuffer, "", tr("Connecting to %1:%2...").arg(server.host).arg(server.port));
@@ -292,8 +349,11 @@ void CoreNetwork::disconnectFromIrc(bool requested, const QString &reason, bool
         _autoReconnectTimer.stop();
         _autoReconnectCount = 0; // prohibiting auto reconnect
     }
+    if (Core::instance()->connectionScheduler())
+        Core::instance()->connectionScheduler()->cancel(this);
     disablePingTimeout();
     _msgQueue.clear();
+    updateQueueMetrics();
 
     IrcUser *me_ = me();
     if (me_) {
@@ -347,6 +407,7 @@ void CoreNetwork::putRawLine(const QByteArray s, const bool prepend)
             // Add to back, waiting in order
             _msgQueue.append(s);
         }
+        updateQueueMetrics();
     }
 }
 
@@ -510,7 +571,24 @@ void CoreNetwork::setMyNick(const QString &mynick)
 
 void CoreNetwork::socketHasData()
 {
+    _socketReadScheduled = false;
+
+    // Events are processed synchronously, so anything logged while handling these lines can be traced back to this read
+    if (Metrics::isEnabled())
+        _socketReadTime = Metrics::monotonicTime();
+
+    QElapsedTimer timeSlice;
+    timeSlice.start();
     while (socket.canReadLine()) {
+        // All networks of a session share its thread, so don't let a flood (like a netsplit) on this one stall the
+        // others. The remaining lines stay in the socket buffer, so they are still processed in order.
+        if (timeSlice.elapsed() >= socketReadTimeSlice) {
+            if (!_socketReadScheduled) {
+                _socketReadScheduled = true;
+                QMetaObject::invokeMethod(this, "socketHasData", Qt::QueuedConnection);
+            }
+            break;
+        }
         QByteArray s = socket.readLine();
         if (s.endsWith("\r\n"))
             s.chop(2);
@@ -520,6 +598,8 @@ void CoreNetwork::socketHasData()
         event->setTimestamp(QDateTime::currentDateTimeUtc());
         emit newEvent(event);
     }
+
+    _socketReadTime = 0;
 }
 
 
@@ -607,6 +687,7 @@ void CoreNetwork::socketDisconnected()
 {
     disablePingTimeout();
     _msgQueue.clear();
+    updateQueueMetrics();
 
     _autoWhoCycleTimer.stop();
     _autoWhoTimer.stop();
@@ -638,7 +719,7 @@ void CoreNetwork::socketDisconnected()
         if (_autoReconnectCount == -1 || _autoReconnectCount == autoReconnectRetries())
             doAutoReconnect();  // first try is immediate
         else
-            _autoReconnectTimer.start();
+            _autoReconnectTimer.start(autoReconnectDelay());
     }
 }
 
@@ -683,6 +764,7 @@ void CoreNetwork::networkInitialized()
         // reset counter
         _autoReconnectCount = unlimitedReconnectRetries() ? -1 : autoReconnectRetries();
     }
+    _autoReconnectAttempts = 0;
 
     // restore away state
     QString awayMsg = Core::awayMessage(userId(), networkId());
@@ -918,10 +1000,27 @@ void CoreNetwork::doAutoReconnect()
     }
     if (_autoReconnectCount > 0 || _autoReconnectCount == -1)
         _autoReconnectCount--;  // -2 means we delay the next reconnect
+    _autoReconnectAttempts++;
     connectToIrc(true);
 }
 
 
+int CoreNetwork::autoReconnectDelay() const
+{
+    // Double the configured interval for every further failed attempt, so a network that's down
+    // isn't hammered forever. The jitter (+/- 25%) keeps networks that lost their connection at the
+    // same time from retrying in lockstep.
+    qint64 interval = qint64(autoReconnectInterval()) * 1000;
+    qint64 delay = interval << qBound(0, _autoReconnectAttempts - 1, 10);
+    delay = qMin(delay, qMax(interval, maxAutoReconnectDelay));
+
+    // qrand() is seeded per thread, which the session threads never do, so they'd all get the same jitter
+    thread_local std::mt19937 generator{std::random_device{}()};
+    std::uniform_int_distribution<int> jitter(75, 125);
+    return int(delay * jitter(generator) / 100);
+}
+
+
 void CoreNetwork::sendPing()
 {
     qint64 now = QDateTime::currentDateTime().toMSecsSinceEpoch();
@@ -1455,6 +1554,14 @@ void CoreNetwork::fillBucketAndProcessQueue()
     while (_msgQueue.size() > 0 && _tokenBucket > 0) {
         writeToSocket(_msgQueue.takeFirst());
     }
+    updateQueueMetrics();
+}
+
+
+void CoreNetwork::updateQueueMetrics()
+{
+    if (Metrics::isEnabled())
+        Metrics::set("quassel_network_send_queue_length", _metricsLabels, _msgQueue.size());
 }
 
 
@@ -94,6 +94,12 @@ public:
 
     inline UserId userId() const { return _coreSession->user(); }
 
+    //! Label set identifying this network in the metrics (see Metrics)
+    inline const QString &metricsLabels() const { return _metricsLabels; }
+
+    //! While lines read from the socket are being processed, the Metrics::monotonicTime() they were read at; 0 otherwise
+    inline qint64 socketReadTime() const { return _socketReadTime; }
+
     inline QAbstractSocket::SocketState socketState() const { return socket.state(); }
     inline bool socketConnected() const { return socket.state() == QAbstractSocket::ConnectedState; }
     inline QHostAddress localAddress() const { return socket.localAddress(); }
@@ -431,6 +437,8 @@ protected:
     inline virtual IrcChannel *ircChannelFactory(const QString &channelname) { return new CoreIrcChannel(channelname, this); }
     inline virtual IrcUser *ircUserFactory(const QString &hostmask) { return new CoreIrcUser(hostmask, this); }
 
+    QList<IrcUser *> queryIrcUsers() const override;
+
 protected slots:
     // TODO: remove cached cipher keys, when appropriate
     //virtual void removeIrcUser(IrcUser *ircuser);
@@ -449,6 +457,8 @@ private slots:
     void sendPerform();
     void restoreUserModes();
     void doAutoReconnect();
+    //! Opens the socket once the ConnectionScheduler lets the connection attempt through
+    void startConnection();
     void sendPing();
     void enablePingTimeout(bool enable = true);
     void disablePingTimeout();
@@ -481,6 +491,11 @@ private slots:
     void writeToSocket(const QByteArray &data);
 
 private:
+    //! Delay until the next automatic reconnect, backing off on repeated failures
+    int autoReconnectDelay() const;
+
+    void updateQueueMetrics();
+
     CoreSession *_coreSession;
 
 #ifdef HAVE_SSL
@@ -492,10 +507,15 @@ private:
 
     CoreUserInputHandler *_userInputHandler;
 
+    QString _metricsLabels;
+    qint64 _socketReadTime{0};
+    bool _socketReadScheduled{false};  ///< Whether socketHasData() was deferred to let other networks run
+
     QHash<QString, QString> _channelKeys; // stores persistent channels and their passwords, if any
 
     QTimer _autoReconnectTimer;
     int _autoReconnectCount;
+    int _autoReconnectAttempts{0};     ///< Reconnect attempts since the last successful connection
 
     QTimer _socketCloseTimer;
 
@@ -46,6 +46,7 @@
 #include "ircuser.h"
 #include "logmessage.h"
 #include "messageevent.h"
+#include "metrics.h"
 #include "remotepeer.h"
 #include "storage.h"
 #include "util.h"
@@ -79,6 +80,8 @@ CoreSession::CoreSession(UserId uid, bool restoreState, bool strictIdentEnabled,
     _ircParser(new IrcParser(this)),
     scriptEngine(new QScriptEngine(this)),
     _processMessages(false),
+    _backlogCache(Quassel::optionValue("backlog-cache-size").toInt(),
+                  Quassel::optionValue("backlog-cache-memory").toLongLong() * 1024 * 1024),
     _ignoreListManager(this),
     _highlightRuleManager(this)
 {
@@ -91,6 +94,18 @@ CoreSession::CoreSession(UserId uid, bool restoreState, bool strictIdentEnabled,
     connect(p, SIGNAL(connected()), SLOT(clientsConnected()));
     connect(p, SIGNAL(disconnected()), SLOT(clientsDisconnected()));
 
+    connect(_bufferSyncer, SIGNAL(bufferRemoved(BufferId)), SLOT(invalidateBacklogCache(BufferId)));
+    connect(_bufferSyncer, SIGNAL(bufferRenamed(BufferId, QString)), SLOT(invalidateBacklogCache(BufferId)));
+    connect(_bufferSyncer, SIGNAL(buffersPermanentlyMerged(BufferId, BufferId)), SLOT(invalidateBacklogCache(BufferId, BufferId)));
+    connect(Core::instance(), SIGNAL(backlogPruned(UserId, BufferId)), SLOT(pruneBacklogCache(UserId, BufferId)));
+
+    // Query buffers are looked up whenever a network's users are sent, so we keep track of them ourselves
+    foreach(const BufferInfo &bufferInfo, Core::requestBuffers(user()))
+        addQueryBuffer(bufferInfo);
+    connect(_bufferSyncer, SIGNAL(bufferRemoved(BufferId)), SLOT(queryBufferRemoved(BufferId)));
+    connect(_bufferSyncer, SIGNAL(bufferRenamed(BufferId, QString)), SLOT(queryBufferRenamed(BufferId, QString)));
+    connect(_bufferSyncer, SIGNAL(buffersPermanentlyMerged(BufferId, BufferId)), SLOT(queryBuffersMerged(BufferId, BufferId)));
+
     p->attachSlot(SIGNAL(sendInput(BufferInfo, QString)), this, SLOT(msgFromClient(BufferInfo, QString)));
     p->attachSignal(this, SIGNAL(displayMsg(Message)));
     p->attachSignal(this, SIGNAL(displayStatusMsg(QString, QString)));
@@ -276,6 +291,7 @@ void CoreSession::addClient(RemotePeer *peer)
     peer->dispatch(sessionState());
     signalProxy()->addPeer(peer);
     _coreInfo->setConnectedClientData(signalProxy()->peerCount(), signalProxy()->peerData());
+    Core::instance()->connectionScheduler()->setUserActive(user(), true);
 
     signalProxy()->setTargetPeer(nullptr);
 }
@@ -284,6 +300,7 @@ void CoreSession::addClient(RemotePeer *peer)
 void CoreSession::addClient(InternalPeer *peer)
 {
     signalProxy()->addPeer(peer);
+    Core::instance()->connectionScheduler()->setUserActive(user(), true);
     emit sessionState(sessionState());
 }
 
@@ -294,6 +311,7 @@ void CoreSession::removeClient(Peer *peer)
     if (p)
         quInfo() << qPrintable(tr("Client")) << p->description() << qPrintable(tr("disconnected (UserId: %1).").arg(user().toInt()));
     _coreInfo->setConnectedClientData(signalProxy()->peerCount(), signalProxy()->peerData());
+    Core::instance()->connectionScheduler()->setUserActive(user(), signalProxy()->peerCount() > 0);
 }
 
 
@@ -341,6 +359,8 @@ void CoreSession::recvMessageFromServer(NetworkId networkId, Message::Type type,
 
     // check for HardStrictness ignore
     CoreNetwork *currentNetwork = network(networkId);
+    if (currentNetwork)
+        rawMsg.receivedAt = currentNetwork->socketReadTime();
     QString networkName = currentNetwork ? currentNetwork->networkName() : QString("");
     if (_ignoreListManager.match(rawMsg, networkName) == IgnoreListManager::HardStrictness)
         return;
@@ -380,6 +400,47 @@ QList<BufferInfo> CoreSession::buffers() const
 }
 
 
+QList<BufferInfo> CoreSession::queryBuffers(NetworkId networkId) const
+{
+    QList<BufferInfo> bufferInfos;
+    foreach(const BufferInfo &bufferInfo, _queryBuffers) {
+        if (bufferInfo.networkId() == networkId)
+            bufferInfos << bufferInfo;
+    }
+    return bufferInfos;
+}
+
+
+void CoreSession::addQueryBuffer(const BufferInfo &bufferInfo)
+{
+    if (bufferInfo.type() == BufferInfo::QueryBuffer)
+        _queryBuffers[bufferInfo.bufferId()] = bufferInfo;
+}
+
+
+void CoreSession::queryBufferRemoved(BufferId bufferId)
+{
+    _queryBuffers.remove(bufferId);
+}
+
+
+void CoreSession::queryBufferRenamed(BufferId bufferId, const QString &newName)
+{
+    if (_queryBuffers.contains(bufferId)) {
+        const BufferInfo &bufferInfo = _queryBuffers[bufferId];
+        _queryBuffers[bufferId] = BufferInfo(bufferId, bufferInfo.networkId(), bufferInfo.type(), bufferInfo.groupId(), newName);
+    }
+}
+
+
+void CoreSession::queryBuffersMerged(BufferId bufferId1, BufferId bufferId2)
+{
+    // the second buffer is merged into the first one
+    Q_UNUSED(bufferId1);
+    _queryBuffers.remove(bufferId2);
+}
+
+
 void CoreSession::customEvent(QEvent *event)
 {
     if (event->type() != QEvent::User)
@@ -392,6 +453,10 @@ void CoreSession::customEvent(QEvent *event)
 
 void CoreSession::processMessages()
 {
+    // The queue is at its longest right before being processed
+    if (Metrics::isEnabled())
+        Metrics::set("quassel_session_message_queue_length", Metrics::label("user", QString::number(user().toInt())), _messageQueue.count());
+
     if (_messageQueue.count() == 1) {
         const RawMessage &rawMsg = _messageQueue.first();
         bool createBuffer = !(rawMsg.flags & Message::Redirected);
@@ -400,11 +465,14 @@ void CoreSession::processMessages()
             Q_ASSERT(!createBuffer);
             bufferInfo = Core::bufferInfo(user(), rawMsg.networkId, BufferInfo::StatusBuffer, "");
         }
+        addQueryBuffer(bufferInfo);
         Message msg(bufferInfo, rawMsg.type, rawMsg.text, rawMsg.sender, senderPrefixes(rawMsg.sender, bufferInfo),
                     realName(rawMsg.sender, rawMsg.networkId),  avatarUrl(rawMsg.sender, rawMsg.networkId),
                     rawMsg.flags);
-        if(Core::storeMessage(msg))
+        if(Core::storeMessage(msg)) {
+            _backlogCache.addMessages(MessageList() << msg);
             emit displayMsg(msg);
+        }
     }
     else {
         QHash<NetworkId, QHash<QString, BufferInfo> > bufferInfoCache;
@@ -425,6 +493,7 @@ void CoreSession::processMessages()
                     continue;
                 }
                 bufferInfoCache[rawMsg.networkId][rawMsg.target] = bufferInfo;
+                addQueryBuffer(bufferInfo);
             }
             Message msg(bufferInfo, rawMsg.type, rawMsg.text, rawMsg.sender, senderPrefixes(rawMsg.sender, bufferInfo),
                         realName(rawMsg.sender, rawMsg.networkId),  avatarUrl(rawMsg.sender, rawMsg.networkId),
@@ -451,12 +520,23 @@ void CoreSession::processMessages()
         }
 
         if(Core::storeMessages(messages)) {
+            _backlogCache.addMessages(messages);
             // FIXME: extend protocol to a displayMessages(MessageList)
             for (int i = 0; i < messages.count(); i++) {
                 emit displayMsg(messages[i]);
             }
         }
     }
+
+    // Latency from reading a line from the server until it's sent out to the clients
+    if (Metrics::isEnabled()) {
+        qint64 now = Metrics::monotonicTime();
+        foreach (const RawMessage &rawMsg, _messageQueue) {
+            if (rawMsg.receivedAt > 0)
+                Metrics::observe("quassel_message_latency_seconds", QString(), (now - rawMsg.receivedAt) / 1e9);
+        }
+    }
+
     _processMessages = false;
     _messageQueue.clear();
 }
@@ -691,6 +771,8 @@ void CoreSession::destroyNetwork(NetworkId id)
         }
         // remove buffers from syncer
         foreach(BufferId bufferId, removedBuffers) {
+            _backlogCache.removeBuffer(bufferId);
+            _queryBuffers.remove(bufferId);
             _bufferSyncer->removeBuffer(bufferId);
         }
         emit networkRemoved(id);
@@ -699,6 +781,27 @@ void CoreSession::destroyNetwork(NetworkId id)
 }
 
 
+void CoreSession::invalidateBacklogCache(BufferId bufferId)
+{
+    _backlogCache.removeBuffer(bufferId);
+}
+
+
+void CoreSession::invalidateBacklogCache(BufferId bufferId1, BufferId bufferId2)
+{
+    // messages of the second buffer have been moved into the first one
+    _backlogCache.removeBuffer(bufferId1);
+    _backlogCache.removeBuffer(bufferId2);
+}
+
+
+void CoreSession::pruneBacklogCache(UserId user, BufferId bufferId)
+{
+    if (user == _user)
+        _backlogCache.removeBuffer(bufferId);
+}
+
+
 void CoreSession::renameBuffer(const NetworkId &networkId, const QString &newName, const QString &oldName)
 {
     BufferInfo bufferInfo = Core::bufferInfo(user(), networkId, BufferInfo::QueryBuffer, oldName, false);
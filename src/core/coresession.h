@@ -24,6 +24,7 @@
 #include <QString>
 #include <QVariant>
 
+#include "backlogcache.h"
 #include "coreinfo.h"
 #include "corealiasmanager.h"
 #include "corehighlightrulemanager.h"
@@ -66,6 +67,8 @@ public:
     ~CoreSession();
 
     QList<BufferInfo> buffers() const;
+    //! The query buffers of the given network, as kept track of by the session rather than read from the storage
+    QList<BufferInfo> queryBuffers(NetworkId networkId) const;
     inline UserId user() const { return _user; }
     CoreNetwork *network(NetworkId) const;
     CoreIdentity *identity(IdentityId) const;
@@ -98,6 +101,8 @@ public:
 
     inline CoreIrcListHelper *ircListHelper() const { return _ircListHelper; }
 
+    inline BacklogCache *backlogCache() { return &_backlogCache; }
+
     inline CoreIgnoreListManager *ignoreListManager() { return &_ignoreListManager; }
     inline HighlightRuleManager *highlightRuleManager() { return &_highlightRuleManager; }
     inline CoreTransferManager *transferManager() const { return _transferManager; }
@@ -209,8 +214,18 @@ private slots:
 
     void saveSessionState() const;
 
+    //! Drop cached backlog of a buffer whose stored messages are about to change
+    void invalidateBacklogCache(BufferId bufferId);
+    void invalidateBacklogCache(BufferId bufferId1, BufferId bufferId2);
+    void pruneBacklogCache(UserId user, BufferId bufferId);
+
+    void queryBufferRemoved(BufferId bufferId);
+    void queryBufferRenamed(BufferId bufferId, const QString &newName);
+    void queryBuffersMerged(BufferId bufferId1, BufferId bufferId2);
+
 private:
     void processMessages();
+    void addQueryBuffer(const BufferInfo &bufferInfo);
 
     void loadSettings();
     void initScriptEngine();
@@ -270,6 +285,8 @@ private:
     QString avatarUrl(const QString &sender, NetworkId networkId) const;
     QList<RawMessage> _messageQueue;
     bool _processMessages;
+    BacklogCache _backlogCache;
+    QHash<BufferId, BufferInfo> _queryBuffers;
     CoreIgnoreListManager _ignoreListManager;
     CoreHighlightRuleManager _highlightRuleManager;
 };
@@ -283,6 +300,7 @@ struct RawMessage {
     QString text;
     QString sender;
     Message::Flags flags;
+    qint64 receivedAt{0}; ///< Metrics::monotonicTime() the causing line was read from the server at, if known
     RawMessage(NetworkId networkId, Message::Type type, BufferInfo::Type bufferType, const QString &target, const QString &text, const QString &sender, Message::Flags flags)
         : networkId(networkId), type(type), bufferType(bufferType), target(target), text(text), sender(sender), flags(flags) {}
 };
@@ -20,6 +20,7 @@
 
 #include "coresessioneventprocessor.h"
 
+#include "coreircchannel.h"
 #include "coreirclisthelper.h"
 #include "corenetwork.h"
 #include "coresession.h"
@@ -1167,7 +1168,7 @@ void CoreSessionEventProcessor::processIrcEvent353(IrcEvent *e)
     // we don't use this information at the time beeing
     QString channelname = e->params()[1];
 
-    IrcChannel *channel = e->network()->ircChannel(channelname);
+    CoreIrcChannel *channel = qobject_cast<CoreIrcChannel *>(e->network()->ircChannel(channelname));
     if (!channel) {
         qWarning() << Q_FUNC_INFO << "Received unknown target channel:" << channelname;
         return;
@@ -1178,26 +1179,27 @@ void CoreSessionEventProcessor::processIrcEvent353(IrcEvent *e)
 
     // Cache result of multi-prefix to avoid unneeded casts and lookups with each iteration.
     bool _useCapMultiPrefix = coreNetwork(e)->capEnabled(IrcCap::MULTI_PREFIX);
+    const QString prefixes = e->network()->prefixes();
 
-    foreach(QString nick, e->params()[2].split(' ', QString::SkipEmptyParts)) {
+    foreach(const QString &name, e->params()[2].split(' ', QString::SkipEmptyParts)) {
         QString mode;
+        int prefixLength = 0;
 
         if (_useCapMultiPrefix) {
             // If multi-prefix is enabled, all modes will be sent in NAMES replies.
             // :hades.arpa 353 guest = #tethys :~&@%+aji &@Attila @+alyx +KindOne Argure
             // See: http://ircv3.net/specs/extensions/multi-prefix-3.1.html
-            while (e->network()->prefixes().contains(nick[0])) {
+            while (prefixLength < name.length() && prefixes.contains(name[prefixLength])) {
                 // Mode found in 1 left-most character, add it to the list.
                 // Note: sending multiple modes may cause a warning in older clients.
                 // In testing, the clients still seemed to function fine.
-                mode.append(e->network()->prefixToMode(nick[0]));
-                // Remove this mode from the nick
-                nick = nick.remove(0, 1);
+                mode.append(e->network()->prefixToMode(QString(name[prefixLength])));
+                ++prefixLength;
             }
-        } else if (e->network()->prefixes().contains(nick[0])) {
+        } else if (prefixes.contains(name[0])) {
             // Multi-prefix is disabled and a mode prefix was found.
-            mode = e->network()->prefixToMode(nick[0]);
-            nick = nick.mid(1);
+            mode = e->network()->prefixToMode(QString(name[0]));
+            prefixLength = 1;
         }
 
         // If userhost-in-names capability is enabled, the following will be
@@ -1205,11 +1207,34 @@ void CoreSessionEventProcessor::processIrcEvent353(IrcEvent *e)
         // special handling as the following use nickFromHost() as needed.
         // See: http://ircv3.net/specs/extensions/userhost-in-names-3.2.html
 
-        nicks << nick;
+        nicks << name.mid(prefixLength);
         modes << mode;
     }
 
-    channel->joinIrcUsers(nicks, modes);
+    // Large channels send many replies; join all users at once when the list is complete
+    channel->addPendingNames(nicks, modes);
+}
+
+
+/* RPL_ENDOFNAMES - "<channel> :End of /NAMES list" */
+void CoreSessionEventProcessor::processIrcEvent366(IrcEvent *e)
+{
+    if (!checkParamCount(e, 1))
+        return;
+
+    CoreIrcChannel *channel = qobject_cast<CoreIrcChannel *>(e->network()->ircChannel(e->params()[0]));
+    if (channel) {
+        channel->joinPendingNames();
+        return;
+    }
+
+    // A NAMES without a channel ends with "366 *", and the lists collected for the channels it covered
+    // would otherwise linger until the respective channel's next NAMES reply
+    foreach(IrcChannel *ircChannel, e->network()->ircChannels()) {
+        CoreIrcChannel *coreChannel = qobject_cast<CoreIrcChannel *>(ircChannel);
+        if (coreChannel)
+            coreChannel->joinPendingNames();
+    }
 }
 
 
@@ -1418,18 +1443,16 @@ void CoreSessionEventProcessor::handleNetsplitJoin(Network *net,
         return;
     }
     QList<IrcUser *> ircUsers;
-    QStringList newModes = modes;
-    QStringList newUsers = users;
-
-    foreach(const QString &user, users) {
-        IrcUser *iu = net->ircUser(nickFromMask(user));
-        if (iu)
-            ircUsers.append(iu);
-        else { // the user already quit
-            int idx = users.indexOf(user);
-            newUsers.removeAt(idx);
-            newModes.removeAt(idx);
-        }
+    QStringList newModes;
+    QStringList newUsers;
+
+    for (int i = 0; i < users.count(); ++i) {
+        IrcUser *iu = net->ircUser(nickFromMask(users.at(i)));
+        if (!iu) // the user already quit
+            continue;
+        ircUsers.append(iu);
+        newUsers.append(users.at(i));
+        newModes.append(modes.at(i));
     }
 
     ircChannel->joinIrcUsers(ircUsers, newModes);
@@ -1459,18 +1482,16 @@ void CoreSessionEventProcessor::handleEarlyNetsplitJoin(Network *net, const QStr
     }
     QList<NetworkEvent *> events;
     QList<IrcUser *> ircUsers;
-    QStringList newModes = modes;
-
-    foreach(QString user, users) {
-        IrcUser *iu = net->updateNickFromMask(user);
-        if (iu) {
-            ircUsers.append(iu);
-            // fake event for scripts that consume join events
-            events << new IrcEvent(EventManager::IrcEventJoin, net, iu->hostmask(), QStringList() << channel);
-        }
-        else {
-            newModes.removeAt(users.indexOf(user));
-        }
+    QStringList newModes;
+
+    for (int i = 0; i < users.count(); ++i) {
+        IrcUser *iu = net->updateNickFromMask(users.at(i));
+        if (!iu)
+            continue;
+        ircUsers.append(iu);
+        newModes.append(modes.at(i));
+        // fake event for scripts that consume join events
+        events << new IrcEvent(EventManager::IrcEventJoin, net, iu->hostmask(), QStringList() << channel);
     }
     ircChannel->joinIrcUsers(ircUsers, newModes);
     foreach(NetworkEvent *event, events) {
@@ -1593,10 +1614,28 @@ void CoreSessionEventProcessor::handleCtcpDcc(CtcpEvent *e)
             }
 
             // TODO: check if target is the right thing to use for the partner
-            CoreTransfer *transfer = new CoreTransfer(Transfer::Direction::Receive, e->target(), filename, address, port, size, this);
+            CoreTransfer *transfer = new CoreTransfer(coreNetwork(e), Transfer::Direction::Receive, e->target(), filename, address, port, size, this);
             coreSession()->signalProxy()->synchronize(transfer);
             coreSession()->transferManager()->addTransfer(transfer);
         }
+        else if (cmd == "ACCEPT") {
+            // ACCEPT <filename> <port> <position>, the sender's answer to our RESUME
+            if (params.count() < 4) {
+                qWarning() << "Invalid DCC ACCEPT request:" << e;
+                return;
+            }
+            quint16 port = params[2].toUShort();
+            quint64 position = params[3].toULongLong();
+            foreach(const QUuid &uuid, coreSession()->transferManager()->transferIds()) {
+                CoreTransfer *transfer = qobject_cast<CoreTransfer *>(coreSession()->transferManager()->transfer(uuid));
+                if (transfer && transfer->isAwaitingResume() && transfer->network() == coreNetwork(e)
+                    && transfer->port() == port && transfer->nick().compare(e->target(), Qt::CaseInsensitive) == 0) {
+                    transfer->resumeAccepted(position);
+                    return;
+                }
+            }
+            qWarning() << "DCC ACCEPT for unknown transfer:" << e;
+        }
         else {
             emit newEvent(new MessageEvent(Message::Error, e->network(), tr("DCC %1 not supported").arg(cmd), e->prefix(), e->target(), Message::None, e->timestamp()));
             return;
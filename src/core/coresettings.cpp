@@ -44,6 +44,21 @@ QVariant CoreSettings::storageSettings(const QVariant &def)
 }
 
 
+void CoreSettings::setStorageMigrationTarget(const QString &backend)
+{
+    if (backend.isEmpty())
+        removeLocalKey("StorageMigrationTarget");
+    else
+        setLocalValue("StorageMigrationTarget", backend);
+}
+
+
+QString CoreSettings::storageMigrationTarget()
+{
+    return localValue("StorageMigrationTarget").toString();
+}
+
+
 QVariant CoreSettings::authSettings(const QVariant &def)
 {
     return localValue("AuthSettings", def);
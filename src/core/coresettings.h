@@ -32,6 +32,10 @@ public:
     void setStorageSettings(const QVariant &data);
     QVariant storageSettings(const QVariant &def = QVariant());
 
+    //! The backend an unfinished migration is copying the storage to, if any; an empty name clears it
+    void setStorageMigrationTarget(const QString &backend);
+    QString storageMigrationTarget();
+
     void setAuthSettings(const QVariant &data);
     QVariant authSettings(const QVariant &def = QVariant());
 
@@ -20,31 +20,83 @@
 
 #include <QtEndian>
 
-#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QTcpSocket>
+#include <QTimer>
 
 #include "coretransfer.h"
+#include "corenetwork.h"
+#include "ctcpparser.h"
+#include "quassel.h"
+#include "signalproxy.h"
 
 const qint64 chunkSize = 16 * 1024;
 
+// Data that has been read from the DCC socket, but not yet been acknowledged by a flow-controlled client.
+// Anything beyond that stays in the socket, so the sender is throttled to what the client can take, and
+// file data never piles up in front of the rest of the session's traffic.
+const qint64 relayWindow = 4 * chunkSize;
+
+// When spooling, the sender is not held back by any client, so read in larger portions and only hit the disk
+// once a sizeable amount has accumulated.
+const qint64 spoolReadSize = 256 * 1024;
+const qint64 spoolWriteSize = 1024 * 1024;
+
+// Time the sender has to answer a DCC RESUME
+const int resumeTimeout = 60 * 1000;
+
+// Upper bound for --dcc-spool-expiry, in hours, so the timer interval fits into an int
+const int maxSpoolExpiry = 24 * 24;
+
+// Largest range served in one go, so a fetching client gets its data in portions that don't hold up chat
+const quint64 maxRangeSize = relayWindow;
+
 INIT_SYNCABLE_OBJECT(CoreTransfer)
 
-CoreTransfer::CoreTransfer(Direction direction, const QString &nick, const QString &fileName, const QHostAddress &address, quint16 port, quint64 fileSize, QObject *parent)
+CoreTransfer::CoreTransfer(CoreNetwork *network, Direction direction, const QString &nick, const QString &fileName, const QHostAddress &address, quint16 port, quint64 fileSize, QObject *parent)
     : Transfer(direction, nick, fileName, address, port, fileSize, parent),
+    _network(network),
     _socket(0),
     _pos(0),
-    _reading(false)
+    _acknowledged(0),
+    _resumePosition(0),
+    _flowControl(false),
+    _spoolFile(0),
+    _spoolStart(0),
+    _spooled(0)
 {
 
 }
 
 
+CoreTransfer::~CoreTransfer()
+{
+    // Spooled files can't be fetched anymore once the transfer is gone, e.g. after a core restart
+    if (_spoolFile)
+        _spoolFile->remove();
+}
+
+
 quint64 CoreTransfer::transferred() const
 {
     return _pos;
 }
 
 
+CoreNetwork *CoreTransfer::network() const
+{
+    return _network;
+}
+
+
+bool CoreTransfer::isAwaitingResume() const
+{
+    return _resumePosition > 0 && status() == Status::Pending;
+}
+
+
 void CoreTransfer::cleanUp()
 {
     if (_socket) {
@@ -54,23 +106,43 @@ void CoreTransfer::cleanUp()
     }
 
     _buffer.clear();
-    _reading = false;
+
+    // A completed spool file stays around for clients to fetch, until it expires
+    if (status() != Status::Completed)
+        removeSpool(tr("The transfer has failed!"));
 }
 
 
 void CoreTransfer::onSocketDisconnected()
 {
     if (status() == Status::Connecting || status() == Status::Transferring) {
-        setError(tr("Socket closed while still transferring!"));
+        // Senders may close the connection right after their last byte, which we might not have read yet
+        if (status() == Status::Transferring)
+            onDataReceived();
+        checkSenderGone();
     }
     else
         cleanUp();
 }
 
 
+void CoreTransfer::checkSenderGone()
+{
+    // Data held back until the client has acknowledged what it got so far is still readable after the
+    // sender has disconnected, so we only know whether the transfer failed once it has all been relayed
+    if (!_socket || _socket->state() != QAbstractSocket::UnconnectedState || _socket->bytesAvailable() > 0)
+        return;
+
+    if (status() == Status::Connecting || status() == Status::Transferring)
+        setError(tr("Socket closed while still transferring!"));
+}
+
+
 void CoreTransfer::onSocketError(QAbstractSocket::SocketError error)
 {
-    Q_UNUSED(error)
+    // The sender closing the connection is handled in onSocketDisconnected(), once we've read everything
+    if (error == QAbstractSocket::RemoteHostClosedError)
+        return;
 
     if (status() == Status::Connecting || status() == Status::Transferring) {
         setError(tr("DCC connection error: %1").arg(_socket->errorString()));
@@ -78,12 +150,22 @@ void CoreTransfer::onSocketError(QAbstractSocket::SocketError error)
 }
 
 
+void CoreTransfer::onResumeTimeout()
+{
+    if (isAwaitingResume())
+        setError(tr("DCC Receive: Sender didn't agree to resume the transfer!"));
+}
+
+
 void CoreTransfer::requestAccepted(PeerPtr peer)
 {
     if (_peer || !peer || status() != Status::New)
         return; // transfer was already accepted
 
     _peer = peer;
+    _flowControl = peer->hasFeature(Quassel::Feature::TransferFlowControl);
+    if (!startSpooling(peer, 0))
+        return;
     setStatus(Status::Pending);
 
     emit accepted(peer);
@@ -93,6 +175,47 @@ void CoreTransfer::requestAccepted(PeerPtr peer)
 }
 
 
+void CoreTransfer::requestResumed(PeerPtr peer, quint64 position)
+{
+    if (_peer || !peer || status() != Status::New)
+        return; // transfer was already accepted
+
+    _peer = peer;
+    _flowControl = peer->hasFeature(Quassel::Feature::TransferFlowControl);
+    if (!_network || position == 0 || position >= fileSize()) {
+        setError(tr("DCC Receive: Cannot resume at position %1!").arg(position));
+        return;
+    }
+
+    if (!startSpooling(peer, position))
+        return;
+    _resumePosition = position;
+    setStatus(Status::Pending);
+
+    emit accepted(peer);
+
+    // The sender confirms the position with a DCC ACCEPT, which then starts the transfer
+    _network->coreSession()->ctcpParser()->query(_network, nick(), "DCC",
+        QString("RESUME %1 %2 %3").arg(fileName()).arg(port()).arg(position));
+    QTimer::singleShot(resumeTimeout, this, SLOT(onResumeTimeout()));
+}
+
+
+void CoreTransfer::resumeAccepted(quint64 position)
+{
+    if (!isAwaitingResume())
+        return;
+
+    if (position != _resumePosition) {
+        setError(tr("DCC Receive: Sender wants to resume at position %1 instead of %2!").arg(position).arg(_resumePosition));
+        return;
+    }
+
+    _pos = _acknowledged = position;
+    start();
+}
+
+
 void CoreTransfer::requestRejected(PeerPtr peer)
 {
     if (_peer || status() != Status::New)
@@ -105,6 +228,21 @@ void CoreTransfer::requestRejected(PeerPtr peer)
 }
 
 
+void CoreTransfer::requestDataAcknowledged(PeerPtr peer, quint64 position)
+{
+    if (peer != _peer.data() || position <= _acknowledged || position > _pos)
+        return;
+
+    _acknowledged = position;
+
+    // the client has made room, so relay whatever has arrived in the meantime
+    if (_socket && status() == Status::Transferring) {
+        onDataReceived();
+        checkSenderGone();
+    }
+}
+
+
 void CoreTransfer::start()
 {
     if (!_peer || status() != Status::Pending || direction() != Direction::Receive)
@@ -124,6 +262,8 @@ void CoreTransfer::setupConnectionForReceive()
     setStatus(Status::Connecting);
 
     _socket = new QTcpSocket(this);
+    // Only read a limited amount at a time, so a fast sender can neither hog the event loop nor fill our memory
+    _socket->setReadBufferSize(isSpooled() ? spoolReadSize : relayWindow);
     connect(_socket, SIGNAL(connected()), SLOT(startReceiving()));
     connect(_socket, SIGNAL(disconnected()), SLOT(onSocketDisconnected()));
     connect(_socket, SIGNAL(error(QAbstractSocket::SocketError)), SLOT(onSocketError(QAbstractSocket::SocketError)));
@@ -141,26 +281,31 @@ void CoreTransfer::startReceiving()
 
 void CoreTransfer::onDataReceived()
 {
-    if (_reading) // since we're spinning the event loop, we may get another readyRead() and thus reentrancy
-        return;
-    _reading = true;
-
+    bool haveRead = false;
     while (_socket->bytesAvailable()) {
-        QByteArray data = _socket->read(chunkSize);
+        qint64 maxSize = isSpooled() ? spoolReadSize : chunkSize;
+        if (_flowControl && !isSpooled()) {
+            maxSize = qMin(maxSize, relayWindow - static_cast<qint64>(_pos - _acknowledged));
+            if (maxSize <= 0)
+                break; // wait for the client to catch up
+        }
+        QByteArray data = _socket->read(maxSize);
         _pos += data.size();
-        emit transferredChanged(transferred());
-        if (!relayData(data, true))
-            return;
-
-        QCoreApplication::processEvents();  // don't block the rest of the core/client communication
-        if (!_socket)  // just in case something happened during spinning the event loop that killed our socket
+        haveRead = true;
+        if (!(isSpooled() ? spoolData(data) : relayData(data, true)))
             return;
     }
 
+    if (!haveRead)
+        return;
+
+    emit transferredChanged(transferred());
+
     // Send ack to sender. The DCC protocol only specifies 32 bit values, but modern clients (i.e. those who can send files
     // larger than 4 GB) will ignore this anyway...
     quint32 ack = qToBigEndian((quint32)_pos);// qDebug() << Q_FUNC_INFO << _pos;
-    _socket->write((char *)&ack, 4);
+    if (_socket->state() == QAbstractSocket::ConnectedState)
+        _socket->write((char *)&ack, 4);
 
     if (_pos > fileSize()) {
         qWarning() << "DCC Receive: Got more data than expected!";
@@ -168,11 +313,12 @@ void CoreTransfer::onDataReceived()
     }
     else if (_pos == fileSize()) {
         qDebug() << "DCC Receive: Transfer finished";
-        if (relayData(QByteArray(), false)) // empty buffer
+        if (isSpooled() ? finishSpooling() : relayData(QByteArray(), false)) // empty buffer
             setStatus(Status::Completed);
     }
 
-    _reading = false;
+    if (isSpooled())
+        serveRanges();
 }
 
 
@@ -187,10 +333,189 @@ bool CoreTransfer::relayData(const QByteArray &data, bool requireChunkSize)
 
     // we only want to send data to the client once we have reached the chunksize
     if (_buffer.size() > 0 && (_buffer.size() >= chunkSize || !requireChunkSize)) {
+        // Only the client that accepted the transfer wants its data
         Peer *p = _peer.data();
-        SYNC_OTHER(dataReceived, ARG(p), ARG(_buffer));
+        SignalProxy::current()->restrictTargetPeers(p, [&] {
+            SYNC_OTHER(dataReceived, ARG(p), ARG(_buffer));
+        });
         _buffer.clear();
     }
 
     return true;
 }
+
+
+/*** Spooling ***/
+
+bool CoreTransfer::startSpooling(PeerPtr peer, quint64 position)
+{
+    QString spoolDir = Quassel::optionValue("dcc-spool-dir");
+    if (spoolDir.isEmpty() || !_network || !peer->hasFeature(Quassel::Feature::TransferSpooling))
+        return true; // relay directly to the client
+
+    QDir dir(spoolDir);
+    QString userDir = QString::number(_network->userId().toInt());
+    if (!dir.mkpath(userDir)) {
+        setError(tr("DCC Receive: Could not create spool directory %1!").arg(dir.filePath(userDir)));
+        return false;
+    }
+
+    // The final name is only chosen once the transfer is complete, so don't let the sender pick it yet
+    _spoolFile = new QFile(QDir(dir.filePath(userDir)).filePath(uuid().toString().mid(1, 36) + ".part"), this);
+    if (!_spoolFile->open(QFile::ReadWrite|QFile::Truncate)) {
+        setError(tr("DCC Receive: Could not open spool file: %1").arg(_spoolFile->errorString()));
+        return false;
+    }
+
+    // Positions in the spool file are those of the transfer, so a resumed transfer leaves a hole at the start
+    _spoolStart = _spooled = position;
+    setSpooled(true);
+    return true;
+}
+
+
+bool CoreTransfer::spoolData(const QByteArray &data)
+{
+    _buffer.append(data);
+    if (_buffer.size() >= spoolWriteSize)
+        return writeSpool();
+
+    return true;
+}
+
+
+bool CoreTransfer::writeSpool()
+{
+    if (_buffer.isEmpty())
+        return true;
+
+    if (!_spoolFile->seek(_spooled) || _spoolFile->write(_buffer) != _buffer.size()) {
+        setError(tr("DCC Receive: Could not write to spool file: %1").arg(_spoolFile->errorString()));
+        return false;
+    }
+    _spooled += _buffer.size();
+    _buffer.clear();
+    return true;
+}
+
+
+bool CoreTransfer::finishSpooling()
+{
+    if (!writeSpool())
+        return false;
+
+    // Give the file the name offered by the sender, minus any path, without replacing existing files
+    QFileInfo spoolInfo(_spoolFile->fileName());
+    QString baseName = QFileInfo(fileName()).fileName();
+    if (baseName.isEmpty())
+        baseName = spoolInfo.completeBaseName();
+    QString path = spoolInfo.dir().filePath(baseName);
+    for (int i = 1; QFile::exists(path); ++i)
+        path = spoolInfo.dir().filePath(QString("%1.%2").arg(baseName).arg(i));
+
+    // rename() closes the file, so reopen it for serving ranges
+    if (!_spoolFile->rename(path))
+        qWarning() << "DCC Receive: Could not rename spool file to" << path << ":" << _spoolFile->errorString();
+    if (!_spoolFile->open(QFile::ReadOnly)) {
+        setError(tr("DCC Receive: Could not reopen spool file: %1").arg(_spoolFile->errorString()));
+        return false;
+    }
+
+    int expiry = qBound(1, Quassel::optionValue("dcc-spool-expiry").toInt(), maxSpoolExpiry);
+    QTimer::singleShot(expiry * 60 * 60 * 1000, this, SLOT(expireSpool()));
+    return true;
+}
+
+
+void CoreTransfer::expireSpool()
+{
+    removeSpool(tr("The file is no longer kept on the core!"));
+}
+
+
+void CoreTransfer::removeSpool(const QString &reason)
+{
+    if (!_spoolFile)
+        return;
+
+    _spoolFile->remove();
+    delete _spoolFile;
+    _spoolFile = 0;
+
+    foreach(const RangeRequest &request, _rangeRequests) {
+        if (request.peer)
+            rejectRange(request.peer, request.position, reason);
+    }
+    _rangeRequests.clear();
+}
+
+
+void CoreTransfer::requestRange(PeerPtr peer, quint64 position, quint64 length)
+{
+    if (!peer)
+        return;
+
+    QString reason;
+    if (!_spoolFile)
+        reason = status() == Status::Completed ? tr("The file is no longer kept on the core!") : tr("The transfer is not spooled on the core!");
+    else if (position < _spoolStart)
+        reason = tr("The core only has the file from position %1 on!").arg(_spoolStart);
+    else if (length == 0 || length > maxRangeSize || position + length > fileSize())
+        reason = tr("Invalid range requested!");
+
+    if (!reason.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "Rejecting range" << position << length << ":" << reason;
+        rejectRange(peer, position, reason);
+        return;
+    }
+
+    _rangeRequests.append({peer, position, length});
+    serveRanges();
+}
+
+
+void CoreTransfer::rejectRange(Peer *peer, quint64 position, const QString &reason)
+{
+    SignalProxy::current()->restrictTargetPeers(peer, [&] {
+        SYNC_OTHER(rangeRejected, ARG(peer), ARG(position), ARG(reason));
+    });
+}
+
+
+void CoreTransfer::serveRanges()
+{
+    // Ranges are answered in order, each as soon as it has been received completely
+    while (_spoolFile && !_rangeRequests.isEmpty()) {
+        const RangeRequest &request = _rangeRequests.first();
+        if (request.peer) {
+            if (request.position + request.length > _pos)
+                return;
+
+            QByteArray data;
+            if (request.position < _spooled) {
+                quint64 length = qMin(request.length, _spooled - request.position);
+                if (_spoolFile->seek(request.position))
+                    data = _spoolFile->read(length);
+                if (static_cast<quint64>(data.size()) != length) {
+                    qWarning() << Q_FUNC_INFO << "Could not read from spool file:" << _spoolFile->errorString();
+                    rejectRange(request.peer, request.position, tr("Could not read from the spool file on the core!"));
+                    _rangeRequests.removeFirst();
+                    continue;
+                }
+            }
+            // Whatever hasn't been written yet is served from the buffer, so following clients don't defeat batching
+            if (static_cast<quint64>(data.size()) < request.length) {
+                quint64 offset = request.position + data.size() - _spooled;
+                data.append(_buffer.mid(offset, request.length - data.size()));
+            }
+
+            // Only the client that asked for the range wants it
+            Peer *p = request.peer.data();
+            quint64 position = request.position;
+            SignalProxy::current()->restrictTargetPeers(p, [&] {
+                SYNC_OTHER(rangeReceived, ARG(p), ARG(position), ARG(data));
+            });
+        }
+        _rangeRequests.removeFirst();
+    }
+}
@@ -26,6 +26,8 @@
 #include "transfer.h"
 #include "peer.h"
 
+class CoreNetwork;
+class QFile;
 class QTcpSocket;
 
 class CoreTransfer : public Transfer
@@ -34,33 +36,70 @@ class CoreTransfer : public Transfer
     SYNCABLE_OBJECT
 
 public:
-    CoreTransfer(Direction direction, const QString &nick, const QString &fileName, const QHostAddress &address, quint16 port, quint64 size = 0, QObject *parent = 0);
+    CoreTransfer(CoreNetwork *network, Direction direction, const QString &nick, const QString &fileName, const QHostAddress &address, quint16 port, quint64 size = 0, QObject *parent = 0);
+    ~CoreTransfer() override;
 
     quint64 transferred() const override;
+    CoreNetwork *network() const;
+
+    //! Whether this transfer has asked the sender to resume and waits for its DCC ACCEPT
+    bool isAwaitingResume() const;
 
 public slots:
     void start();
 
+    //! Called when the sender has agreed to resume the transfer at the given position
+    void resumeAccepted(quint64 position);
+
     // called through sync calls
     void requestAccepted(PeerPtr peer) override;
+    void requestResumed(PeerPtr peer, quint64 position) override;
     void requestRejected(PeerPtr peer) override;
+    void requestDataAcknowledged(PeerPtr peer, quint64 position) override;
+    void requestRange(PeerPtr peer, quint64 position, quint64 length) override;
 
 private slots:
     void startReceiving();
     void onDataReceived();
     void onSocketDisconnected();
     void onSocketError(QAbstractSocket::SocketError error);
+    void onResumeTimeout();
+    void expireSpool();
 
 private:
     void setupConnectionForReceive();
     bool relayData(const QByteArray &data, bool requireChunkSize);
+    void checkSenderGone();
     void cleanUp() override;
 
+    // spooling
+    bool startSpooling(PeerPtr peer, quint64 position);
+    bool spoolData(const QByteArray &data);
+    bool writeSpool();
+    bool finishSpooling();
+    void removeSpool(const QString &reason);
+    void rejectRange(Peer *peer, quint64 position, const QString &reason);
+    void serveRanges();
+
+    struct RangeRequest {
+        QPointer<Peer> peer;
+        quint64 position;
+        quint64 length;
+    };
+
+    QPointer<CoreNetwork> _network;
     QPointer<Peer> _peer;
     QTcpSocket *_socket;
     quint64 _pos;
+    quint64 _acknowledged;
+    quint64 _resumePosition;
     QByteArray _buffer;
-    bool _reading;
+    bool _flowControl;
+
+    QFile *_spoolFile;
+    quint64 _spoolStart;
+    quint64 _spooled;
+    QList<RangeRequest> _rangeRequests;
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "eventmanager.h"
 #include "ircevent.h"
 #include "messageevent.h"
+#include "metrics.h"
 #include "networkevent.h"
 
 #ifdef HAVE_QCA2
@@ -74,27 +75,9 @@ QByteArray IrcParser::decrypt(Network *network, const QString &bufferName, const
 
 /* parse the raw server string and generate an appropriate event */
 /* used to be handleServerMsg()                                  */
-void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
+bool IrcParser::tokenize(QByteArray msg, QByteArray &prefix, QByteArray &cmd, QList<QByteArray> &params)
 {
-    CoreNetwork *net = qobject_cast<CoreNetwork *>(e->network());
-    if (!net) {
-        qWarning() << "Received network event without valid network pointer!";
-        return;
-    }
-
-    // note that the IRC server is still alive
-    net->resetPingTimeout();
-
-    QByteArray msg = e->data();
-    if (msg.isEmpty()) {
-        qWarning() << "Received empty string from server!";
-        return;
-    }
-
-    // Now we split the raw message into its various parts...
-    QString prefix;
     QByteArray trailing;
-    QString cmd, target;
 
     // First, check for a trailing parameter introduced by " :", since this might screw up splitting the msg
     // NOTE: This assumes that this is true in raw encoding, but well, hopefully there are no servers running in japanese on protocol level...
@@ -105,7 +88,7 @@ void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
         msg = msg.left(idx);
     }
     // OK, now it is safe to split...
-    QList<QByteArray> params = msg.split(' ');
+    params = msg.split(' ');
 
     // This could still contain empty elements due to (faulty?) ircds sending multiple spaces in a row
     // Also, QByteArray is not nearly as convenient to work with as QString for such things :)
@@ -119,26 +102,57 @@ void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
 
     if (!trailing.isEmpty())
         params << trailing;
-    if (params.count() < 1) {
-        qWarning() << "Received invalid string from server!";
+    if (params.count() < 1)
+        return false;
+
+    cmd = params.takeFirst();
+
+    // a colon as the first char indicates the existence of a prefix
+    if (cmd.startsWith(':')) {
+        prefix = cmd.mid(1);
+        if (params.count() < 1)
+            return false;
+        cmd = params.takeFirst();
+    }
+    else {
+        prefix.clear();
+    }
+    return true;
+}
+
+
+void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
+{
+    CoreNetwork *net = qobject_cast<CoreNetwork *>(e->network());
+    if (!net) {
+        qWarning() << "Received network event without valid network pointer!";
         return;
     }
 
-    QString foo = net->serverDecode(params.takeFirst());
+    // note that the IRC server is still alive
+    net->resetPingTimeout();
 
-    // a colon as the first chars indicates the existence of a prefix
-    if (foo[0] == ':') {
-        foo.remove(0, 1);
-        prefix = foo;
-        if (params.count() < 1) {
-            qWarning() << "Received invalid string from server!";
-            return;
-        }
-        foo = net->serverDecode(params.takeFirst());
+    if (Metrics::isEnabled())
+        Metrics::add("quassel_irc_lines_received_total", net->metricsLabels());
+
+    QByteArray msg = e->data();
+    if (msg.isEmpty()) {
+        qWarning() << "Received empty string from server!";
+        return;
+    }
+
+    // Now we split the raw message into its various parts...
+    QByteArray rawPrefix, rawCmd;
+    QList<QByteArray> params;
+    if (!tokenize(msg, rawPrefix, rawCmd, params)) {
+        qWarning() << "Received invalid string from server!";
+        return;
     }
 
+    QString prefix = net->serverDecode(rawPrefix);
     // next string without a whitespace is the command
-    cmd = foo.trimmed();
+    QString cmd = net->serverDecode(rawCmd).trimmed();
+    QString target;
 
     QList<Event *> events;
     EventManager::EventType type = EventManager::Invalid;
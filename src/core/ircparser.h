@@ -38,6 +38,12 @@ public:
     inline CoreSession *coreSession() const { return _coreSession; }
     inline EventManager *eventManager() const { return coreSession()->eventManager(); }
 
+    //! Split a raw IRC line into its prefix, command and (still encoded) parameters
+    /** A trailing parameter introduced by " :" is appended to \a params as-is.
+      * \return false if the line doesn't contain a command
+      */
+    static bool tokenize(QByteArray msg, QByteArray &prefix, QByteArray &cmd, QList<QByteArray> &params);
+
 signals:
     void newEvent(Event *);
 
@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "metricsserver.h"
+
+#include <QLocalSocket>
+#include <QTcpSocket>
+
+#ifdef Q_OS_UNIX
+#  include <sys/resource.h>
+#endif
+
+#include "connectionscheduler.h"
+#include "core.h"
+#include "logmessage.h"
+#include "metrics.h"
+#include "quassel.h"
+
+// We only expect short GET requests, anything longer is dropped
+static const int maxRequestSize = 8192;
+
+static void updateProcessMetrics()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#  ifdef Q_OS_MAC
+        double peakRss = usage.ru_maxrss; // bytes
+#  else
+        double peakRss = usage.ru_maxrss * 1024.0; // kilobytes
+#  endif
+        Metrics::set("process_resident_memory_peak_bytes", QString(), peakRss);
+    }
+#endif
+}
+
+static void updateConnectionQueueMetrics()
+{
+    ConnectionScheduler *scheduler = Core::instance()->connectionScheduler();
+    if (!scheduler)
+        return;
+
+    QVariantMap state = scheduler->queueState();
+    double oldestWait = 0;
+    int prioritized = 0;
+    foreach(const QVariant &entry, state["entries"].toList()) {
+        QVariantMap map = entry.toMap();
+        oldestWait = qMax(oldestWait, map["waiting"].toLongLong() / 1000.0);
+        if (map["prioritized"].toBool())
+            prioritized++;
+    }
+    Metrics::set({
+        {"quassel_connection_queue_length", QString(), state["queued"].toDouble()},
+        {"quassel_connection_queue_prioritized", QString(), double(prioritized)},
+        {"quassel_connection_queue_oldest_wait_seconds", QString(), oldestWait}
+    });
+}
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent)
+{
+    connect(&_server, SIGNAL(newConnection()), this, SLOT(incomingConnection()));
+    connect(&_v6server, SIGNAL(newConnection()), this, SLOT(incomingConnection()));
+    connect(&_localServer, SIGNAL(newConnection()), this, SLOT(incomingLocalConnection()));
+}
+
+
+bool MetricsServer::startListening()
+{
+    bool success = false;
+
+    if (Quassel::isOptionSet("metrics-port")) {
+        quint16 port = Quassel::optionValue("metrics-port").toUShort();
+        if (_v6server.listen(QHostAddress("::1"), port)) {
+            quInfo() << qPrintable(tr("Serving metrics on IPv6 %1 port %2").arg("::1").arg(_v6server.serverPort()));
+            success = true;
+        }
+        if (_server.listen(QHostAddress("127.0.0.1"), port)) {
+            quInfo() << qPrintable(tr("Serving metrics on IPv4 %1 port %2").arg("127.0.0.1").arg(_server.serverPort()));
+            success = true;
+        }
+    }
+
+    if (Quassel::isOptionSet("metrics-socket")) {
+        QString path = Quassel::optionValue("metrics-socket");
+        QLocalServer::removeServer(path); // clean up after an unclean shutdown
+        if (_localServer.listen(path)) {
+            quInfo() << qPrintable(tr("Serving metrics on socket %1").arg(path));
+            success = true;
+        }
+        else {
+            quWarning() << qPrintable(tr("Could not listen on metrics socket %1: %2").arg(path, _localServer.errorString()));
+        }
+    }
+
+    if (!success) {
+        quError() << qPrintable(tr("Could not open any interface for serving metrics!"));
+    }
+
+    return success;
+}
+
+
+void MetricsServer::stopListening(const QString &msg)
+{
+    bool wasListening = _server.isListening() || _v6server.isListening() || _localServer.isListening();
+
+    _server.close();
+    _v6server.close();
+    _localServer.close();
+
+    if (wasListening) {
+        if (msg.isEmpty())
+            quInfo() << "No longer serving metrics.";
+        else
+            quInfo() << qPrintable(msg);
+    }
+}
+
+
+void MetricsServer::incomingConnection()
+{
+    auto server = qobject_cast<QTcpServer *>(sender());
+    Q_ASSERT(server);
+    while (server->hasPendingConnections()) {
+        setupSocket(server->nextPendingConnection());
+    }
+}
+
+
+void MetricsServer::incomingLocalConnection()
+{
+    while (_localServer.hasPendingConnections()) {
+        setupSocket(_localServer.nextPendingConnection());
+    }
+}
+
+
+void MetricsServer::setupSocket(QIODevice *socket)
+{
+    connect(socket, SIGNAL(readyRead()), this, SLOT(respond()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+}
+
+
+void MetricsServer::respond()
+{
+    QIODevice *socket = qobject_cast<QIODevice *>(sender());
+    Q_ASSERT(socket);
+
+    // Wait for the complete request header
+    QByteArray request = socket->peek(maxRequestSize);
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        if (request.size() >= maxRequestSize)
+            socket->close();
+        return;
+    }
+    socket->readAll();
+
+    QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray status, body;
+    if (requestLine.value(0) != "GET") {
+        status = "405 Method Not Allowed";
+    }
+    else {
+        status = "200 OK";
+        updateProcessMetrics();
+        updateConnectionQueueMetrics();
+        body = Metrics::exposition();
+    }
+
+    socket->write("HTTP/1.0 " + status + "\r\n"
+                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n"
+                  "\r\n");
+    socket->write(body);
+    // Closing the socket flushes the response first
+    socket->close();
+}
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QLocalServer>
+#include <QObject>
+#include <QTcpServer>
+
+/**
+ * Serves the core's metrics (see Metrics) over HTTP in the Prometheus text format.
+ *
+ * Depending on the --metrics-port and --metrics-socket options, the server listens on the loopback
+ * interfaces and/or a UNIX domain socket. Any GET request is answered with the current metrics.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    MetricsServer(QObject *parent = nullptr);
+
+    bool startListening();
+    void stopListening(const QString &msg);
+
+private slots:
+    void incomingConnection();
+    void incomingLocalConnection();
+    void respond();
+
+private:
+    void setupSocket(QIODevice *socket);
+
+    QTcpServer _server, _v6server;
+    QLocalServer _localServer;
+};
@@ -22,8 +22,6 @@
 #include "network.h"
 #include "util.h"
 
-#include <QRegExp>
-
 Netsplit::Netsplit(Network *network, QObject *parent)
     : QObject(parent),
     _network(network), _quitMsg(""), _sentQuit(false), _joinCounter(0), _quitCounter(0)
@@ -46,8 +44,13 @@ void Netsplit::userQuit(const QString &sender, const QStringList &channels, cons
 {
     if (_quitMsg.isEmpty())
         _quitMsg = msg;
+    const QString nick = nickFromMask(sender).toLower();
     foreach(QString channel, channels) {
-        _quits[channel].append(sender);
+        Quits &quits = _quits[channel];
+        if (!quits.nicks.contains(nick)) {
+            quits.nicks.insert(nick, quits.senders.count());
+            quits.senders.append(sender);
+        }
     }
     _quitCounter++;
     // now let's wait 10s to finish the netsplit-quit
@@ -57,27 +60,27 @@ void Netsplit::userQuit(const QString &sender, const QStringList &channels, cons
 
 bool Netsplit::userJoined(const QString &sender, const QString &channel)
 {
-    if (!_quits.contains(channel))
+    auto quitsIter = _quits.find(channel);
+    if (quitsIter == _quits.end())
         return false;
 
-    QStringList &users = _quits[channel];
-
-    QStringList::iterator userIter;
-    const QString senderNick = nickFromMask(sender);
-    for (userIter = users.begin(); userIter != users.end(); ++userIter) {
-        if (nickFromMask(*userIter) == senderNick)
-            break;
-    }
-    if (userIter == users.end())
+    Quits &quits = quitsIter.value();
+    auto nickIter = quits.nicks.find(nickFromMask(sender).toLower());
+    if (nickIter == quits.nicks.end())
         return false;
 
-    _joins[channel].first.append(*userIter);
-    _joins[channel].second.append(QString());
+    // keep the positions of the other users valid
+    QString quitSender = quits.senders.at(nickIter.value());
+    quits.senders[nickIter.value()].clear();
+    quits.nicks.erase(nickIter);
 
-    users.erase(userIter);
+    Joins &joins = _joins[channel];
+    joins.index.insert(quitSender, joins.senders.count());
+    joins.senders.append(quitSender);
+    joins.modes.append(QString());
 
-    if (users.empty())
-        _quits.remove(channel);
+    if (quits.nicks.isEmpty())
+        _quits.erase(quitsIter);
 
     _joinCounter++;
 
@@ -92,20 +95,48 @@ bool Netsplit::userJoined(const QString &sender, const QString &channel)
 
 bool Netsplit::userAlreadyJoined(const QString &sender, const QString &channel)
 {
-    if (_joins.value(channel).first.contains(sender))
-        return true;
-    return false;
+    auto joinsIter = _joins.constFind(channel);
+    return joinsIter != _joins.constEnd() && joinsIter->index.contains(sender);
 }
 
 
 void Netsplit::addMode(const QString &sender, const QString &channel, const QString &mode)
 {
-    if (!_joins.contains(channel))
+    auto joinsIter = _joins.find(channel);
+    if (joinsIter == _joins.end())
         return;
-    int idx = _joins.value(channel).first.indexOf(sender);
-    if (idx == -1)
+    auto indexIter = joinsIter->index.constFind(sender);
+    if (indexIter == joinsIter->index.constEnd())
         return;
-    _joins[channel].second[idx].append(mode);
+    joinsIter->modes[indexIter.value()].append(mode);
+}
+
+
+//! Checks if the part of \a str from \a start to \a end looks like a server name in a netsplit message
+static bool isSplitHost(const QString &str, int start, int end)
+{
+    if (end - start < 3)
+        return false;
+
+    // Same as the pattern (?:[\w\d-.]+|\*)\.[\w\d-]+, i.e. a host name, or a wildcard followed by a top-level domain
+    auto isHostChar = [](QChar c) {
+        return c.isLetterOrNumber() || c.isMark() || c == '_' || c == '-';
+    };
+
+    int dot = str.lastIndexOf('.', end - 1);
+    if (dot <= start || dot == end - 1)
+        return false;
+    for (int i = dot + 1; i < end; ++i) {
+        if (!isHostChar(str.at(i)))
+            return false;
+    }
+    if (dot - start == 1 && str.at(start) == '*')
+        return true;
+    for (int i = start; i < dot; ++i) {
+        if (!isHostChar(str.at(i)) && str.at(i) != '.')
+            return false;
+    }
+    return true;
 }
 
 
@@ -117,11 +148,13 @@ bool Netsplit::isNetsplit(const QString &quitMessage)
 
     // now test if message consists only of two dns names as the RFC requests
     // but also allow the commonly used "*.net *.split"
-    QRegExp hostRx("^(?:[\\w\\d-.]+|\\*)\\.[\\w\\d-]+\\s(?:[\\w\\d-.]+|\\*)\\.[\\w\\d-]+$");
-    if (hostRx.exactMatch(quitMessage))
-        return true;
+    int space = 0;
+    while (space < quitMessage.length() && !quitMessage.at(space).isSpace())
+        ++space;
+    if (space == quitMessage.length())
+        return false;
 
-    return false;
+    return isSplitHost(quitMessage, 0, space) && isSplitHost(quitMessage, space + 1, quitMessage.length());
 }
 
 
@@ -132,7 +165,7 @@ void Netsplit::joinTimeout()
         quitTimeout();
     }
 
-    QHash<QString, QPair<QStringList, QStringList> >::iterator it;
+    QHash<QString, Joins>::const_iterator it;
 
     /*
       Try to catch server jumpers.
@@ -143,8 +176,8 @@ void Netsplit::joinTimeout()
       join again.
     */
     if (_joinCounter < _quitCounter/3) {
-        for (it = _joins.begin(); it != _joins.end(); ++it)
-            emit earlyJoin(network(), it.key(), it.value().first, it.value().second);
+        for (it = _joins.constBegin(); it != _joins.constEnd(); ++it)
+            emit earlyJoin(network(), it.key(), it->senders, it->modes);
 
         // we don't care about those anymore
         _joins.clear();
@@ -157,8 +190,8 @@ void Netsplit::joinTimeout()
     }
 
     // send netsplitJoin for every recorded channel
-    for (it = _joins.begin(); it != _joins.end(); ++it)
-        emit netsplitJoin(network(), it.key(), it.value().first, it.value().second, _quitMsg);
+    for (it = _joins.constBegin(); it != _joins.constEnd(); ++it)
+        emit netsplitJoin(network(), it.key(), it->senders, it->modes, _quitMsg);
     _joins.clear();
     _discardTimer.stop();
     emit finished();
@@ -168,14 +201,15 @@ void Netsplit::joinTimeout()
 void Netsplit::quitTimeout()
 {
     // send netsplitQuit for every recorded channel
-    QHash<QString, QStringList>::iterator channelIter;
-    for (channelIter = _quits.begin(); channelIter != _quits.end(); ++channelIter) {
+    QHash<QString, Quits>::const_iterator channelIter;
+    for (channelIter = _quits.constBegin(); channelIter != _quits.constEnd(); ++channelIter) {
         QStringList usersToSend;
+        QSet<QString> &quitsWithMessageSent = _quitsWithMessageSent[channelIter.key()];
 
-        foreach(QString user, channelIter.value()) {
-            if (!_quitsWithMessageSent.value(channelIter.key()).contains(user)) {
+        foreach(QString user, channelIter->senders) {
+            if (!user.isEmpty() && !quitsWithMessageSent.contains(user)) {
                 usersToSend << user;
-                _quitsWithMessageSent[channelIter.key()].append(user);
+                quitsWithMessageSent.insert(user);
             }
         }
         // not yet sure how that could happen, but never send empty netsplit-quits
@@ -23,7 +23,7 @@
 
 #include <QTimer>
 #include <QHash>
-#include <QPair>
+#include <QSet>
 #include <QStringList>
 
 class Network;
@@ -124,13 +124,25 @@ private slots:
     void quitTimeout();
 
 private:
+    //! Users of a channel that quit, in order; senders that joined again are cleared
+    struct Quits {
+        QStringList senders;
+        QHash<QString, int> nicks;  ///< lowercase nick -> index in senders
+    };
+
+    //! Users of a channel that joined again, in order, and the modes they got since
+    struct Joins {
+        QStringList senders;
+        QStringList modes;
+        QHash<QString, int> index;  ///< sender -> index in senders and modes
+    };
+
     Network *_network;
     QString _quitMsg;
     // key: channel name
-    // value: senderstring, list of modes
-    QHash<QString, QPair<QStringList, QStringList> > _joins;
-    QHash<QString, QStringList> _quits;
-    QHash<QString, QStringList> _quitsWithMessageSent;
+    QHash<QString, Joins> _joins;
+    QHash<QString, Quits> _quits;
+    QHash<QString, QSet<QString> > _quitsWithMessageSent;
     bool _sentQuit;
     QTimer _joinTimer;
     QTimer _quitTimer;
@@ -20,12 +20,18 @@
 
 #include "postgresqlstorage.h"
 
+#include <algorithm>
+#include <limits>
+
 #include <QtSql>
 
 #include "logmessage.h"
+#include "metrics.h"
 #include "network.h"
 #include "quassel.h"
 
+int PostgreSqlStorage::_maxMessageBatchSize = 500;
+
 PostgreSqlStorage::PostgreSqlStorage(QObject *parent)
     : AbstractSqlStorage(parent),
     _port(-1)
@@ -143,6 +149,25 @@ bool PostgreSqlStorage::initDbSession(QSqlDatabase &db)
         return false;
     }
 
+    // This is a fresh session, so nothing is prepared yet
+    {
+        QMutexLocker locker(&_preparedQueriesMutex);
+        _preparedQueries.remove(db.connectionName());
+    }
+
+    // Prepare the statements of the message hot path right away, so executing them doesn't cost any
+    // extra round trips later. Only do this for an up-to-date schema; otherwise (i.e. before setup
+    // or a schema upgrade), statements are prepared on first use.
+    QSqlQuery schemaQuery = db.exec("SELECT value FROM coreinfo WHERE key = 'schemaversion'");
+    if (!schemaQuery.lastError().isValid() && schemaQuery.first() && schemaQuery.value(0).toInt() == schemaVersion()) {
+        static const QStringList hotQueries = QStringList()
+            << "select_senderid" << "select_senderids" << "insert_sender" << "insert_message" << "insert_messages"
+            << "select_messagesNewestK" << "select_messagesNewerThan" << "select_messagesRange";
+        foreach(const QString &queryname, hotQueries) {
+            prepareStatement(queryname, db, false);
+        }
+    }
+
     return true;
 }
 
@@ -1672,8 +1697,44 @@ bool PostgreSqlStorage::logMessages(MessageList &msgs)
         return false;
     }
 
-    QList<int> senderIdList;
+    // The batch statements are prepared when the connection is initialized; if that didn't work out
+    // (e.g. the server is too old for multi-argument unnest()), fall back to one statement per row.
+    bool batchInsert = isPrepared("select_senderids", db) && isPrepared("insert_messages", db);
+
+    QList<qint64> senderIdList;
     QHash<SenderData, qint64> senderIds;
+    if (batchInsert) {
+        // Look up all known senders with a single query, only unknown ones are added one by one below
+        QSet<SenderData> senders;
+        QVariantList senderNames, realNames, avatarUrls;
+        for (int i = 0; i < msgs.count(); i++) {
+            auto &msg = msgs.at(i);
+            SenderData sender = { msg.sender(), msg.realName(), msg.avatarUrl() };
+            if (senders.contains(sender))
+                continue;
+            senders << sender;
+            senderNames << sender.sender;
+            realNames << sender.realname;
+            avatarUrls << sender.avatarurl;
+        }
+
+        QStringList arrays;
+        arrays << formatArray(senderNames, "text", db)
+               << formatArray(realNames, "text", db)
+               << formatArray(avatarUrls, "text", db);
+        QSqlQuery selectSendersQuery = prepareAndExecuteQuery("select_senderids", arrays.join(", "), db);
+        if (!watchQuery(selectSendersQuery)) {
+            db.rollback();
+            return false;
+        }
+        while (selectSendersQuery.next()) {
+            SenderData sender = { selectSendersQuery.value(1).toString(),
+                                  selectSendersQuery.value(2).toString(),
+                                  selectSendersQuery.value(3).toString() };
+            senderIds[sender] = selectSendersQuery.value(0).toLongLong();
+        }
+    }
+
     QSqlQuery addSenderQuery;
     QSqlQuery selectSenderQuery;;
     for (int i = 0; i < msgs.count(); i++) {
@@ -1717,31 +1778,78 @@ bool PostgreSqlStorage::logMessages(MessageList &msgs)
 
     // yes we loop twice over the same list. This avoids alternating queries.
     bool error = false;
-    for (int i = 0; i < msgs.count(); i++) {
-        Message &msg = msgs[i];
-        QVariantList params;
-        // PostgreSQL handles QDateTime()'s serialized format by default, and QDateTime() serializes
-        // to a 64-bit time compatible format by default.
-        params << msg.timestamp()
-               << msg.bufferInfo().bufferId().toInt()
-               << msg.type()
-               << (int)msg.flags()
-               << senderIdList.at(i)
-               << msg.senderPrefixes()
-               << msg.contents();
-        QSqlQuery logMessageQuery = executePreparedQuery("insert_message", params, db);
-        if (!watchQuery(logMessageQuery)) {
-            db.rollback();
-            error = true;
-            break;
+    if (batchInsert) {
+        for (int offset = 0; offset < msgs.count() && !error; offset += _maxMessageBatchSize) {
+            int count = qMin(_maxMessageBatchSize, msgs.count() - offset);
+            QVariantList times, bufferIds, types, flags, senders, senderPrefixes, contents;
+            for (int i = offset; i < offset + count; i++) {
+                const Message &msg = msgs.at(i);
+                times << msg.timestamp();
+                bufferIds << msg.bufferInfo().bufferId().toInt();
+                types << msg.type();
+                flags << (int)msg.flags();
+                senders << senderIdList.at(i);
+                senderPrefixes << msg.senderPrefixes();
+                contents << msg.contents();
+            }
+
+            QStringList arrays;
+            arrays << formatArray(times, "timestamp", db)
+                   << formatArray(bufferIds, "integer", db)
+                   << formatArray(types, "integer", db)
+                   << formatArray(flags, "integer", db)
+                   << formatArray(senders, "bigint", db)
+                   << formatArray(senderPrefixes, "text", db)
+                   << formatArray(contents, "text", db);
+            QSqlQuery logMessagesQuery = prepareAndExecuteQuery("insert_messages", arrays.join(", "), db);
+            if (!watchQuery(logMessagesQuery)) {
+                error = true;
+                break;
+            }
+
+            // The rows are inserted in the order unnest() yields them, so the ids drawn from the
+            // sequence ascend in message order; RETURNING doesn't promise any order though.
+            QList<qint64> msgIds;
+            while (logMessagesQuery.next())
+                msgIds << logMessagesQuery.value(0).toLongLong();
+            if (msgIds.count() != count) {
+                qWarning() << "PostgreSqlStorage::logMessages(): expected" << count << "message ids, got" << msgIds.count();
+                error = true;
+                break;
+            }
+            std::sort(msgIds.begin(), msgIds.end());
+            for (int i = 0; i < count; i++) {
+                msgs[offset + i].setMsgId(msgIds.at(i));
+            }
         }
-        else {
-            logMessageQuery.first();
-            msg.setMsgId(logMessageQuery.value(0).toLongLong());
+    }
+    else {
+        for (int i = 0; i < msgs.count(); i++) {
+            Message &msg = msgs[i];
+            QVariantList params;
+            // PostgreSQL handles QDateTime()'s serialized format by default, and QDateTime() serializes
+            // to a 64-bit time compatible format by default.
+            params << msg.timestamp()
+                   << msg.bufferInfo().bufferId().toInt()
+                   << msg.type()
+                   << (int)msg.flags()
+                   << senderIdList.at(i)
+                   << msg.senderPrefixes()
+                   << msg.contents();
+            QSqlQuery logMessageQuery = executePreparedQuery("insert_message", params, db);
+            if (!watchQuery(logMessageQuery)) {
+                error = true;
+                break;
+            }
+            else {
+                logMessageQuery.first();
+                msg.setMsgId(logMessageQuery.value(0).toLongLong());
+            }
         }
     }
 
     if (error) {
+        db.rollback();
         // we had a rollback in the db so we need to reset all msgIds
         for (int i = 0; i < msgs.count(); i++) {
             msgs[i].setMsgId(MsgId());
@@ -2009,6 +2117,83 @@ QList<Message> PostgreSqlStorage::requestAllMsgsFiltered(UserId user, MsgId firs
     return messagelist;
 }
 
+MsgId PostgreSqlStorage::expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount)
+{
+    MsgId expiredId;
+    QSqlDatabase db = logDb();
+    if (before.isValid()) {
+        QSqlQuery query(db);
+        query.prepare(queryString("select_expired_msgid_by_age"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":time", before);
+        safeExec(query);
+        watchQuery(query);
+        if (query.first() && !query.value(0).isNull())
+            expiredId = query.value(0).toLongLong();
+    }
+    if (keepCount > 0) {
+        QSqlQuery query(db);
+        query.prepare(queryString("select_expired_msgid_by_count"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":keepcount", keepCount);
+        safeExec(query);
+        watchQuery(query);
+        if (query.first() && query.value(0).toLongLong() > expiredId.toQint64())
+            expiredId = query.value(0).toLongLong();
+    }
+    return expiredId;
+}
+
+
+MsgId PostgreSqlStorage::oversizedMsgId(UserId user, qint64 maxSize)
+{
+    // Walk the backlog in pages, so we don't need to keep a huge result set around
+    const int pageSize = 10000;
+    qint64 size = 0;
+    qint64 lastMsgId = std::numeric_limits<qint64>::max();
+    forever {
+        QSqlQuery query(logDb());
+        query.setForwardOnly(true);
+        query.prepare(queryString("select_message_sizes"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":lastmsg", lastMsgId);
+        query.bindValue(":limit", pageSize);
+        safeExec(query);
+        if (!watchQuery(query))
+            return MsgId();
+
+        int rows = 0;
+        while (query.next()) {
+            rows++;
+            lastMsgId = query.value(0).toLongLong();
+            size += query.value(1).toLongLong();
+            if (size > maxSize)
+                return lastMsgId;
+        }
+        if (rows < pageSize)
+            return MsgId();
+    }
+}
+
+
+int PostgreSqlStorage::deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last)
+{
+    QSqlQuery query(logDb());
+    query.prepare(queryString("delete_backlog_range"));
+    query.bindValue(":userid", user.toInt());
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":firstmsg", first.toQint64());
+    query.bindValue(":lastmsg", last.toQint64());
+    safeExec(query);
+    if (!watchQuery(query))
+        return -1;
+
+    return query.numRowsAffected();
+}
+
+
 QMap<UserId, QString> PostgreSqlStorage::getAllAuthUserNames()
 {
     QMap<UserId, QString> authusernames;
@@ -2084,80 +2269,98 @@ bool PostgreSqlStorage::beginReadOnlyTransaction(QSqlDatabase &db)
 }
 
 
-QSqlQuery PostgreSqlStorage::prepareAndExecuteQuery(const QString &queryname, const QString &paramstring, QSqlDatabase &db)
+bool PostgreSqlStorage::isPrepared(const QString &queryname, const QSqlDatabase &db)
 {
-    // Query preparing is done lazily. That means that instead of always checking if the query is already prepared
-    // we just EXECUTE and catch the error
-    QSqlQuery query;
+    QMutexLocker locker(&_preparedQueriesMutex);
+    return _preparedQueries.value(db.connectionName()).contains(queryname);
+}
 
-    db.exec("SAVEPOINT quassel_prepare_query");
-    if (paramstring.isNull()) {
-        query = db.exec(QString("EXECUTE quassel_%1").arg(queryname));
-    }
-    else {
-        query = db.exec(QString("EXECUTE quassel_%1 (%2)").arg(queryname).arg(paramstring));
-    }
 
-    if (!db.isOpen() || db.lastError().isValid()) {
-        // If the query failed because the DB connection was down, reopen the connection and start a new transaction.
-        if (!db.isOpen()) {
-            db = logDb();
-            if (!beginTransaction(db)) {
-                qWarning() << "PostgreSqlStorage::prepareAndExecuteQuery(): cannot start transaction while recovering from connection loss!";
-                qWarning() << " -" << qPrintable(db.lastError().text());
-                return query;
-            }
-            db.exec("SAVEPOINT quassel_prepare_query");
-        } else {
-            db.exec("ROLLBACK TO SAVEPOINT quassel_prepare_query");
+bool PostgreSqlStorage::prepareStatement(const QString &queryname, QSqlDatabase &db, bool warnOnError)
+{
+    db.exec(QString("PREPARE quassel_%1 AS %2").arg(queryname, queryString(queryname)));
+    if (db.lastError().isValid()) {
+        if (warnOnError) {
+            qWarning() << "PostgreSqlStorage::prepareStatement(): unable to prepare query:" << queryname << "AS" << queryString(queryname);
+            qWarning() << "  Error:" << db.lastError().text();
         }
+        return false;
+    }
 
-        // and once again: Qt leaves us without error codes so we either parse (language dependent(!)) strings
-        // or we just guess the error. As we're only interested in unprepared queries, this will be our guess. :)
-        QSqlQuery checkQuery = db.exec(QString("SELECT count(name) FROM pg_prepared_statements WHERE name = 'quassel_%1' AND from_sql = TRUE").arg(queryname.toLower()));
-        checkQuery.first();
-        if (checkQuery.value(0).toInt() == 0) {
-            db.exec(QString("PREPARE quassel_%1 AS %2").arg(queryname).arg(queryString(queryname)));
-            if (db.lastError().isValid()) {
-                qWarning() << "PostgreSqlStorage::prepareQuery(): unable to prepare query:" << queryname << "AS" << queryString(queryname);
-                qWarning() << "  Error:" << db.lastError().text();
-                return QSqlQuery(db);
-            }
-        }
-        // we always execute the query again, even if the query was already prepared.
-        // this ensures, that the error is properly propagated to the calling function
-        // (otherwise the last call would be the testing select to pg_prepared_statements
-        // which always gives a proper result and the error would be lost)
-        if (paramstring.isNull()) {
-            query = db.exec(QString("EXECUTE quassel_%1").arg(queryname));
-        }
-        else {
-            query = db.exec(QString("EXECUTE quassel_%1 (%2)").arg(queryname).arg(paramstring));
+    QMutexLocker locker(&_preparedQueriesMutex);
+    _preparedQueries[db.connectionName()].insert(queryname);
+    return true;
+}
+
+
+QSqlQuery PostgreSqlStorage::prepareAndExecuteQuery(const QString &queryname, const QString &paramstring, QSqlDatabase &db)
+{
+    // We keep track of the statements prepared on each connection, and the frequently used ones are
+    // prepared right when the connection is established (see initDbSession()). So usually this is a
+    // single EXECUTE, without any savepoints or probing for unprepared statements.
+    if (!isPrepared(queryname, db) && !prepareStatement(queryname, db))
+        return QSqlQuery(db);
+
+    QString statement;
+    if (paramstring.isNull())
+        statement = QString("EXECUTE quassel_%1").arg(queryname);
+    else
+        statement = QString("EXECUTE quassel_%1 (%2)").arg(queryname, paramstring);
+
+    QElapsedTimer timer;
+    if (Metrics::isEnabled())
+        timer.start();
+
+    QSqlQuery query = db.exec(statement);
+    if (!db.isOpen()) {
+        // If the query failed because the DB connection was down, reopen the connection and start a new transaction.
+        // Reconnecting initializes the session again, which takes care of re-preparing our statements.
+        db = logDb();
+        if (!beginTransaction(db)) {
+            qWarning() << "PostgreSqlStorage::prepareAndExecuteQuery(): cannot start transaction while recovering from connection loss!";
+            qWarning() << " -" << qPrintable(db.lastError().text());
+            return query;
         }
+        if (!isPrepared(queryname, db) && !prepareStatement(queryname, db))
+            return QSqlQuery(db);
+        query = db.exec(statement);
     }
-    else {
-        // only release the SAVEPOINT
-        db.exec("RELEASE SAVEPOINT quassel_prepare_query");
-    }
+
+    if (timer.isValid())
+        observeQueryTime(queryname, timer);
     return query;
 }
 
 
-QSqlQuery PostgreSqlStorage::executePreparedQuery(const QString &queryname, const QVariantList &params, QSqlDatabase &db)
+QString PostgreSqlStorage::formatValue(const QVariant &value, const QSqlDatabase &db)
+{
+    QSqlField field;
+    field.setType(value.type());
+    if (value.isNull())
+        field.clear();
+    else
+        field.setValue(value);
+
+    return db.driver()->formatValue(field);
+}
+
+
+QString PostgreSqlStorage::formatArray(const QVariantList &values, const QString &type, const QSqlDatabase &db)
 {
-    QSqlDriver *driver = db.driver();
+    QStringList elements;
+    foreach(const QVariant &value, values) {
+        elements << formatValue(value, db);
+    }
+    // an explicit cast is needed, as e.g. text[] is not implicitly converted to timestamp[]
+    return QString("ARRAY[%1]::%2[]").arg(elements.join(", "), type);
+}
+
 
+QSqlQuery PostgreSqlStorage::executePreparedQuery(const QString &queryname, const QVariantList &params, QSqlDatabase &db)
+{
     QStringList paramStrings;
-    QSqlField field;
     for (int i = 0; i < params.count(); i++) {
-        const QVariant &value = params.at(i);
-        field.setType(value.type());
-        if (value.isNull())
-            field.clear();
-        else
-            field.setValue(value);
-
-        paramStrings << driver->formatValue(field);
+        paramStrings << formatValue(params.at(i), db);
     }
 
     if (params.isEmpty()) {
@@ -2171,26 +2374,25 @@ QSqlQuery PostgreSqlStorage::executePreparedQuery(const QString &queryname, cons
 
 QSqlQuery PostgreSqlStorage::executePreparedQuery(const QString &queryname, const QVariant &param, QSqlDatabase &db)
 {
-    QSqlField field;
-    field.setType(param.type());
-    if (param.isNull())
-        field.clear();
-    else
-        field.setValue(param);
-
-    QString paramString = db.driver()->formatValue(field);
-    return prepareAndExecuteQuery(queryname, paramString, db);
+    return prepareAndExecuteQuery(queryname, formatValue(param, db), db);
 }
 
 
 void PostgreSqlStorage::deallocateQuery(const QString &queryname, const QSqlDatabase &db)
 {
     db.exec(QString("DEALLOCATE quassel_%1").arg(queryname));
+
+    QMutexLocker locker(&_preparedQueriesMutex);
+    _preparedQueries[db.connectionName()].remove(queryname);
 }
 
 
 void PostgreSqlStorage::safeExec(QSqlQuery &query)
 {
+    QElapsedTimer timer;
+    if (Metrics::isEnabled())
+        timer.start();
+
     // If the query fails due to the connection being gone, it seems to cause
     // exec() to return false but no lastError to be set
     if(!query.exec() && !query.lastError().isValid())
@@ -2207,6 +2409,9 @@ void PostgreSqlStorage::safeExec(QSqlQuery &query)
         query = retryQuery;
         query.exec();
     }
+
+    if (timer.isValid())
+        observeQueryTime(queryName(query.lastQuery()), timer);
 }
 
 // ========================================
@@ -2242,8 +2447,8 @@ bool PostgreSqlMigrationWriter::prepareQuery(MigrationObject mo)
         query = queryString("migrate_write_buffer");
         break;
     case Backlog:
-        query = queryString("migrate_write_backlog");
-        break;
+        // the backlog is written in chunks by writeBacklog()
+        return false;
     case IrcServer:
         query = queryString("migrate_write_ircserver");
         break;
@@ -2383,21 +2588,6 @@ bool PostgreSqlMigrationWriter::writeMo(const BufferMO &buffer)
 }
 
 
-//bool PostgreSqlMigrationWriter::writeBacklog(const BacklogMO &backlog) {
-bool PostgreSqlMigrationWriter::writeMo(const BacklogMO &backlog)
-{
-    bindValue(0, backlog.messageid.toQint64());
-    bindValue(1, backlog.time);
-    bindValue(2, backlog.bufferid.toInt());
-    bindValue(3, backlog.type);
-    bindValue(4, (int)backlog.flags);
-    bindValue(5, backlog.senderid);
-    bindValue(6, backlog.senderprefixes);
-    bindValue(7, backlog.message);
-    return exec();
-}
-
-
 //bool PostgreSqlMigrationWriter::writeIrcServer(const IrcServerMO &ircserver) {
 bool PostgreSqlMigrationWriter::writeMo(const IrcServerMO &ircserver)
 {
@@ -2437,9 +2627,130 @@ bool PostgreSqlMigrationWriter::writeMo(const CoreStateMO &coreState)
 }
 
 
+bool PostgreSqlMigrationWriter::writeBacklog(qint64 first, qint64 last, const QList<BacklogMO> &backlog)
+{
+    QSqlDatabase db = logDb();
+    if (!beginTransaction(db)) {
+        qWarning() << "PostgreSqlMigrationWriter::writeBacklog(): cannot start transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return false;
+    }
+
+    // Clear the range first, it might have been written already by an interrupted migration
+    QSqlQuery deleteQuery(db);
+    deleteQuery.prepare(queryString("migrate_delete_backlog_range"));
+    deleteQuery.bindValue(0, first);
+    deleteQuery.bindValue(1, last);
+    safeExec(deleteQuery);
+    if (!watchQuery(deleteQuery)) {
+        db.rollback();
+        return false;
+    }
+
+    for (int offset = 0; offset < backlog.count(); offset += _maxMessageBatchSize) {
+        int count = qMin(_maxMessageBatchSize, backlog.count() - offset);
+        QVariantList messageIds, times, bufferIds, types, flags, senderIds, senderPrefixes, messages;
+        for (int i = offset; i < offset + count; i++) {
+            const BacklogMO &mo = backlog.at(i);
+            messageIds << mo.messageid.toQint64();
+            times << mo.time;
+            bufferIds << mo.bufferid.toInt();
+            types << mo.type;
+            flags << mo.flags;
+            senderIds << mo.senderid;
+            senderPrefixes << mo.senderprefixes;
+            messages << mo.message;
+        }
+
+        QStringList arrays;
+        arrays << formatArray(messageIds, "bigint", db)
+               << formatArray(times, "timestamp", db)
+               << formatArray(bufferIds, "integer", db)
+               << formatArray(types, "integer", db)
+               << formatArray(flags, "integer", db)
+               << formatArray(senderIds, "bigint", db)
+               << formatArray(senderPrefixes, "text", db)
+               << formatArray(messages, "text", db);
+        QSqlQuery writeQuery = prepareAndExecuteQuery("migrate_write_backlog_batch", arrays.join(", "), db);
+        if (!watchQuery(writeQuery)) {
+            db.rollback();
+            return false;
+        }
+    }
+
+    return db.commit();
+}
+
+
+qint64 PostgreSqlMigrationWriter::backlogCheckpoint()
+{
+    QSqlQuery query(logDb());
+    query.prepare("SELECT value FROM coreinfo WHERE key = 'migration_backlog_checkpoint'");
+    safeExec(query);
+    watchQuery(query);
+    if (query.first())
+        return query.value(0).toLongLong();
+
+    return -1;
+}
+
+
+bool PostgreSqlMigrationWriter::setBacklogCheckpoint(qint64 msgId)
+{
+    QSqlQuery query(logDb());
+    query.prepare("UPDATE coreinfo SET value = :checkpoint WHERE key = 'migration_backlog_checkpoint'");
+    query.bindValue(":checkpoint", msgId);
+    safeExec(query);
+    if (!watchQuery(query))
+        return false;
+
+    if (query.numRowsAffected() == 0) {
+        query.prepare("INSERT INTO coreinfo (key, value) VALUES ('migration_backlog_checkpoint', :checkpoint)");
+        query.bindValue(":checkpoint", msgId);
+        safeExec(query);
+        return watchQuery(query);
+    }
+    return true;
+}
+
+
+bool PostgreSqlMigrationWriter::clearBacklogCheckpoint()
+{
+    QSqlQuery query(logDb());
+    query.prepare("DELETE FROM coreinfo WHERE key = 'migration_backlog_checkpoint'");
+    safeExec(query);
+    return watchQuery(query);
+}
+
+
+bool PostgreSqlMigrationWriter::preProcess()
+{
+    // The trigger keeps buffer.lastmsgid up to date row by row, which makes concurrent chunks contend
+    // for (and deadlock on) the buffer rows. postProcess() recalculates lastmsgid anyway.
+    resetQuery();
+    newQuery("ALTER TABLE backlog DISABLE TRIGGER backlog_lastmsgid_update_trigger", logDb());
+    return exec();
+}
+
+
+bool PostgreSqlMigrationWriter::abortProcess()
+{
+    // Don't leave the trigger disabled should the migration be abandoned; resuming it disables it again
+    resetQuery();
+    newQuery("ALTER TABLE backlog ENABLE TRIGGER backlog_lastmsgid_update_trigger", logDb());
+    return exec();
+}
+
+
 bool PostgreSqlMigrationWriter::postProcess()
 {
     QSqlDatabase db = logDb();
+
+    resetQuery();
+    newQuery("ALTER TABLE backlog ENABLE TRIGGER backlog_lastmsgid_update_trigger", db);
+    if (!exec())
+        return false;
+
     QList<Sequence> sequences;
     sequences << Sequence("backlog", "messageid")
               << Sequence("buffer", "bufferid")
@@ -22,6 +22,9 @@
 
 #include "abstractsqlstorage.h"
 
+#include <QHash>
+#include <QMutex>
+#include <QSet>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 
@@ -43,8 +46,6 @@ public slots:
     QString description() const override;
     QVariantList setupData() const override;
 
-    // TODO: Add functions for configuring the backlog handling, i.e. defining auto-cleanup settings etc
-
     /* User handling */
 
     UserId addUser(const QString &user, const QString &password, const QString &authenticator = "Database") override;
@@ -118,6 +119,11 @@ public slots:
                                           Message::Types type = Message::Types{-1},
                                           Message::Flags flags = Message::Flags{-1}) override;
 
+    /* Backlog retention */
+    MsgId expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount) override;
+    MsgId oversizedMsgId(UserId user, qint64 maxSize) override;
+    int deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last) override;
+
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
     QString getAuthUserName(UserId user) override;
@@ -141,6 +147,12 @@ protected:
     bool beginTransaction(QSqlDatabase &db);
     bool beginReadOnlyTransaction(QSqlDatabase &db);
 
+    QString formatValue(const QVariant &value, const QSqlDatabase &db);
+    //! Format a list of values as an SQL array literal of the given element type, e.g. ARRAY[1, 2]::integer[]
+    QString formatArray(const QVariantList &values, const QString &type, const QSqlDatabase &db);
+
+    QSqlQuery prepareAndExecuteQuery(const QString &queryname, const QString &paramstring, QSqlDatabase &db);
+    QSqlQuery prepareAndExecuteQuery(const QString &queryname, QSqlDatabase &db) { return prepareAndExecuteQuery(queryname, QString(), db); }
     QSqlQuery executePreparedQuery(const QString &queryname, const QVariantList &params, QSqlDatabase &db);
     QSqlQuery executePreparedQuery(const QString &queryname, const QVariant &param, QSqlDatabase &db);
     void deallocateQuery(const QString &queryname, const QSqlDatabase &db);
@@ -149,17 +161,26 @@ protected:
     void rollbackSavePoint(const QString &handle, const QSqlDatabase &db) { db.exec(QString("ROLLBACK TO SAVEPOINT %1").arg(handle)); }
     void releaseSavePoint(const QString &handle, const QSqlDatabase &db) { db.exec(QString("RELEASE SAVEPOINT %1").arg(handle)); }
 
+    //! Maximum number of messages written by a single statement
+    static int _maxMessageBatchSize;
+
 private:
     void bindNetworkInfo(QSqlQuery &query, const NetworkInfo &info);
     void bindServerInfo(QSqlQuery &query, const Network::Server &server);
-    QSqlQuery prepareAndExecuteQuery(const QString &queryname, const QString &paramstring, QSqlDatabase &db);
-    QSqlQuery prepareAndExecuteQuery(const QString &queryname, QSqlDatabase &db) { return prepareAndExecuteQuery(queryname, QString(), db); }
+
+    //! Check whether a query has already been prepared as quassel_<queryname> on the given connection
+    bool isPrepared(const QString &queryname, const QSqlDatabase &db);
+    bool prepareStatement(const QString &queryname, QSqlDatabase &db, bool warnOnError = true);
 
     QString _hostName;
     int _port;
     QString _databaseName;
     QString _userName;
     QString _password;
+
+    // Prepared statements are per connection, i.e. per thread; keyed by connection name
+    QHash<QString, QSet<QString>> _preparedQueries;
+    QMutex _preparedQueriesMutex;
 };
 
 
@@ -179,14 +200,21 @@ public:
     bool writeMo(const IdentityNickMO &identityNick) override;
     bool writeMo(const NetworkMO &network) override;
     bool writeMo(const BufferMO &buffer) override;
-    bool writeMo(const BacklogMO &backlog) override;
     bool writeMo(const IrcServerMO &ircserver) override;
     bool writeMo(const UserSettingMO &userSetting) override;
     bool writeMo(const CoreStateMO &coreState) override;
 
+    bool writeBacklog(qint64 first, qint64 last, const QList<BacklogMO> &backlog) override;
+
+    qint64 backlogCheckpoint() override;
+    bool setBacklogCheckpoint(qint64 msgId) override;
+    bool clearBacklogCheckpoint() override;
+
     bool prepareQuery(MigrationObject mo) override;
 
+    bool preProcess() override;
     bool postProcess() override;
+    bool abortProcess() override;
 
 protected:
     inline bool transaction()  override { return logDb().transaction(); }
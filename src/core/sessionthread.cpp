@@ -26,8 +26,9 @@
 #include "signalproxy.h"
 
 SessionThread::SessionThread(UserId uid, bool restoreState, bool strictIdentEnabled, QObject *parent)
-    : QThread(parent),
+    : QObject(parent),
     _session(0),
+    _worker(0),
     _user(uid),
     _sessionInitialized(false),
     _restoreState(restoreState),
@@ -39,9 +40,17 @@ SessionThread::SessionThread(UserId uid, bool restoreState, bool strictIdentEnab
 
 SessionThread::~SessionThread()
 {
-    // shut down thread gracefully
-    quit();
-    wait();
+    // shut down the session gracefully
+    if (_worker)
+        _worker->removeSession(this);
+}
+
+
+void SessionThread::start(SessionWorker *worker)
+{
+    Q_ASSERT(!_worker);
+    _worker = worker;
+    _worker->addSession(this);
 }
 
 
@@ -119,13 +128,64 @@ void SessionThread::addInternalClientToSession(InternalPeer *internalPeer)
 }
 
 
-void SessionThread::run()
+void SessionThread::createSession()
 {
     _session = new CoreSession(user(), _restoreState, _strictIdentEnabled);
     connect(this, SIGNAL(addRemoteClient(RemotePeer*)), _session, SLOT(addClient(RemotePeer*)));
     connect(this, SIGNAL(addInternalClient(InternalPeer*)), _session, SLOT(addClient(InternalPeer*)));
     connect(_session, SIGNAL(sessionState(Protocol::SessionState)), Core::instance(), SIGNAL(sessionState(Protocol::SessionState)));
     emit initialized();
-    exec();
+}
+
+
+void SessionThread::destroySession()
+{
     delete _session;
+    _session = 0;
+}
+
+
+// ========================================
+//  SessionWorker
+// ========================================
+SessionWorker::SessionWorker()
+    : QObject()
+{
+    qRegisterMetaType<SessionThread *>("SessionThread*");
+    moveToThread(&_thread);
+    _thread.start();
+}
+
+
+SessionWorker::~SessionWorker()
+{
+    _thread.quit();
+    _thread.wait();
+}
+
+
+void SessionWorker::addSession(SessionThread *session)
+{
+    _sessionCount++;
+    QMetaObject::invokeMethod(this, "createSession", Qt::QueuedConnection, Q_ARG(SessionThread *, session));
+}
+
+
+void SessionWorker::removeSession(SessionThread *session)
+{
+    _sessionCount--;
+    // The session must be gone before its handle is
+    QMetaObject::invokeMethod(this, "destroySession", Qt::BlockingQueuedConnection, Q_ARG(SessionThread *, session));
+}
+
+
+void SessionWorker::createSession(SessionThread *session)
+{
+    session->createSession();
+}
+
+
+void SessionWorker::destroySession(SessionThread *session)
+{
+    session->destroySession();
 }
@@ -30,8 +30,13 @@ class CoreSession;
 class InternalPeer;
 class RemotePeer;
 class QIODevice;
+class SessionWorker;
 
-class SessionThread : public QThread
+//! Handle for a user's CoreSession, living in the Core thread
+/** Sessions don't have a thread of their own; each one is pinned to one of the session workers
+ *  (see SessionWorker), which run all sessions assigned to them in a single thread.
+ */
+class SessionThread : public QObject
 {
     Q_OBJECT
 
@@ -39,10 +44,12 @@ public:
     SessionThread(UserId user, bool restoreState, bool strictIdentEnabled, QObject *parent = 0);
     ~SessionThread();
 
-    void run();
+    //! Create the session in the given worker's thread
+    void start(SessionWorker *worker);
 
     CoreSession *session();
     UserId user();
+    inline SessionWorker *worker() const { return _worker; }
 
 public slots:
     void addClient(QObject *peer);
@@ -59,6 +66,7 @@ signals:
 
 private:
     CoreSession *_session;
+    SessionWorker *_worker;
     UserId _user;
     QList<QObject *> clientQueue;
     bool _sessionInitialized;
@@ -71,6 +79,40 @@ private:
     void addClientToSession(QObject *peer);
     void addRemoteClientToSession(RemotePeer *remotePeer);
     void addInternalClientToSession(InternalPeer *internalPeer);
+
+    // executed in the worker thread
+    void createSession();
+    void destroySession();
+
+    friend class SessionWorker;
+};
+
+
+//! One of the threads running CoreSessions
+/** The worker object itself lives in its thread, so its slots are executed there. Storage
+ *  connections are per thread, so all sessions of a worker share a single database connection.
+ */
+class SessionWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    SessionWorker();
+    ~SessionWorker();
+
+    //! Number of sessions pinned to this worker (only to be used from the Core thread)
+    inline int sessionCount() const { return _sessionCount; }
+
+    void addSession(SessionThread *session);
+    void removeSession(SessionThread *session);
+
+private slots:
+    void createSession(SessionThread *session);
+    void destroySession(SessionThread *session);
+
+private:
+    QThread _thread;
+    int _sessionCount{0};
 };
 
 
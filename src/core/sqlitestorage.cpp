@@ -20,13 +20,18 @@
 
 #include "sqlitestorage.h"
 
+#include <limits>
+
 #include <QtSql>
 
 #include "logmessage.h"
+#include "metrics.h"
 #include "network.h"
 #include "quassel.h"
 
 int SqliteStorage::_maxRetryCount = 150;
+// Each row of insert_message uses 9 placeholders; older SQLite versions allow at most 999 per statement
+int SqliteStorage::_maxMessageBatchSize = 100;
 
 SqliteStorage::SqliteStorage(QObject *parent)
     : AbstractSqlStorage(parent)
@@ -1836,29 +1841,37 @@ bool SqliteStorage::logMessages(MessageList &msgs)
 
     bool error = false;
     {
-        QSqlQuery logMessageQuery(db);
-        logMessageQuery.prepare(queryString("insert_message"));
-        for (int i = 0; i < msgs.count(); i++) {
-            Message &msg = msgs[i];
-            // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
-            // seconds.  This nets us more precision as well as simplifying 64-bit time.
-            logMessageQuery.bindValue(":time", msg.timestamp().toMSecsSinceEpoch());
-            logMessageQuery.bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
-            logMessageQuery.bindValue(":type", msg.type());
-            logMessageQuery.bindValue(":flags", (int)msg.flags());
-            logMessageQuery.bindValue(":sender", msg.sender());
-            logMessageQuery.bindValue(":realname", msg.realName());
-            logMessageQuery.bindValue(":avatarurl", msg.avatarUrl());
-            logMessageQuery.bindValue(":senderprefixes", msg.senderPrefixes());
-            logMessageQuery.bindValue(":message", msg.contents());
-
-            safeExec(logMessageQuery);
-            if (!watchQuery(logMessageQuery)) {
+        // Write the messages in batches of multi-row INSERTs instead of one statement per message
+        for (int offset = 0; offset < msgs.count(); offset += _maxMessageBatchSize) {
+            int count = qMin(_maxMessageBatchSize, msgs.count() - offset);
+            QSqlQuery logMessagesQuery(db);
+            logMessagesQuery.prepare(multiRowQueryString("insert_message", count));
+            for (int i = 0; i < count; i++) {
+                const Message &msg = msgs.at(offset + i);
+                // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+                // seconds.  This nets us more precision as well as simplifying 64-bit time.
+                logMessagesQuery.bindValue(QString(":time_%1").arg(i), msg.timestamp().toMSecsSinceEpoch());
+                logMessagesQuery.bindValue(QString(":bufferid_%1").arg(i), msg.bufferInfo().bufferId().toInt());
+                logMessagesQuery.bindValue(QString(":type_%1").arg(i), msg.type());
+                logMessagesQuery.bindValue(QString(":flags_%1").arg(i), (int)msg.flags());
+                logMessagesQuery.bindValue(QString(":sender_%1").arg(i), msg.sender());
+                logMessagesQuery.bindValue(QString(":realname_%1").arg(i), msg.realName());
+                logMessagesQuery.bindValue(QString(":avatarurl_%1").arg(i), msg.avatarUrl());
+                logMessagesQuery.bindValue(QString(":senderprefixes_%1").arg(i), msg.senderPrefixes());
+                logMessagesQuery.bindValue(QString(":message_%1").arg(i), msg.contents());
+            }
+
+            safeExec(logMessagesQuery);
+            if (!watchQuery(logMessagesQuery)) {
                 error = true;
                 break;
             }
-            else {
-                msg.setMsgId(logMessageQuery.lastInsertId().toLongLong());
+
+            // We hold the write lock inside a transaction, so the rows of a single INSERT get
+            // consecutive ids in the order given, and SQLite reports the one of the last row.
+            qint64 lastMsgId = logMessagesQuery.lastInsertId().toLongLong();
+            for (int i = 0; i < count; i++) {
+                msgs[offset + i].setMsgId(lastMsgId - count + 1 + i);
             }
         }
     }
@@ -1879,6 +1892,21 @@ bool SqliteStorage::logMessages(MessageList &msgs)
 }
 
 
+QString SqliteStorage::multiRowQueryString(const QString &queryName, int rowCount)
+{
+    QString query = queryString(queryName);
+    int valuesEnd = query.indexOf("VALUES", 0, Qt::CaseInsensitive) + 6;
+    QString row = query.mid(valuesEnd).trimmed();
+
+    QStringList rows;
+    for (int i = 0; i < rowCount; i++) {
+        // every row gets its own set of placeholders, e.g. :sender_0, :sender_1, ...
+        rows << QString(row).replace(QRegExp(":(\\w+)"), QString(":\\1_%1").arg(i));
+    }
+    return query.left(valuesEnd) + "\n" + rows.join(",\n");
+}
+
+
 QList<Message> SqliteStorage::requestMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last, int limit)
 {
     QList<Message> messagelist;
@@ -2155,6 +2183,108 @@ QList<Message> SqliteStorage::requestAllMsgsFiltered(UserId user, MsgId first, M
     return messagelist;
 }
 
+MsgId SqliteStorage::expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount)
+{
+    MsgId expiredId;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+    {
+        lockForRead();
+        if (before.isValid()) {
+            QSqlQuery query(db);
+            query.prepare(queryString("select_expired_msgid_by_age"));
+            query.bindValue(":userid", user.toInt());
+            query.bindValue(":bufferid", bufferId.toInt());
+            query.bindValue(":time", before.toMSecsSinceEpoch());
+            safeExec(query);
+            watchQuery(query);
+            if (query.first() && !query.value(0).isNull())
+                expiredId = query.value(0).toLongLong();
+        }
+        if (keepCount > 0) {
+            QSqlQuery query(db);
+            query.prepare(queryString("select_expired_msgid_by_count"));
+            query.bindValue(":userid", user.toInt());
+            query.bindValue(":bufferid", bufferId.toInt());
+            query.bindValue(":keepcount", keepCount);
+            safeExec(query);
+            watchQuery(query);
+            if (query.first() && query.value(0).toLongLong() > expiredId.toQint64())
+                expiredId = query.value(0).toLongLong();
+        }
+    }
+    db.commit();
+    unlock();
+    return expiredId;
+}
+
+
+MsgId SqliteStorage::oversizedMsgId(UserId user, qint64 maxSize)
+{
+    // Walk the backlog in pages, so we don't block writers for the whole scan
+    const int pageSize = 10000;
+    qint64 size = 0;
+    qint64 lastMsgId = std::numeric_limits<qint64>::max();
+    forever {
+        QSqlQuery query(logDb());
+        query.prepare(queryString("select_message_sizes"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":lastmsg", lastMsgId);
+        query.bindValue(":limit", pageSize);
+
+        lockForRead();
+        safeExec(query);
+        if (!watchQuery(query)) {
+            unlock();
+            return MsgId();
+        }
+        int rows = 0;
+        while (query.next()) {
+            rows++;
+            lastMsgId = query.value(0).toLongLong();
+            size += query.value(1).toLongLong();
+            if (size > maxSize) {
+                unlock();
+                return lastMsgId;
+            }
+        }
+        unlock();
+        if (rows < pageSize)
+            return MsgId();
+    }
+}
+
+
+int SqliteStorage::deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last)
+{
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    int numRows = -1;
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("delete_backlog_range"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":firstmsg", first.toQint64());
+        query.bindValue(":lastmsg", last.toQint64());
+
+        lockForWrite();
+        safeExec(query);
+        if (watchQuery(query))
+            numRows = query.numRowsAffected();
+    }
+
+    if (numRows < 0)
+        db.rollback();
+    else
+        db.commit();
+    unlock();
+    return numRows;
+}
+
+
 QMap<UserId, QString> SqliteStorage::getAllAuthUserNames()
 {
     QMap<UserId, QString> authusernames;
@@ -2205,8 +2335,15 @@ QString SqliteStorage::backlogFile()
 
 bool SqliteStorage::safeExec(QSqlQuery &query, int retryCount)
 {
+    QElapsedTimer timer;
+    if (Metrics::isEnabled())
+        timer.start();
+
     query.exec();
 
+    if (timer.isValid())
+        observeQueryTime(queryName(query.lastQuery()), timer);
+
     if (!query.lastError().isValid())
         return true;
 
@@ -2241,9 +2378,6 @@ void SqliteMigrationReader::setMaxId(MigrationObject mo)
     case Sender:
         queryString = "SELECT max(senderid) FROM sender";
         break;
-    case Backlog:
-        queryString = "SELECT max(messageid) FROM backlog";
-        break;
     default:
         _maxId = 0;
         return;
@@ -2280,10 +2414,8 @@ bool SqliteMigrationReader::prepareQuery(MigrationObject mo)
         bindValue(1, stepSize());
         break;
     case Backlog:
-        newQuery(queryString("migrate_read_backlog"), logDb());
-        bindValue(0, 0);
-        bindValue(1, stepSize());
-        break;
+        // the backlog is read in chunks by readBacklog()
+        return false;
     case IrcServer:
         newQuery(queryString("migrate_read_ircserver"), logDb());
         break;
@@ -2441,36 +2573,41 @@ bool SqliteMigrationReader::readMo(SenderMO &sender)
 }
 
 
-bool SqliteMigrationReader::readMo(BacklogMO &backlog)
+bool SqliteMigrationReader::readBacklog(qint64 first, qint64 last, QList<BacklogMO> &backlog)
 {
-    qint64 skipSteps = 0;
-    while (!next()) {
-        if (backlog.messageid < _maxId) {
-            bindValue(0, backlog.messageid.toQint64() + (skipSteps * stepSize()));
-            bindValue(1, backlog.messageid.toQint64() + ((skipSteps + 1) * stepSize()));
-            skipSteps++;
-            if (!exec())
-                return false;
-        }
-        else {
-            return false;
-        }
-    }
+    // Runs in the migration's worker threads, so use a query on the thread's own connection
+    QSqlQuery query(logDb());
+    query.prepare(queryString("migrate_read_backlog"));
+    query.bindValue(0, first);
+    query.bindValue(1, last);
+    safeExec(query);
+    if (!watchQuery(query))
+        return false;
 
-    backlog.messageid = value(0).toLongLong();
-    // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
-    // seconds.  This nets us more precision as well as simplifying 64-bit time.
-    backlog.time = QDateTime::fromMSecsSinceEpoch(value(1).toLongLong()).toUTC();
-    backlog.bufferid = value(2).toInt();
-    backlog.type = value(3).toInt();
-    backlog.flags = value(4).toInt();
-    backlog.senderid = value(5).toLongLong();
-    backlog.senderprefixes = value(6).toString();
-    backlog.message = value(7).toString();
+    while (query.next()) {
+        BacklogMO mo;
+        mo.messageid = query.value(0).toLongLong();
+        mo.time = QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()).toUTC();
+        mo.bufferid = query.value(2).toInt();
+        mo.type = query.value(3).toInt();
+        mo.flags = query.value(4).toInt();
+        mo.senderid = query.value(5).toLongLong();
+        mo.senderprefixes = query.value(6).toString();
+        mo.message = query.value(7).toString();
+        backlog << mo;
+    }
     return true;
 }
 
 
+qint64 SqliteMigrationReader::maxBacklogId()
+{
+    QSqlQuery query = logDb().exec("SELECT max(messageid) FROM backlog");
+    query.first();
+    return query.value(0).toLongLong();
+}
+
+
 bool SqliteMigrationReader::readMo(IrcServerMO &ircserver)
 {
     if (!next())
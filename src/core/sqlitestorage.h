@@ -45,8 +45,6 @@ public slots:
     QVariantList setupData() const  override { return {}; }
     QString description() const override;
 
-    // TODO: Add functions for configuring the backlog handling, i.e. defining auto-cleanup settings etc
-
     /* User handling */
     UserId addUser(const QString &user, const QString &password, const QString &authenticator = "Database") override;
     bool updateUser(UserId user, const QString &password) override;
@@ -119,6 +117,11 @@ public slots:
                                           Message::Types type = Message::Types{-1},
                                           Message::Flags flags = Message::Flags{-1}) override;
 
+    /* Backlog retention */
+    MsgId expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount) override;
+    MsgId oversizedMsgId(UserId user, qint64 maxSize) override;
+    int deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last) override;
+
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
     QString getAuthUserName(UserId user) override;
@@ -144,11 +147,17 @@ private:
     void bindNetworkInfo(QSqlQuery &query, const NetworkInfo &info);
     void bindServerInfo(QSqlQuery &query, const Network::Server &server);
 
+    //! Turn a single-row "INSERT ... VALUES (...)" query into one inserting rowCount rows
+    /** Named placeholders of row n get the suffix _n, e.g. :sender becomes :sender_0, :sender_1, ...
+     */
+    QString multiRowQueryString(const QString &queryName, int rowCount);
+
     inline void lockForRead() { _dbLock.lockForRead(); }
     inline void lockForWrite() { _dbLock.lockForWrite(); }
     inline void unlock() { _dbLock.unlock(); }
     QReadWriteLock _dbLock;
     static int _maxRetryCount;
+    static int _maxMessageBatchSize;
 };
 
 
@@ -168,11 +177,13 @@ public:
     bool readMo(IdentityNickMO &identityNick) override;
     bool readMo(NetworkMO &network) override;
     bool readMo(BufferMO &buffer) override;
-    bool readMo(BacklogMO &backlog) override;
     bool readMo(IrcServerMO &ircserver) override;
     bool readMo(UserSettingMO &userSetting) override;
     bool readMo(CoreStateMO &coreState) override;
 
+    bool readBacklog(qint64 first, qint64 last, QList<BacklogMO> &backlog) override;
+    qint64 maxBacklogId() override;
+
     bool prepareQuery(MigrationObject mo) override;
 
     qint64 stepSize() { return 50000; }
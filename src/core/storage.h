@@ -104,8 +104,6 @@ public slots:
      */
     virtual void sync() = 0;
 
-    // TODO: Add functions for configuring the backlog handling, i.e. defining auto-cleanup settings etc
-
     /* User handling */
 
     //! Add a new core user to the storage.
@@ -528,6 +526,31 @@ public slots:
                                                   Message::Types type = Message::Types{-1},
                                                   Message::Flags flags = Message::Flags{-1}) = 0;
 
+    /* Backlog retention */
+
+    //! Get the newest message of a buffer that exceeds the given retention limits
+    /** \param bufferId   The buffer in question
+     *  \param before     Messages older than this are expired; an invalid QDateTime disables the limit
+     *  \param keepCount  Number of newest messages to keep in the buffer; 0 disables the limit
+     *  \return The MsgId of the newest expired message, or an invalid MsgId if nothing has expired
+     */
+    virtual MsgId expiredMsgId(UserId user, BufferId bufferId, const QDateTime &before, int keepCount) = 0;
+
+    //! Get the newest message of a user that doesn't fit into the given backlog size anymore
+    /** Only the length of the message contents is accounted for. This needs to look at all of the user's messages.
+     *  \param maxSize  The maximum size of the user's backlog in bytes
+     *  \return The MsgId of the newest message exceeding the size, or an invalid MsgId if the backlog fits
+     */
+    virtual MsgId oversizedMsgId(UserId user, qint64 maxSize) = 0;
+
+    //! Permanently delete messages from a buffer
+    /** \param bufferId The buffer to delete messages from
+     *  \param first    Delete only messages with a MsgId >= first
+     *  \param last     Delete only messages with a MsgId < last
+     *  \return The number of deleted messages, or -1 on error
+     */
+    virtual int deleteMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last) = 0;
+
     //! Fetch all authusernames
     /** \return      Map of all current UserIds to permitted idents
      */
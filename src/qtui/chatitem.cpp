@@ -590,7 +590,7 @@ ContentsChatItemPrivate *ContentsChatItem::privateData() const
 {
     if (!_data) {
         ContentsChatItem *that = const_cast<ContentsChatItem *>(this);
-        that->_data = new ContentsChatItemPrivate(ClickableList::fromString(data(ChatLineModel::DisplayRole).toString()), that);
+        that->_data = new ContentsChatItemPrivate(data(ChatLineModel::ClickablesRole).value<ClickableList>(), that);
     }
     return _data;
 }
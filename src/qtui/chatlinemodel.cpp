@@ -45,6 +45,22 @@ void ChatLineModel::insertMessages__(int pos, const QList<Message> &messages)
 }
 
 
+void ChatLineModel::removeMessages__(const QList<int> &rows)
+{
+    // Build the remaining list in one go, rather than moving the tail for every removed row
+    QList<ChatLineModelItem> messageList;
+    messageList.reserve(_messageList.count() - rows.count());
+    int next = 0;
+    for (int i = 0; i < _messageList.count(); i++) {
+        if (next < rows.count() && rows.at(next) == i)
+            next++;
+        else
+            messageList << _messageList.at(i);
+    }
+    _messageList.swap(messageList);
+}
+
+
 Message ChatLineModel::takeMessageAt(int i)
 {
     Message msg = _messageList[i].message();
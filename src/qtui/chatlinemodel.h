@@ -34,7 +34,8 @@ public:
     enum ChatLineRole {
         WrapListRole = MessageModel::UserRole,
         MsgLabelRole,
-        SelectedBackgroundRole
+        SelectedBackgroundRole,
+        ClickablesRole
     };
 
     ChatLineModel(QObject *parent = 0);
@@ -55,6 +56,7 @@ protected:
     virtual inline void insertMessage__(int pos, const Message &msg) { _messageList.insert(pos, ChatLineModelItem(msg)); }
     virtual void insertMessages__(int pos, const QList<Message> &);
     virtual inline void removeMessageAt(int i) { _messageList.removeAt(i); }
+    virtual void removeMessages__(const QList<int> &rows);
     virtual inline void removeAllMessages() { _messageList.clear(); }
     virtual Message takeMessageAt(int i);
 
@@ -151,6 +151,12 @@ QVariant ChatLineModelItem::contentsData(int role) const
         if (_wrapList.isEmpty())
             computeWrapList();
         return QVariant::fromValue<ChatLineModel::WrapList>(_wrapList);
+    case ChatLineModel::ClickablesRole:
+        if (!_clickablesValid) {
+            _clickables = ClickableList::fromString(_styledMsg.plainContents());
+            _clickablesValid = true;
+        }
+        return QVariant::fromValue<ClickableList>(_clickables);
     }
     return QVariant();
 }
@@ -22,6 +22,7 @@
 
 #include "messagemodel.h"
 
+#include "clickable.h"
 #include "uistyle.h"
 
 class ChatLineModelItem : public MessageModelItem
@@ -33,7 +34,7 @@ public:
     virtual bool setData(int column, const QVariant &value, int role);
 
     virtual inline const Message &message() const { return _styledMsg; }
-    virtual inline const QDateTime &timestamp() const { return _styledMsg.timestamp(); }
+    virtual inline QDateTime timestamp() const { return _styledMsg.timestamp(); }
     virtual inline const MsgId &msgId() const { return _styledMsg.msgId(); }
     virtual inline const BufferId &bufferId() const { return _styledMsg.bufferId(); }
     virtual inline void setBufferId(BufferId bufferId) { _styledMsg.setBufferId(bufferId); }
@@ -62,6 +63,8 @@ private:
     void computeWrapList() const;
 
     mutable WrapList _wrapList;
+    mutable ClickableList _clickables;
+    mutable bool _clickablesValid{false}; ///< Clickables only depend on the contents, so are never invalidated
     UiStyle::StyledMessage _styledMsg;
 
     static unsigned char *TextBoundaryFinderBuffer;
@@ -124,6 +124,8 @@ ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal w
         this, SLOT(rowsAboutToBeRemoved(const QModelIndex &, int, int)));
     connect(model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
         this, SLOT(rowsRemoved()));
+    connect(model, SIGNAL(modelAboutToBeReset()), this, SLOT(modelAboutToBeReset()));
+    connect(model, SIGNAL(modelReset()), this, SLOT(modelReset()));
     connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), SLOT(dataChanged(QModelIndex, QModelIndex)));
 
 #if defined HAVE_WEBKIT || defined HAVE_WEBENGINE
@@ -579,6 +581,22 @@ void ChatScene::rowsRemoved()
 }
 
 
+// The message model resets itself when dropping many scattered rows at once, so we rebuild all lines
+void ChatScene::modelAboutToBeReset()
+{
+    if (!_lines.isEmpty())
+        rowsAboutToBeRemoved(QModelIndex(), 0, _lines.count() - 1);
+}
+
+
+void ChatScene::modelReset()
+{
+    if (model()->rowCount() > 0)
+        rowsInserted(QModelIndex(), 0, model()->rowCount() - 1);
+    setMarkerLine();
+}
+
+
 void ChatScene::dataChanged(const QModelIndex &tl, const QModelIndex &br)
 {
     layout(tl.row(), br.row(), _sceneRect.width());
@@ -222,6 +222,8 @@ private slots:
     void updateTimestampHasBrackets();
 
     void rowsRemoved();
+    void modelAboutToBeReset();
+    void modelReset();
 
     void clickTimeout();
 
@@ -1627,7 +1627,9 @@ void MainWin::showNewTransferDlg(const QUuid &transferId)
 {
     auto transfer = Client::transferManager()->transfer(transferId);
     if (transfer) {
-        if (transfer->status() == Transfer::Status::New) {
+        // Transfers still being spooled on the core can be fetched by any client, e.g. after reconnecting
+        bool spooling = transfer->isSpooled() && transfer->status() != Transfer::Status::Completed && transfer->status() != Transfer::Status::Failed;
+        if (transfer->status() == Transfer::Status::New || spooling) {
             ReceiveFileDlg *dlg = new ReceiveFileDlg(transfer, this);
             dlg->show();
         }
@@ -20,9 +20,12 @@
 
 #include <QDir>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
 
 #include "receivefiledlg.h"
 
+#include "client.h"
 #include "transfer.h"
 
 ReceiveFileDlg::ReceiveFileDlg(const Transfer *transfer, QWidget *parent)
@@ -41,6 +44,20 @@ void ReceiveFileDlg::on_buttonBox_clicked(QAbstractButton *button)
 {
     if (ui.buttonBox->standardButton(button) == QDialogButtonBox::Save) {
         QString name = QFileDialog::getSaveFileName(this, QString(), QDir::currentPath() + "/" + _transfer->fileName());
+        if (name.isEmpty())
+            return;
+
+        // Offer to continue a previously interrupted download of the same file
+        QFileInfo existing(name);
+        if (Client::isCoreFeatureEnabled(Quassel::Feature::TransferFlowControl) && existing.exists()
+            && existing.size() > 0 && static_cast<quint64>(existing.size()) < _transfer->fileSize()) {
+            int ret = QMessageBox::question(this, tr("Resume Transfer"), tr("%1 has already been partially received. Do you want to resume the transfer?").arg(existing.fileName()),
+                QMessageBox::Yes|QMessageBox::No, QMessageBox::Yes);
+            if (ret == QMessageBox::Yes) {
+                _transfer->resume(name);
+                return;
+            }
+        }
         _transfer->accept(name);
     }
 
@@ -21,6 +21,7 @@
 #include "abstractbuffercontainer.h"
 #include "client.h"
 #include "clientbacklogmanager.h"
+#include "messagemodel.h"
 #include "networkmodel.h"
 
 AbstractBufferContainer::AbstractBufferContainer(QWidget *parent)
@@ -126,6 +127,8 @@ void AbstractBufferContainer::setCurrentBuffer(BufferId bufferId)
 
     _currentBuffer = bufferId;
     showChatView(bufferId);
+    Client::messageModel()->bufferShown(bufferId);
+    Client::fetchChannelUsers(bufferId);
     Client::networkModel()->clearBufferActivity(bufferId);
     Client::setBufferLastSeenMsg(bufferId, _chatViews[bufferId]->lastMsgId());
     Client::backlogManager()->checkForBacklog(bufferId);
@@ -48,72 +48,62 @@ void Clickable::activate(NetworkId networkId, const QString &text) const
 }
 
 
-// NOTE: This method is not threadsafe and not reentrant!
-//       (RegExps are not constant while matching, and they are static here for efficiency)
-ClickableList ClickableList::fromString(const QString &str)
+namespace {
+
+// Channel names consisting of a number only are more likely to be issue numbers or the like
+bool isNumberedChannel(const QString &name)
 {
-    // For matching URLs
-    static QString scheme("(?:(?:mailto:|(?:[+.-]?\\w)+://)|www(?=\\.\\S+\\.))");
-    static QString authority("(?:(?:[,.;@:]?[-\\w]+)+\\.?|\\[[0-9a-f:.]+\\])(?::\\d+)?");
-    static QString urlChars("(?:[,.;:]*[\\w~@/?&=+$()!%#*-])");
-    static QString urlEnd("(?:>|[,.;:\"]*\\s|\\b|$)");
+    if (name.length() < 2 || name.at(0) != '#')
+        return false;
+    for (int i = 1; i < name.length(); i++) {
+        if (!name.at(i).isDigit())
+            return false;
+    }
+    return true;
+}
 
-    static QRegExp regExp[] = {
-        // URL
-        // QRegExp(QString("((?:https?://|s?ftp://|irc://|mailto:|www\\.)%1+|%1+\\.[a-z]{2,4}(?:?=/%1+|\\b))%2").arg(urlChars, urlEnd)),
-        QRegExp(QString("\\b(%1%2(?:/%3*)?)%4").arg(scheme, authority, urlChars, urlEnd), Qt::CaseInsensitive),
+}
 
-        // Channel name
-        // We don't match for channel names starting with + or &, because that gives us a lot of false positives.
-        QRegExp("((?:#|![A-Z0-9]{5})[^,:\\s]+(?::[^,:\\s]+)?)\\b", Qt::CaseInsensitive)
 
+// URLs and channel names are matched by a single combined regexp, so the string is only scanned
+// once. Each call works on its own copy of the (shared, precompiled) regexp, which makes this
+// method reentrant and safe to call from any thread.
+ClickableList ClickableList::fromString(const QString &str)
+{
+    // For matching URLs
+    static const QString scheme("(?:(?:mailto:|(?:[+.-]?\\w)+://)|www(?=\\.\\S+\\.))");
+    static const QString authority("(?:(?:[,.;@:]?[-\\w]+)+\\.?|\\[[0-9a-f:.]+\\])(?::\\d+)?");
+    static const QString urlChars("(?:[,.;:]*[\\w~@/?&=+$()!%#*-])");
+    static const QString urlEnd("(?:>|[,.;:\"]*\\s|\\b|$)");
+
+    static const QRegExp pattern(
+        // URL (cap 1)
+        QString("\\b(%1%2(?:/%3*)?)%4").arg(scheme, authority, urlChars, urlEnd)
+        // Channel name (cap 2)
+        // We don't match for channel names starting with + or &, because that gives us a lot of false positives.
+        + QString("|((?:#|![A-Z0-9]{5})[^,:\\s]+(?::[^,:\\s]+)?)\\b")
         // TODO: Nicks, we'll need a filtering for only matching known nicknames further down if we do this
-    };
-
-    static const int regExpCount = 2; // number of regexps in the array above
-
-    qint16 matches[] = { 0, 0, 0 };
-    qint16 matchEnd[] = { 0, 0, 0 };
+        , Qt::CaseInsensitive);
 
+    QRegExp regExp = pattern;
     ClickableList result;
-    //QString str = data(ChatLineModel::DisplayRole).toString();
-
-    qint16 idx = 0;
-    qint16 minidx;
-    int type = -1;
-
-    do {
-        type = -1;
-        minidx = str.length();
-        for (int i = 0; i < regExpCount; i++) {
-            if (matches[i] < 0 || matchEnd[i] > str.length()) continue;
-            if (idx >= matchEnd[i]) {
-                matches[i] = regExp[i].indexIn(str, qMax(matchEnd[i], idx));
-                if (matches[i] >= 0) matchEnd[i] = matches[i] + regExp[i].cap(1).length();
-            }
-            if (matches[i] >= 0 && matches[i] < minidx) {
-                minidx = matches[i];
-                type = i;
-            }
-        }
-        if (type >= 0) {
-            idx = matchEnd[type];
-            QString match = str.mid(matches[type], matchEnd[type] - matches[type]);
-            if (type == Clickable::Url && str.at(idx-1) == ')') { // special case: closing paren only matches if we had an open one
-                if (!match.contains('(')) {
-                    matchEnd[type]--;
-                    match.chop(1);
-                }
-            }
-            if (type == Clickable::Channel) {
-                // don't make clickable if it could be a #number
-                if (QRegExp("^#\\d+$").exactMatch(match))
-                    continue;
-            }
-            result.append(Clickable((Clickable::Type)type, matches[type], matchEnd[type] - matches[type]));
+
+    int idx = 0;
+    while (regExp.indexIn(str, idx) >= 0) {
+        Clickable::Type type = regExp.pos(1) >= 0 ? Clickable::Url : Clickable::Channel;
+        int cap = type == Clickable::Url ? 1 : 2;
+        int start = regExp.pos(cap);
+        int length = regExp.cap(cap).length();
+        if (type == Clickable::Url && str.at(start + length - 1) == ')') { // special case: closing paren only matches if we had an open one
+            if (!str.midRef(start, length).contains('('))
+                length--;
         }
+        idx = start + qMax(length, 1);
+        if (type == Clickable::Channel && isNumberedChannel(regExp.cap(cap)))
+            continue; // don't make clickable if it could be a #number
+
+        result.append(Clickable(type, start, length));
     }
-    while (type >= 0);
     return result;
 }
 
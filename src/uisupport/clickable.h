@@ -21,6 +21,7 @@
 #ifndef CLICKABLE_H_
 #define CLICKABLE_H_
 
+#include <QMetaType>
 #include <QStackedWidget>
 
 #include "types.h"
@@ -60,10 +61,13 @@ private:
 class ClickableList : public QList<Clickable>
 {
 public:
+    //! Finds URLs and channel names in the given string. Reentrant.
     static ClickableList fromString(const QString &);
 
     Clickable atCursorPos(int idx);
 };
 
+Q_DECLARE_METATYPE(ClickableList)
+
 
 #endif // CLICKABLE_H_
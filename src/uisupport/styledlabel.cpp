@@ -122,7 +122,7 @@ void StyledLabel::setText(const QString &text)
 {
     UiStyle *style = GraphicalUi::uiStyle();
 
-    UiStyle::StyledString sstr = style->styleString(style->mircToInternal(text), UiStyle::FormatType::PlainMsg);
+    UiStyle::StyledString sstr = style->mircToStyledString(text, UiStyle::FormatType::PlainMsg);
     QList<QTextLayout::FormatRange> layoutList = style->toTextLayoutList(sstr.formatList, sstr.plainText.length(), UiStyle::MessageLabel::None);
 
     // Use default font rather than the style's
@@ -18,11 +18,13 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
  ***************************************************************************/
 
+#include <initializer_list>
 #include <utility>
 #include <vector>
 
 #include <QApplication>
 #include <QColor>
+#include <QMutex>
 
 #include "buffersettings.h"
 #include "icon.h"
@@ -624,120 +626,433 @@ QList<QTextLayout::FormatRange> UiStyle::toTextLayoutList(const FormatList &form
 }
 
 
+/***********************************************************************************/
+/**
+ * Collects plain text and format changes of a StyledString in a single pass
+ *
+ * Text is only ever appended; each format change is recorded at the current end of the plain text.
+ */
+class UiStyle::StyledStringBuilder
+{
+public:
+    StyledStringBuilder(FormatType baseFormat, int sizeHint = 0)
+        : _format{baseFormat, {}, {}}
+    {
+        _result.plainText.reserve(sizeHint);
+        _result.formatList.emplace_back(std::make_pair(quint16{0}, _format));
+    }
+
+    inline void appendText(const QString &text) { _result.plainText.append(text); }
+    inline void appendText(const QStringRef &text) { _result.plainText.append(text); }
+    void appendMirc(const QString &mirc);
+
+    //! Toggles a standard format or a part-of-message format
+    void toggle(FormatType ftype)
+    {
+        _format.type ^= ftype;
+        commit();
+    }
+
+    //! Sets a mIRC color (0-98), in the foreground if not reversed
+    void setMircColor(bool foreground, quint32 color)
+    {
+        // Color values 0-15 are traditional mIRC colors, defined in the stylesheet and thus going through the format engine
+        // Larger color values are hardcoded and applied separately (cf. https://modern.ircdocs.horse/formatting.html#colors-16-98)
+        if (foreground != _reversed) {
+            if (color < 16) {
+                _format.type &= 0xf0ffffff;
+                _format.type |= color << 24 | 0x00400000;
+                _format.foreground = QColor{};
+            }
+            else {
+                _format.type &= 0xf0bfffff;  // mask out traditional foreground color
+                _format.foreground = extendedMircColor(color);
+            }
+        }
+        else {
+            if (color < 16) {
+                _format.type &= 0x0fffffff;
+                _format.type |= color << 28 | 0x00800000;
+                _format.background = QColor{};
+            }
+            else {
+                _format.type &= 0x0f7fffff;  // mask out traditional background color
+                _format.background = extendedMircColor(color);
+            }
+        }
+        commit();
+    }
+
+    //! Sets a hex color, in the foreground if not reversed
+    void setHexColor(bool foreground, const QColor &color)
+    {
+        if (foreground != _reversed) {
+            _format.type &= 0xf0bfffff;  // mask out mIRC foreground color
+            _format.foreground = color;
+        }
+        else {
+            _format.type &= 0x0f7fffff;  // mask out mIRC background color
+            _format.background = color;
+        }
+        commit();
+    }
+
+    void clearColors()
+    {
+        _format.type &= 0x003fffff;
+        _format.foreground = QColor{};
+        _format.background = QColor{};
+        commit();
+    }
+
+    void reverse()
+    {
+        _reversed = !_reversed;
+        quint32 orig = static_cast<quint32>(_format.type & 0xffc00000);
+        _format.type &= 0x003fffff;
+        _format.type |= (orig & 0x00400000) <<1;
+        _format.type |= (orig & 0x0f000000) <<4;
+        _format.type |= (orig & 0x00800000) >>1;
+        _format.type |= (orig & 0xf0000000) >>4;
+        std::swap(_format.foreground, _format.background);
+        commit();
+    }
+
+    void reset()
+    {
+        _format.type &= 0x000000ff; // we keep message type-specific formatting
+        _format.foreground = QColor{};
+        _format.background = QColor{};
+        _reversed = false;
+        commit();
+    }
+
+    inline StyledString takeResult() { return std::move(_result); }
+
+private:
+    void commit()
+    {
+        int pos = _result.plainText.length();
+        if (pos > 65535) {
+            // We use quint16 for indexes
+            if (!_truncated)
+                qWarning() << QString("String too long to be styled: %1").arg(_result.plainText);
+            _truncated = true;
+            return;
+        }
+        if (pos == _result.formatList.back().first)
+            _result.formatList.back().second = _format;
+        else
+            _result.formatList.emplace_back(std::make_pair(quint16(pos), _format));
+    }
+
+    StyledString _result;
+    Format _format;
+    bool _reversed{false};
+    bool _truncated{false};
+};
+
+
+namespace {
+
+inline bool isMircDigit(QChar c)
+{
+    return c.unicode() >= '0' && c.unicode() <= '9';
+}
+
+bool isHexColor(const QString &s, int pos)
+{
+    if (pos + 6 > s.length())
+        return false;
+    for (int i = pos; i < pos + 6; ++i) {
+        ushort c = s.at(i).unicode();
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            return false;
+    }
+    return true;
+}
+
+}
+
+
+// Note: We use the "mirc standard" as described in <http://www.mirc.co.uk/help/color.txt>.
+//       This means that we don't accept something like \x03,5 (even though others, like WeeChat, do).
+void UiStyle::StyledStringBuilder::appendMirc(const QString &mirc)
+{
+    int len = mirc.length();
+    int textStart = 0;
+    int i = 0;
+    while (i < len) {
+        ushort c = mirc.at(i).unicode();
+        if (c >= 0x20 && c != 0x7f) {
+            ++i;
+            continue;
+        }
+        if (i > textStart)
+            appendText(mirc.midRef(textStart, i - textStart));
+        ++i;
+
+        switch (c) {
+        case '\x02':
+            toggle(FormatType::Bold);
+            break;
+        case '\x03':
+            if (i < len && isMircDigit(mirc.at(i))) {
+                quint32 color = mirc.at(i++).digitValue();
+                if (i < len && isMircDigit(mirc.at(i)))
+                    color = 10 * color + mirc.at(i++).digitValue();
+                setMircColor(true, color);
+
+                if (i + 1 < len && mirc.at(i) == ',' && isMircDigit(mirc.at(i + 1))) {
+                    i++;
+                    color = mirc.at(i++).digitValue();
+                    if (i < len && isMircDigit(mirc.at(i)))
+                        color = 10 * color + mirc.at(i++).digitValue();
+                    setMircColor(false, color);
+                }
+            }
+            else {
+                clearColors();
+            }
+            break;
+        case '\x04':
+            // Hex colors, as specified in https://modern.ircdocs.horse/formatting.html#hex-color
+            if (isHexColor(mirc, i)) {
+                setHexColor(true, QColor{"#" + mirc.mid(i, 6)});
+                i += 6;
+                if (i < len && mirc.at(i) == ',' && isHexColor(mirc, i + 1)) {
+                    setHexColor(false, QColor{"#" + mirc.mid(i + 1, 6)});
+                    i += 7;
+                }
+            }
+            else {
+                clearColors();
+            }
+            break;
+        case '\x09':
+            appendText(QString(8, ' '));
+            break;
+        case '\x0f':
+            reset();
+            break;
+        case '\x11':
+            // Monospace not supported yet
+            break;
+        case '\x12':
+        case '\x16':
+            reverse();
+            break;
+        case '\x1d':
+            toggle(FormatType::Italic);
+            break;
+        case '\x1e':
+            toggle(FormatType::Strikethrough);
+            break;
+        case '\x1f':
+            toggle(FormatType::Underline);
+            break;
+        case '\x7f':
+            _result.plainText.append(QChar(0x2421));
+            break;
+        default:
+            _result.plainText.append(QChar(0x2400 + c));
+        }
+        textStart = i;
+    }
+    if (len > textStart)
+        appendText(mirc.midRef(textStart, len - textStart));
+}
+
+
+/***********************************************************************************/
+/**
+ * A message template (e.g. "%DN%1%DN has joined %DC%2%DC"), parsed into its parts
+ *
+ * Templates are parsed only once and cached by their translated text, so the placeholders
+ * don't need to be filled in via QString::arg() and the result parsed again for format codes.
+ */
+class UiStyle::MessageTemplate
+{
+public:
+    //! An argument substituted for a %n placeholder
+    struct Arg {
+        Arg(const QString &text, bool mirc = false) : text(text), mirc(mirc) {}
+
+        QString text;
+        bool mirc; //!< If true, text contains mIRC formatting codes, otherwise it's plain
+    };
+
+    static const MessageTemplate &get(const QString &tmpl)
+    {
+        // Messages may be styled outside of the GUI thread. The templates are never freed, so the returned
+        // reference stays valid while others are added, and there's only one per translated text anyway.
+        static QMutex mutex;
+        static QHash<QString, const MessageTemplate *> templates;
+        QMutexLocker locker(&mutex);
+        const MessageTemplate *&messageTemplate = templates[tmpl];
+        if (!messageTemplate)
+            messageTemplate = new MessageTemplate{tmpl};
+        return *messageTemplate;
+    }
+
+    void render(StyledStringBuilder &builder, std::initializer_list<Arg> args) const
+    {
+        for (const Part &part : _parts) {
+            if (part.arg >= 0) {
+                if (part.arg >= static_cast<int>(args.size()))
+                    continue;
+                const Arg &arg = *(args.begin() + part.arg);
+                if (arg.mirc)
+                    builder.appendMirc(arg.text);
+                else
+                    builder.appendText(arg.text);
+            }
+            else if (part.ftype != FormatType::Base) {
+                builder.toggle(part.ftype);
+            }
+            else {
+                builder.appendText(part.text);
+            }
+        }
+    }
+
+    MessageTemplate() = default;
+
+    explicit MessageTemplate(const QString &tmpl)
+    {
+        QString text;
+        auto flush = [&]() {
+            if (!text.isEmpty()) {
+                _parts.push_back(Part{text, FormatType::Base, -1});
+                text.clear();
+            }
+        };
+
+        int len = tmpl.length();
+        for (int i = 0; i < len; ++i) {
+            QChar c = tmpl.at(i);
+            if (c != '%' || i + 1 >= len) {
+                text.append(c);
+                continue;
+            }
+            QChar next = tmpl.at(i + 1);
+            if (next == '%') {
+                text.append(c);
+                ++i;
+            }
+            else if (next >= '1' && next <= '9') {
+                flush();
+                _parts.push_back(Part{QString(), FormatType::Base, next.digitValue() - 1});
+                ++i;
+            }
+            else {
+                QString code = tmpl.mid(i, next == 'D' ? 3 : 2);
+                FormatType ftype = formatType(code);
+                if (ftype == FormatType::Invalid) {
+                    qWarning() << (QString("Invalid format code in template: %1").arg(tmpl));
+                    text.append(c);
+                    continue;
+                }
+                if (ftype != FormatType::Base) {
+                    flush();
+                    _parts.push_back(Part{QString(), ftype, -1});
+                }
+                i += code.length() - 1;
+            }
+        }
+        flush();
+    }
+
+private:
+    //! Either literal text, a format toggle or a placeholder
+    struct Part {
+        QString text;
+        FormatType ftype;
+        int arg;
+    };
+
+    std::vector<Part> _parts;
+};
+
+
 // This method expects a well-formatted string, there is no error checking!
 // Since we create those ourselves, we should be pretty safe that nobody does something crappy here.
-UiStyle::StyledString UiStyle::styleString(const QString &s_, FormatType baseFormat)
+UiStyle::StyledString UiStyle::styleString(const QString &s, FormatType baseFormat)
 {
-    QString s = s_;
-    StyledString result;
-    result.formatList.emplace_back(std::make_pair(quint16{0}, Format{baseFormat, {}, {}}));
-
     if (s.length() > 65535) {
         // We use quint16 for indexes
         qWarning() << QString("String too long to be styled: %1").arg(s);
+        StyledString result;
+        result.formatList.emplace_back(std::make_pair(quint16{0}, Format{baseFormat, {}, {}}));
         result.plainText = s;
         return result;
     }
 
-    Format curfmt{baseFormat, {}, {}};
-    QChar fgChar{'f'}; // character to indicate foreground color, changed when reversing
+    auto at = [&s](int pos) { return pos < s.length() ? s.at(pos) : QChar{}; };
 
-    int pos = 0; quint16 length = 0;
+    StyledStringBuilder builder{baseFormat, s.length()};
+    int start = 0;
     for (;;) {
-        pos = s.indexOf('%', pos);
-        if (pos < 0) break;
-        if (s[pos+1] == '%') { // escaped %, we just remove one and continue
-            s.remove(pos, 1);
-            pos++;
-            continue;
+        int pos = s.indexOf('%', start);
+        if (pos < 0)
+            break;
+        builder.appendText(s.midRef(start, pos - start));
+        QChar code1 = at(pos + 1);
+        QChar code2 = at(pos + 2);
+        int length;
+        if (code1 == '%') { // escaped %
+            builder.appendText(QString("%"));
+            length = 2;
         }
-        if (s[pos+1] == 'D' && s[pos+2] == 'c') { // mIRC color code
-            if (s[pos+3] == '-') { // color off
-                curfmt.type &= 0x003fffff;
-                curfmt.foreground = QColor{};
-                curfmt.background = QColor{};
+        else if (code1 == 'D' && code2 == 'c') { // mIRC color code
+            if (at(pos + 3) == '-') { // color off
+                builder.clearColors();
                 length = 4;
             }
             else {
-                quint32 color = 10 * s[pos+4].digitValue() + s[pos+5].digitValue();
-                // Color values 0-15 are traditional mIRC colors, defined in the stylesheet and thus going through the format engine
-                // Larger color values are hardcoded and applied separately (cf. https://modern.ircdocs.horse/formatting.html#colors-16-98)
-                if (s[pos+3] == fgChar) {
-                    if (color < 16) {
-                        // Traditional mIRC color, defined in the stylesheet
-                        curfmt.type &= 0xf0ffffff;
-                        curfmt.type |= color << 24 | 0x00400000;
-                        curfmt.foreground = QColor{};
-                    }
-                    else {
-                        curfmt.type &= 0xf0bfffff;  // mask out traditional foreground color
-                        curfmt.foreground = extendedMircColor(color);
-                    }
-                }
-                else {
-                    if (color < 16) {
-                        curfmt.type &= 0x0fffffff;
-                        curfmt.type |= color << 28 | 0x00800000;
-                        curfmt.background = QColor{};
-                    }
-                    else {
-                        curfmt.type &= 0x0f7fffff;  // mask out traditional background color
-                        curfmt.background = extendedMircColor(color);
-                    }
-                }
+                quint32 color = 10 * at(pos + 4).digitValue() + at(pos + 5).digitValue();
+                builder.setMircColor(at(pos + 3) == 'f', color);
                 length = 6;
             }
         }
-        else if (s[pos+1] == 'D' && s[pos+2] == 'h') { // Hex color
-            QColor color{s.mid(pos+4, 7)};
-            if (s[pos+3] == fgChar) {
-                curfmt.type &= 0xf0bfffff;  // mask out mIRC foreground color
-                curfmt.foreground = std::move(color);
-            }
-            else {
-                curfmt.type &= 0x0f7fffff;  // mask out mIRC background color
-                curfmt.background = std::move(color);
-            }
+        else if (code1 == 'D' && code2 == 'h') { // Hex color
+            builder.setHexColor(at(pos + 3) == 'f', QColor{s.mid(pos + 4, 7)});
             length = 11;
         }
-        else if (s[pos+1] == 'O') { // reset formatting
-            curfmt.type &= 0x000000ff; // we keep message type-specific formatting
-            curfmt.foreground = QColor{};
-            curfmt.background = QColor{};
-            fgChar = 'f';
+        else if (code1 == 'O') { // reset formatting
+            builder.reset();
             length = 2;
         }
-        else if (s[pos+1] == 'R') { // Reverse colors
-            fgChar = (fgChar == 'f' ? 'b' : 'f');
-            quint32 orig = static_cast<quint32>(curfmt.type & 0xffc00000);
-            curfmt.type &= 0x003fffff;
-            curfmt.type |= (orig & 0x00400000) <<1;
-            curfmt.type |= (orig & 0x0f000000) <<4;
-            curfmt.type |= (orig & 0x00800000) >>1;
-            curfmt.type |= (orig & 0xf0000000) >>4;
-            std::swap(curfmt.foreground, curfmt.background);
+        else if (code1 == 'R') { // Reverse colors
+            builder.reverse();
             length = 2;
         }
         else { // all others are toggles
-            QString code = QString("%") + s[pos+1];
-            if (s[pos+1] == 'D') code += s[pos+2];
+            QString code = QString("%") + code1;
+            if (code1 == 'D') code += code2;
             FormatType ftype = formatType(code);
             if (ftype == FormatType::Invalid) {
-                pos++;
                 qWarning() << (QString("Invalid format code in string: %1").arg(s));
+                builder.appendText(QString("%"));
+                start = pos + 1;
                 continue;
             }
-            curfmt.type ^= ftype;
+            builder.toggle(ftype);
             length = code.length();
         }
-        s.remove(pos, length);
-        if (pos == result.formatList.back().first)
-            result.formatList.back().second = curfmt;
-        else
-            result.formatList.emplace_back(std::make_pair(pos, curfmt));
+        start = pos + length;
     }
-    result.plainText = s;
-    return result;
+    if (start < s.length())
+        builder.appendText(s.midRef(start));
+    return builder.takeResult();
+}
+
+
+UiStyle::StyledString UiStyle::mircToStyledString(const QString &mirc, FormatType baseFormat)
+{
+    StyledStringBuilder builder{baseFormat, mirc.length()};
+    builder.appendMirc(mirc);
+    return builder.takeResult();
 }
 
 
@@ -911,89 +1226,89 @@ UiStyle::StyledMessage::StyledMessage(const Message &msg)
 
 void UiStyle::StyledMessage::style() const
 {
+    using Arg = MessageTemplate::Arg;
+    auto render = [](StyledStringBuilder &builder, const QString &tmpl, std::initializer_list<Arg> args) {
+        MessageTemplate::get(tmpl).render(builder, args);
+    };
+
     QString user = userFromMask(sender());
     QString host = hostFromMask(sender());
     QString nick = nickFromMask(sender());
-    QString txt = UiStyle::mircToInternal(contents());
+    const QString &txt = contents();
     QString bufferName = bufferInfo().bufferName();
-    bufferName.replace('%', "%%"); // well, you _can_ have a % in a buffername apparently... -_-
-    host.replace('%', "%%");     // hostnames too...
-    user.replace('%', "%%");     // and the username...
-    nick.replace('%', "%%");     // ... and then there's totally RFC-violating servers like justin.tv m(
     const int maxNetsplitNicks = 15;
 
-    QString t;
+    StyledStringBuilder builder{UiStyle::formatType(type()), txt.length()};
     switch (type()) {
     case Message::Plain:
-        t = QString("%1").arg(txt); break;
     case Message::Notice:
-        t = QString("%1").arg(txt); break;
+        builder.appendMirc(txt); break;
     case Message::Action:
-        t = QString("%DN%1%DN %2").arg(nick).arg(txt);
+        builder.toggle(FormatType::Nick);
+        builder.appendText(nick);
+        builder.toggle(FormatType::Nick);
+        builder.appendText(QString(" "));
+        builder.appendMirc(txt);
         break;
     case Message::Nick:
         //: Nick Message
-        if (nick == contents()) t = tr("You are now known as %DN%1%DN").arg(txt);
-        else t = tr("%DN%1%DN is now known as %DN%2%DN").arg(nick, txt);
+        if (nick == contents()) render(builder, tr("You are now known as %DN%1%DN"), {Arg{txt, true}});
+        else render(builder, tr("%DN%1%DN is now known as %DN%2%DN"), {nick, Arg{txt, true}});
         break;
     case Message::Mode:
         //: Mode Message
-        if (nick.isEmpty()) t = tr("User mode: %DM%1%DM").arg(txt);
-        else t = tr("Mode %DM%1%DM by %DN%2%DN").arg(txt, nick);
+        if (nick.isEmpty()) render(builder, tr("User mode: %DM%1%DM"), {Arg{txt, true}});
+        else render(builder, tr("Mode %DM%1%DM by %DN%2%DN"), {Arg{txt, true}, nick});
         break;
     case Message::Join:
         //: Join Message
-        t = tr("%DN%1%DN %DH(%2@%3)%DH has joined %DC%4%DC").arg(nick, user, host, bufferName); break;
+        render(builder, tr("%DN%1%DN %DH(%2@%3)%DH has joined %DC%4%DC"), {nick, user, host, bufferName}); break;
     case Message::Part:
         //: Part Message
-        t = tr("%DN%1%DN %DH(%2@%3)%DH has left %DC%4%DC").arg(nick, user, host, bufferName);
-        if (!txt.isEmpty()) t = QString("%1 (%2)").arg(t).arg(txt);
+        render(builder, tr("%DN%1%DN %DH(%2@%3)%DH has left %DC%4%DC"), {nick, user, host, bufferName});
+        if (!txt.isEmpty()) {
+            builder.appendText(QString(" ("));
+            builder.appendMirc(txt);
+            builder.appendText(QString(")"));
+        }
         break;
     case Message::Quit:
         //: Quit Message
-        t = tr("%DN%1%DN %DH(%2@%3)%DH has quit").arg(nick, user, host);
-        if (!txt.isEmpty()) t = QString("%1 (%2)").arg(t).arg(txt);
+        render(builder, tr("%DN%1%DN %DH(%2@%3)%DH has quit"), {nick, user, host});
+        if (!txt.isEmpty()) {
+            builder.appendText(QString(" ("));
+            builder.appendMirc(txt);
+            builder.appendText(QString(")"));
+        }
         break;
     case Message::Kick:
     {
         QString victim = txt.section(" ", 0, 0);
         QString kickmsg = txt.section(" ", 1);
         //: Kick Message
-        t = tr("%DN%1%DN has kicked %DN%2%DN from %DC%3%DC").arg(nick).arg(victim).arg(bufferName);
-        if (!kickmsg.isEmpty()) t = QString("%1 (%2)").arg(t).arg(kickmsg);
+        render(builder, tr("%DN%1%DN has kicked %DN%2%DN from %DC%3%DC"), {nick, Arg{victim, true}, bufferName});
+        if (!kickmsg.isEmpty()) {
+            builder.appendText(QString(" ("));
+            builder.appendMirc(kickmsg);
+            builder.appendText(QString(")"));
+        }
     }
     break;
     //case Message::Kill: FIXME
 
     case Message::Server:
-        t = QString("%1").arg(txt); break;
     case Message::Info:
-        t = QString("%1").arg(txt); break;
     case Message::Error:
-        t = QString("%1").arg(txt); break;
+        builder.appendMirc(txt); break;
     case Message::DayChange:
     {
         //: Day Change Message
-        t = tr("{Day changed to %1}").arg(timestamp().date().toString(Qt::DefaultLocaleLongDate));
+        render(builder, tr("{Day changed to %1}"), {timestamp().date().toString(Qt::DefaultLocaleLongDate)});
     }
         break;
     case Message::Topic:
-        t = QString("%1").arg(txt); break;
+        builder.appendMirc(txt); break;
     case Message::NetsplitJoin:
-    {
-        QStringList users = txt.split("#:#");
-        QStringList servers = users.takeLast().split(" ");
-
-        for (int i = 0; i < users.count() && i < maxNetsplitNicks; i++)
-            users[i] = nickFromMask(users.at(i));
-
-        t = tr("Netsplit between %DH%1%DH and %DH%2%DH ended. Users joined: ").arg(servers.at(0), servers.at(1));
-        if (users.count() <= maxNetsplitNicks)
-            t.append(QString("%DN%1%DN").arg(users.join(", ")));
-        else
-            t.append(tr("%DN%1%DN (%2 more)").arg(static_cast<QStringList>(users.mid(0, maxNetsplitNicks)).join(", ")).arg(users.count() - maxNetsplitNicks));
-    }
-    break;
     case Message::NetsplitQuit:
     {
         QStringList users = txt.split("#:#");
@@ -1002,20 +1317,30 @@ void UiStyle::StyledMessage::style() const
         for (int i = 0; i < users.count() && i < maxNetsplitNicks; i++)
             users[i] = nickFromMask(users.at(i));
 
-        t = tr("Netsplit between %DH%1%DH and %DH%2%DH. Users quit: ").arg(servers.at(0), servers.at(1));
-
-        if (users.count() <= maxNetsplitNicks)
-            t.append(QString("%DN%1%DN").arg(users.join(", ")));
+        if (type() == Message::NetsplitJoin)
+            render(builder, tr("Netsplit between %DH%1%DH and %DH%2%DH ended. Users joined: "), {Arg{servers.at(0), true}, Arg{servers.at(1), true}});
         else
-            t.append(tr("%DN%1%DN (%2 more)").arg(static_cast<QStringList>(users.mid(0, maxNetsplitNicks)).join(", ")).arg(users.count() - maxNetsplitNicks));
+            render(builder, tr("Netsplit between %DH%1%DH and %DH%2%DH. Users quit: "), {Arg{servers.at(0), true}, Arg{servers.at(1), true}});
+
+        if (users.count() <= maxNetsplitNicks) {
+            builder.toggle(FormatType::Nick);
+            builder.appendMirc(users.join(", "));
+            builder.toggle(FormatType::Nick);
+        }
+        else {
+            render(builder, tr("%DN%1%DN (%2 more)"), {Arg{static_cast<QStringList>(users.mid(0, maxNetsplitNicks)).join(", "), true},
+                                                        QString::number(users.count() - maxNetsplitNicks)});
+        }
     }
     break;
     case Message::Invite:
-        t = QString("%1").arg(txt); break;
+        builder.appendMirc(txt); break;
     default:
-        t = QString("[%1]").arg(txt);
+        builder.appendText(QString("["));
+        builder.appendMirc(txt);
+        builder.appendText(QString("]"));
     }
-    _contents = UiStyle::styleString(t, UiStyle::formatType(type()));
+    _contents = builder.takeResult();
 }
 
 
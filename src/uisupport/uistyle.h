@@ -237,6 +237,18 @@ public:
     static StyledString styleString(const QString &string, FormatType baseFormat = FormatType::Base);
     static QString mircToInternal(const QString &);
 
+    /**
+     * Parses mIRC formatting codes directly into a StyledString
+     *
+     * This is equivalent to styleString(mircToInternal(mirc), baseFormat), but done in a single
+     * pass over the string.
+     *
+     * @param[in] mirc        String containing mIRC formatting codes
+     * @param[in] baseFormat  Format to start out with
+     * @return The plain text and the list of format changes
+     */
+    static StyledString mircToStyledString(const QString &mirc, FormatType baseFormat = FormatType::Base);
+
     /**
      * Gets if a custom timestamp format is used.
      *
@@ -339,6 +351,9 @@ private slots:
     void showItemViewIconsChanged(const QVariant &);
 
 private:
+    class StyledStringBuilder;
+    class MessageTemplate;
+
     QVector<QBrush> _uiStylePalette;
     QBrush _markerLineBrush;
     QHash<quint64, QTextCharFormat> _formats;
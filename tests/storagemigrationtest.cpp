@@ -0,0 +1,67 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include "core.h"
+
+Q_DECLARE_METATYPE(Core::MigrationResumption)
+
+/**
+ * Tests how selecting a storage backend that is already set up continues an interrupted migration to it.
+ */
+class StorageMigrationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void migrationResumption_data();
+    void migrationResumption();
+};
+
+
+void StorageMigrationTest::migrationResumption_data()
+{
+    QTest::addColumn<QString>("migrationTarget");
+    QTest::addColumn<qint64>("backlogCheckpoint");
+    QTest::addColumn<Core::MigrationResumption>("expected");
+
+    QTest::newRow("no migration") << QString() << qint64(-1) << Core::MigrationResumption::None;
+    QTest::newRow("migration to another backend") << QString("SQLite") << qint64(-1) << Core::MigrationResumption::None;
+    QTest::newRow("interrupted before the first checkpoint") << QString("PostgreSQL") << qint64(-1) << Core::MigrationResumption::Restart;
+    QTest::newRow("interrupted at the first checkpoint") << QString("PostgreSQL") << qint64(0) << Core::MigrationResumption::Resume;
+    QTest::newRow("interrupted while transferring backlog") << QString("PostgreSQL") << qint64(150000) << Core::MigrationResumption::Resume;
+    QTest::newRow("checkpoint without a recorded target") << QString() << qint64(150000) << Core::MigrationResumption::Resume;
+}
+
+
+void StorageMigrationTest::migrationResumption()
+{
+    QFETCH(QString, migrationTarget);
+    QFETCH(qint64, backlogCheckpoint);
+    QFETCH(Core::MigrationResumption, expected);
+
+    QCOMPARE(Core::migrationResumption("PostgreSQL", migrationTarget, backlogCheckpoint), expected);
+}
+
+
+QTEST_GUILESS_MAIN(StorageMigrationTest)
+
+#include "storagemigrationtest.moc"